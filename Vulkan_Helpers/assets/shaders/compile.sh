@@ -5,3 +5,18 @@
 for file in *.glsl; do
 	glslangValidator --target-env vulkan1.3 -e main -o "compiled/${file/.glsl/.spv}" "$file"
 done
+
+# Compute shaders that access the draw image also get a variant for every compact draw image format,
+# e.g. sky.comp.glsl -> compiled/sky_r11f_g11f_b10f.comp.spv
+for file in gradient.comp.glsl gradient_colour.comp.glsl sky.comp.glsl screen.comp.glsl upscale.comp.glsl; do
+	for format in r11f_g11f_b10f rgb10_a2; do
+		glslangValidator --target-env vulkan1.3 -e main -DDRAW_IMAGE_FORMAT=$format -o "compiled/${file/.comp.glsl/_$format.comp.spv}" "$file"
+	done
+done
+
+# Two-phase occlusion culling uses the cull shader with the depth pyramid test compiled in
+glslangValidator --target-env vulkan1.3 -e main -DOCCLUSION_CULLING -o compiled/cull_occlusion.comp.spv cull.comp.glsl
+
+# Instanced drawing reads a transform and colour per instance, and tints the texture with that colour
+glslangValidator --target-env vulkan1.3 -e main -DINSTANCE_DATA -o compiled/triangle_instanced.vert.spv triangle.vert.glsl
+glslangValidator --target-env vulkan1.3 -e main -DTINTED -o compiled/tex_image_tinted.frag.spv tex_image.frag.glsl
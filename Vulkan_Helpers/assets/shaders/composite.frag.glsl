@@ -0,0 +1,43 @@
+#version 460
+
+//shader input
+layout (location = 0) in vec2 inUV;
+
+//output write
+layout (location = 0) out vec4 outFragColor;
+
+//the rendered image, only the top left part of it is used
+layout(set = 0, binding = 0) uniform sampler2D drawImage;
+
+layout(push_constant) uniform constants
+{
+	//used part of the draw image, in UV space
+	vec2 uvScale;
+	//0 = clamp, 1 = Reinhard, 2 = ACES
+	uint tonemapOperator;
+} PushConstants;
+
+vec3 Tonemap(vec3 colour)
+{
+	colour = max(colour, vec3(0.0));
+	if (PushConstants.tonemapOperator == 1)
+	{
+		colour = colour / (1.0 + colour);
+	}
+	else if (PushConstants.tonemapOperator == 2)
+	{
+		//Narkowicz's fit of the ACES filmic curve
+		colour = (colour * (2.51 * colour + 0.03)) / (colour * (2.43 * colour + 0.59) + 0.14);
+	}
+	return clamp(colour, 0.0, 1.0);
+}
+
+void main()
+{
+	//stay half a texel inside the used part, so filtering never reads what lies outside of it
+	vec2 halfTexel = 0.5 / vec2(textureSize(drawImage, 0));
+	vec2 uv = min(inUV * PushConstants.uvScale, PushConstants.uvScale - halfTexel);
+
+	vec3 colour = texture(drawImage, uv).rgb;
+	outFragColor = vec4(Tonemap(colour), 1.0);
+}
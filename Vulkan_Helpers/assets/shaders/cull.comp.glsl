@@ -0,0 +1,179 @@
+#version 460
+
+#extension GL_EXT_buffer_reference : require
+
+//size of a workgroup for compute, overridden by specialization constants 0 and 1 from the engine
+layout (local_size_x = 64, local_size_y = 1) in;
+layout (local_size_x_id = 0, local_size_y_id = 1) in;
+
+struct Instance {
+	mat4 transform;
+	//object space centre in xyz, radius in w
+	vec4 boundingSphere;
+	uint firstIndex;
+	uint indexCount;
+	int vertexOffset;
+	uint materialIndex;
+};
+
+//matches VkDrawIndexedIndirectCommand
+struct DrawCommand {
+	uint indexCount;
+	uint instanceCount;
+	uint firstIndex;
+	int vertexOffset;
+	uint firstInstance;
+};
+
+layout(buffer_reference, std430) readonly buffer InstanceBuffer {
+	Instance instances[];
+};
+
+layout(buffer_reference, std430) writeonly buffer DrawCommandBuffer {
+	DrawCommand commands[];
+};
+
+//early and frustum-only draws count in the first, late draws in the second
+layout(buffer_reference, std430) buffer DrawCountBuffer {
+	uint counts[2];
+};
+
+//per instance, whether it passed the occlusion test last frame
+layout(buffer_reference, std430) buffer VisibilityBuffer {
+	uint visible[];
+};
+
+#ifdef OCCLUSION_CULLING
+//min depth in r, max depth in g, of the early draws
+layout(set = 0, binding = 0) uniform sampler2D depthPyramid;
+#endif
+
+//push constants block
+layout(push_constant) uniform constants
+{
+	mat4 viewProjection;
+	InstanceBuffer instanceBuffer;
+	DrawCommandBuffer drawCommandBuffer;
+	DrawCountBuffer drawCountBuffer;
+	VisibilityBuffer visibilityBuffer;
+	uint instanceCount;
+	uint frustumCulling;
+	//0 = frustum only, 1 = early, 2 = late
+	uint phase;
+	uint depthPyramidLevels;
+	vec2 depthPyramidSize;
+} PushConstants;
+
+const uint phaseEarly = 1;
+const uint phaseLate = 2;
+
+bool IsInsideFrustum(vec3 centre, float radius)
+{
+	mat4 m = transpose(PushConstants.viewProjection);
+	//planes of the clip space volume -w <= x, y <= w and 0 <= z <= w, which holds for reversed depth too
+	vec4 planes[6] = vec4[](m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[2], m[3] - m[2]);
+	for (int i = 0; i < 6; i++)
+	{
+		vec4 plane = planes[i] / length(planes[i].xyz);
+		if (dot(plane.xyz, centre) + plane.w < -radius)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+#ifdef OCCLUSION_CULLING
+//the depth test keeps greater depths, so whatever is nearer than the farthest depth drawn over its area may be visible
+bool IsOccluded(vec3 centre, float radius)
+{
+	vec2 minimum = vec2(1.0);
+	vec2 maximum = vec2(-1.0);
+	float nearestDepth = 0.0;
+	for (int i = 0; i < 8; i++)
+	{
+		vec3 corner = centre + radius * vec3((i & 1) != 0 ? 1.0 : -1.0, (i & 2) != 0 ? 1.0 : -1.0, (i & 4) != 0 ? 1.0 : -1.0);
+		vec4 clip = PushConstants.viewProjection * vec4(corner, 1.0);
+		//the box reaches behind the camera, so its projection can't be bounded
+		if (clip.w <= 0.0)
+		{
+			return false;
+		}
+		vec3 ndc = clip.xyz / clip.w;
+		minimum = min(minimum, ndc.xy);
+		maximum = max(maximum, ndc.xy);
+		nearestDepth = max(nearestDepth, ndc.z);
+	}
+
+	vec2 uvMinimum = clamp(minimum * 0.5 + 0.5, 0.0, 1.0);
+	vec2 uvMaximum = clamp(maximum * 0.5 + 0.5, 0.0, 1.0);
+
+	//the level where the box covers at most 2x2 texels, so its four corners cover all of them
+	vec2 size = (uvMaximum - uvMinimum) * PushConstants.depthPyramidSize;
+	float level = min(ceil(log2(max(max(size.x, size.y), 1.0))), float(PushConstants.depthPyramidLevels - 1));
+	ivec2 levelSize = textureSize(depthPyramid, int(level));
+	ivec2 first = clamp(ivec2(uvMinimum * vec2(levelSize)), ivec2(0), levelSize - 1);
+	ivec2 last = clamp(ivec2(uvMaximum * vec2(levelSize)), ivec2(0), levelSize - 1);
+
+	float farthestDepth = min(
+		min(texelFetch(depthPyramid, first, int(level)).r, texelFetch(depthPyramid, ivec2(last.x, first.y), int(level)).r),
+		min(texelFetch(depthPyramid, ivec2(first.x, last.y), int(level)).r, texelFetch(depthPyramid, last, int(level)).r));
+
+	return nearestDepth < farthestDepth;
+}
+#endif
+
+void EmitDraw(Instance instance, uint instanceIndex, uint list)
+{
+	//visible draws are compacted to the front of their list, the count tells the draw how many there are
+	uint drawIndex = atomicAdd(PushConstants.drawCountBuffer.counts[list], 1);
+	PushConstants.drawCommandBuffer.commands[list * PushConstants.instanceCount + drawIndex] = DrawCommand(instance.indexCount, 1, instance.firstIndex, instance.vertexOffset, instanceIndex);
+}
+
+void main()
+{
+	uint instanceIndex = gl_GlobalInvocationID.x;
+	if (instanceIndex >= PushConstants.instanceCount)
+	{
+		return;
+	}
+
+	Instance instance = PushConstants.instanceBuffer.instances[instanceIndex];
+
+	vec3 centre = (instance.transform * vec4(instance.boundingSphere.xyz, 1.0)).xyz;
+	//the largest axis scale keeps the sphere conservative under non-uniform scaling
+	float scale = max(max(length(instance.transform[0].xyz), length(instance.transform[1].xyz)), length(instance.transform[2].xyz));
+	float radius = instance.boundingSphere.w * scale;
+	bool visible = PushConstants.frustumCulling == 0 || IsInsideFrustum(centre, radius);
+
+#ifdef OCCLUSION_CULLING
+	bool visibleLastFrame = PushConstants.visibilityBuffer.visible[instanceIndex] != 0;
+
+	//first draw what was visible last frame, it's most likely still visible and occludes most of the rest
+	if (PushConstants.phase == phaseEarly)
+	{
+		if (visible && visibleLastFrame)
+		{
+			EmitDraw(instance, instanceIndex, 0);
+		}
+		return;
+	}
+
+	//then test everything against the depth of those draws, and draw what became visible
+	if (PushConstants.phase == phaseLate)
+	{
+		visible = visible && !IsOccluded(centre, radius);
+		PushConstants.visibilityBuffer.visible[instanceIndex] = visible ? 1 : 0;
+		if (visible && !visibleLastFrame)
+		{
+			EmitDraw(instance, instanceIndex, 1);
+		}
+		return;
+	}
+#endif
+
+	if (visible)
+	{
+		EmitDraw(instance, instanceIndex, 0);
+	}
+}
@@ -0,0 +1,51 @@
+#version 460
+
+//size of a workgroup for compute, overridden by specialization constants 0 and 1 from the engine
+layout (local_size_x = 8, local_size_y = 8) in;
+layout (local_size_x_id = 0, local_size_y_id = 1) in;
+
+//the depth image for the first level, the level above for the others
+layout(set = 0, binding = 0) uniform sampler2D source;
+//min depth in r, max depth in g
+layout(rg32f, set = 0, binding = 1) writeonly uniform image2D destination;
+
+layout(push_constant) uniform constants
+{
+	//part of the source the pyramid covers, in texels
+	vec2 sourceSize;
+	vec2 destinationSize;
+	uint sourceIsDepth;
+} PushConstants;
+
+void main()
+{
+	ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+	if (texel.x >= int(PushConstants.destinationSize.x) || texel.y >= int(PushConstants.destinationSize.y))
+	{
+		return;
+	}
+
+	//every source texel this texel overlaps, so the bounds stay conservative when the sizes don't divide evenly
+	vec2 scale = PushConstants.sourceSize / PushConstants.destinationSize;
+	ivec2 first = ivec2(floor(vec2(texel) * scale));
+	ivec2 last = max(ivec2(ceil(vec2(texel + 1) * scale)) - 1, first);
+	last = min(last, ivec2(PushConstants.sourceSize) - 1);
+
+	float minimum = uintBitsToFloat(0x7f800000);
+	float maximum = -minimum;
+	for (int y = first.y; y <= last.y; y++)
+	{
+		for (int x = first.x; x <= last.x; x++)
+		{
+			vec2 depth = texelFetch(source, ivec2(x, y), 0).rg;
+			if (PushConstants.sourceIsDepth != 0)
+			{
+				depth = depth.rr;
+			}
+			minimum = min(minimum, depth.r);
+			maximum = max(maximum, depth.g);
+		}
+	}
+
+	imageStore(destination, texel, vec4(minimum, maximum, 0.0, 0.0));
+}
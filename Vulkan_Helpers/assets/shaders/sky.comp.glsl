@@ -1,10 +1,16 @@
 #version 460
 
-//size of a workgroup for compute
+//format of the draw image, compile.sh builds a variant for every format the engine can pick
+#ifndef DRAW_IMAGE_FORMAT
+#define DRAW_IMAGE_FORMAT rgba16f
+#endif
+
+//size of a workgroup for compute, overridden by specialization constants 0 and 1 from the engine
 layout (local_size_x = 16, local_size_y = 16) in;
+layout (local_size_x_id = 0, local_size_y_id = 1) in;
 
 //descriptor bindings for the pipeline
-layout(rgba16f, set = 0, binding = 0) uniform image2D image;
+layout(DRAW_IMAGE_FORMAT, set = 0, binding = 0) uniform image2D image;
 
 //push constants block
 layout(push_constant) uniform constants
@@ -14,4 +14,8 @@ layout(set = 0, binding = 0) uniform sampler2D displayTexture;
 void main()
 {
 	outFragColor = texture(displayTexture, inUV);
+#ifdef TINTED
+	//compile.sh builds this as tex_image_tinted.frag.spv, for instances that carry their own colour
+	outFragColor *= inColor;
+#endif
 }
@@ -13,24 +13,52 @@ struct Vertex {
 	vec4 color;
 };
 
+//compile.sh also builds triangle_instanced.vert.spv with INSTANCE_DATA, which reads the per-frame instance stream instead
+#ifdef INSTANCE_DATA
+struct Instance {
+	mat4 transform;
+	vec4 colour;
+};
+#else
+struct Instance {
+	mat4 transform;
+	vec4 boundingSphere;
+	uint firstIndex;
+	uint indexCount;
+	int vertexOffset;
+	uint materialIndex;
+};
+#endif
+
 layout(buffer_reference, std430) readonly buffer VertexBuffer{
 	Vertex vertices[];
 };
 
+layout(buffer_reference, std430) readonly buffer InstanceBuffer{
+	Instance instances[];
+};
+
 //push constants block
 layout(push_constant) uniform constants
 {
 	mat4 render_matrix;
 	VertexBuffer vertexBuffer;
+	InstanceBuffer instanceBuffer;
 } PushConstants;
 
 void main()
 {
 	//load vertex data from device adress
 	Vertex v = PushConstants.vertexBuffer.vertices[gl_VertexIndex];
+	//every draw starts at its own instance, so the instance index picks the object
+	Instance instance = PushConstants.instanceBuffer.instances[gl_InstanceIndex];
 
 	//output data
-	gl_Position = PushConstants.render_matrix *vec4(v.position, 1.0f);
+	gl_Position = PushConstants.render_matrix * instance.transform * vec4(v.position, 1.0f);
+#ifdef INSTANCE_DATA
+	outColor = instance.colour;
+#else
 	outColor = v.color;
+#endif
 	outUV = vec2(v.uv_x, v.uv_y);
 }
@@ -0,0 +1,148 @@
+#version 460
+
+//format of the draw image, compile.sh builds a variant for every format the engine can pick
+#ifndef DRAW_IMAGE_FORMAT
+#define DRAW_IMAGE_FORMAT rgba16f
+#endif
+
+//size of a workgroup for compute, overridden by specialization constants 0 and 1 from the engine
+layout (local_size_x = 8, local_size_y = 8) in;
+layout (local_size_x_id = 0, local_size_y_id = 1) in;
+
+//the rendered image, only the top left inputSize part of it is used
+layout(DRAW_IMAGE_FORMAT, set = 0, binding = 0) readonly uniform image2D inputImage;
+//the swapchain image, written without a format so any 8-bit swapchain format works
+layout(set = 0, binding = 1) writeonly uniform image2D outputImage;
+
+layout(push_constant) uniform constants
+{
+	vec2 inputSize;
+	vec2 outputSize;
+	//0 is no sharpening, 1 is the most
+	float sharpness;
+	//0 = clamp, 1 = Reinhard, 2 = ACES
+	uint tonemapOperator;
+} PushConstants;
+
+vec3 Fetch(ivec2 texel)
+{
+	return imageLoad(inputImage, clamp(texel, ivec2(0), ivec2(PushConstants.inputSize) - 1)).rgb;
+}
+
+float Luma(vec3 colour)
+{
+	return dot(colour, vec3(0.299, 0.587, 0.114));
+}
+
+//fast approximation of a Lanczos2 window, zero at integer distances, x2 is the squared distance
+float Lanczos2(float x2)
+{
+	x2 = min(x2, 4.0);
+	float a = (2.0 / 5.0) * x2 - 1.0;
+	float b = (1.0 / 4.0) * x2 - 1.0;
+	return ((25.0 / 16.0) * a * a - (25.0 / 16.0 - 1.0)) * (b * b);
+}
+
+vec3 Tonemap(vec3 colour)
+{
+	colour = max(colour, vec3(0.0));
+	if (PushConstants.tonemapOperator == 1)
+	{
+		colour = colour / (1.0 + colour);
+	}
+	else if (PushConstants.tonemapOperator == 2)
+	{
+		//Narkowicz's fit of the ACES filmic curve
+		colour = (colour * (2.51 * colour + 0.03)) / (colour * (2.43 * colour + 0.59) + 0.14);
+	}
+	return clamp(colour, 0.0, 1.0);
+}
+
+void main()
+{
+	ivec2 outputTexel = ivec2(gl_GlobalInvocationID.xy);
+	if (outputTexel.x >= int(PushConstants.outputSize.x) || outputTexel.y >= int(PushConstants.outputSize.y))
+	{
+		return;
+	}
+
+	//position of the output pixel centre in input texels, relative to texel centres
+	vec2 inputPosition = (vec2(outputTexel) + 0.5) * PushConstants.inputSize / PushConstants.outputSize - 0.5;
+	ivec2 base = ivec2(floor(inputPosition));
+	vec2 fraction = inputPosition - vec2(base);
+
+	//4x4 neighbourhood around the position, with luma compressed so bright HDR values don't dominate the edge detection
+	vec3 texels[4][4];
+	float luma[4][4];
+	for (int y = 0; y < 4; y++)
+	{
+		for (int x = 0; x < 4; x++)
+		{
+			texels[y][x] = Fetch(base + ivec2(x - 1, y - 1));
+			float l = Luma(texels[y][x]);
+			luma[y][x] = l / (1.0 + l);
+		}
+	}
+
+	//gradient of the four texels surrounding the position, bilinearly weighted
+	vec2 gradient = vec2(0.0);
+	for (int y = 1; y <= 2; y++)
+	{
+		for (int x = 1; x <= 2; x++)
+		{
+			float weight = (x == 1 ? 1.0 - fraction.x : fraction.x) * (y == 1 ? 1.0 - fraction.y : fraction.y);
+			gradient += weight * vec2(luma[y][x + 1] - luma[y][x - 1], luma[y + 1][x] - luma[y - 1][x]);
+		}
+	}
+
+	//along an edge the kernel is stretched so the edge stays smooth, across it the kernel stays narrow so it stays sharp,
+	//without any upscaling there is nothing to reconstruct so the kernel stays round
+	float upscaleAmount = clamp(PushConstants.outputSize.x / PushConstants.inputSize.x - 1.0, 0.0, 1.0);
+	float edgeStrength = clamp(length(gradient) * 2.0, 0.0, 1.0) * upscaleAmount;
+	vec2 across = length(gradient) > 1e-5 ? normalize(gradient) : vec2(1.0, 0.0);
+	vec2 along = vec2(-across.y, across.x);
+	float stretch = 1.0 + edgeStrength;
+
+	vec3 colourSum = vec3(0.0);
+	float weightSum = 0.0;
+	for (int y = 0; y < 4; y++)
+	{
+		for (int x = 0; x < 4; x++)
+		{
+			vec2 offset = vec2(x - 1, y - 1) - fraction;
+			float alongDistance = dot(offset, along) / stretch;
+			float acrossDistance = dot(offset, across);
+			float weight = Lanczos2(alongDistance * alongDistance + acrossDistance * acrossDistance);
+			colourSum += texels[y][x] * weight;
+			weightSum += weight;
+		}
+	}
+	vec3 colour = colourSum / max(weightSum, 1e-5);
+
+	//the negative lobes can overshoot, so stay within the range of the four nearest texels
+	vec3 minimum = min(min(texels[1][1], texels[1][2]), min(texels[2][1], texels[2][2]));
+	vec3 maximum = max(max(texels[1][1], texels[1][2]), max(texels[2][1], texels[2][2]));
+	colour = clamp(colour, minimum, maximum);
+
+	colour = Tonemap(colour);
+
+	//contrast adaptive sharpening, using the tonemapped cross around the nearest input texel
+	if (PushConstants.sharpness > 0.0)
+	{
+		ivec2 nearest = ivec2(round(inputPosition)) - base + 1;
+		vec3 north = Tonemap(texels[max(nearest.y - 1, 0)][nearest.x]);
+		vec3 south = Tonemap(texels[min(nearest.y + 1, 3)][nearest.x]);
+		vec3 west = Tonemap(texels[nearest.y][max(nearest.x - 1, 0)]);
+		vec3 east = Tonemap(texels[nearest.y][min(nearest.x + 1, 3)]);
+
+		vec3 crossMinimum = min(min(north, south), min(min(west, east), colour));
+		vec3 crossMaximum = max(max(north, south), max(max(west, east), colour));
+
+		//less sharpening where the local contrast is already high
+		vec3 amplitude = sqrt(clamp(min(crossMinimum, 1.0 - crossMaximum) / max(crossMaximum, 1e-5), 0.0, 1.0));
+		vec3 weight = -amplitude / mix(8.0, 5.0, PushConstants.sharpness);
+		colour = clamp((colour + (north + south + west + east) * weight) / (1.0 + 4.0 * weight), 0.0, 1.0);
+	}
+
+	imageStore(outputImage, outputTexel, vec4(colour, 1.0));
+}
@@ -15,9 +15,25 @@ constexpr bool debug_mode = false;
 constexpr bool debug_mode = true;
 #endif
 
-SDL_AppResult SDL_AppInit(void** appstate, [[maybe_unused]] int argc, [[maybe_unused]] char* argv[]) {
+SDL_AppResult SDL_AppInit(void** appstate, const int argc, char* argv[]) {
 	const std::string name = QUOTE(MYPROJECT_NAME);
-	VulkanEngine* vulkanEngine = new VulkanEngine(name, debug_mode);
+
+	//e.g. --frames-in-flight 3 --draw-format rgba16f
+	uint32_t framesInFlight = 2;
+	VkFormat drawImageFormat = VK_FORMAT_UNDEFINED;
+	for (int i = 1; i + 1 < argc; i++) {
+		if (SDL_strcmp(argv[i], "--frames-in-flight") == 0) {
+			framesInFlight = static_cast<uint32_t>(SDL_atoi(argv[i + 1]));
+		} else if (SDL_strcmp(argv[i], "--draw-format") == 0) {
+			for (const VkFormat format : {VK_FORMAT_B10G11R11_UFLOAT_PACK32, VK_FORMAT_A2B10G10R10_UNORM_PACK32, VK_FORMAT_R16G16B16A16_SFLOAT}) {
+				if (SDL_strcmp(argv[i + 1], vk_util::StorageFormatQualifier(format)) == 0) {
+					drawImageFormat = format;
+				}
+			}
+		}
+	}
+
+	VulkanEngine* vulkanEngine = new VulkanEngine(name, debug_mode, framesInFlight, drawImageFormat);
 	*appstate = vulkanEngine;
 
 	return vulkanEngine->Init(1280, 720);
@@ -31,7 +47,7 @@ SDL_AppResult SDL_AppEvent(void* appstate, SDL_Event* event) {
 
 SDL_AppResult SDL_AppIterate(void* appstate) {
 	VulkanEngine* vulkanEngine = static_cast<VulkanEngine*>(appstate);
-	return vulkanEngine->Draw();
+	return vulkanEngine->Simulate();
 }
 
 void SDL_AppQuit(void* appstate, const SDL_AppResult result) {
@@ -1,13 +1,26 @@
 #pragma once
 
 // C++
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <condition_variable>
 #include <deque>
 #include <filesystem>
+#include <fstream>
 #include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <numeric>
 #include <optional>
+#include <random>
 #include <ranges>
 #include <span>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 // SDL3
@@ -0,0 +1,103 @@
+// Impl
+#include "vk_call_shims.hpp"
+
+namespace {
+	enum class ShimmedFunction : uint32_t {
+#define VK_SHIM_ENUMERATOR(function) function,
+		VK_SHIMMED_FUNCTIONS(VK_SHIM_ENUMERATOR)
+#undef VK_SHIM_ENUMERATOR
+		Count,
+	};
+
+	constexpr std::array<const char*, static_cast<size_t>(ShimmedFunction::Count)> functionNames = {
+#define VK_SHIM_NAME(function) #function,
+		VK_SHIMMED_FUNCTIONS(VK_SHIM_NAME)
+#undef VK_SHIM_NAME
+	};
+
+	// any thread may call into Vulkan, so the counters are shared and only ever added to
+	struct CallCounter {
+		std::atomic<uint64_t> callCount = 0;
+		std::atomic<uint64_t> nanoseconds = 0;
+	};
+	std::array<CallCounter, static_cast<size_t>(ShimmedFunction::Count)> callCounters;
+
+	template<ShimmedFunction function, typename FunctionPointer>
+	struct Shim;
+
+	/// Forwards to the pointer volk loaded and adds the call to the function's counter.
+	template<ShimmedFunction function, typename Return, typename... Arguments>
+	struct Shim<function, Return (VKAPI_PTR*)(Arguments...)> {
+		static inline Return (VKAPI_PTR* original)(Arguments...) = nullptr;
+
+		static Return VKAPI_CALL Call(Arguments... arguments) {
+			//destroyed after the call returns, so functions with and without a result are timed the same way
+			struct CallTimer {
+				uint64_t startTime = SDL_GetTicksNS();
+
+				~CallTimer() {
+					CallCounter& counter = callCounters[static_cast<size_t>(function)];
+					counter.callCount.fetch_add(1, std::memory_order_relaxed);
+					counter.nanoseconds.fetch_add(SDL_GetTicksNS() - startTime, std::memory_order_relaxed);
+				}
+			} timer;
+
+			return original(arguments...);
+		}
+	};
+}
+
+void vk_util::InstallCallShims() {
+#if VK_CALL_SHIMS
+	//a pointer that is already a shim isn't wrapped again, that would make the shim call itself
+#define VK_SHIM_INSTALL(function) \
+	using function##Shim = Shim<ShimmedFunction::function, PFN_##function>; \
+	if (function != nullptr && function != &function##Shim::Call) { \
+		function##Shim::original = function; \
+		function = &function##Shim::Call; \
+	}
+	VK_SHIMMED_FUNCTIONS(VK_SHIM_INSTALL)
+#undef VK_SHIM_INSTALL
+
+	SDL_Log("Counting and timing calls to %zu Vulkan entry points", functionNames.size());
+#endif
+}
+
+void vk_util::TakeCallStats(std::vector<VulkanCallStats>& stats) {
+	if constexpr (!VK_CALL_SHIMS) return;
+
+	const size_t firstNewStat = stats.size();
+	for (size_t i = 0; i < callCounters.size(); i++) {
+		const uint64_t callCount = callCounters[i].callCount.exchange(0, std::memory_order_relaxed);
+		const uint64_t nanoseconds = callCounters[i].nanoseconds.exchange(0, std::memory_order_relaxed);
+		if (callCount == 0) continue;
+
+		stats.push_back(VulkanCallStats{.name = functionNames[i], .callCount = callCount, .nanoseconds = nanoseconds});
+	}
+
+	std::ranges::sort(stats.begin() + static_cast<ptrdiff_t>(firstNewStat), stats.end(), std::ranges::greater{}, &VulkanCallStats::nanoseconds);
+}
+
+void vk_util::DrawCallStatsTable(const std::span<const VulkanCallStats> stats) {
+	if (!ImGui::BeginTable("Vulkan Calls", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) return;
+
+	ImGui::TableSetupColumn("Entry point");
+	ImGui::TableSetupColumn("Calls");
+	ImGui::TableSetupColumn("Total us");
+	ImGui::TableSetupColumn("ns per call");
+	ImGui::TableHeadersRow();
+
+	for (const VulkanCallStats& stat : stats) {
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::TextUnformatted(stat.name);
+		ImGui::TableNextColumn();
+		ImGui::Text("%llu", static_cast<unsigned long long>(stat.callCount));
+		ImGui::TableNextColumn();
+		ImGui::Text("%.1f", static_cast<double>(stat.nanoseconds) / 1'000.0);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.0f", static_cast<double>(stat.nanoseconds) / static_cast<double>(stat.callCount));
+	}
+
+	ImGui::EndTable();
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "mass_includer.hpp"
+
+// set by the VULKAN_HELPERS_CALL_SHIMS CMake option
+#ifndef VK_CALL_SHIMS
+#define VK_CALL_SHIMS 0
+#endif
+
+// the per-frame and per-submit entry points, plus the ones the imgui backend records with
+#define VK_SHIMMED_FUNCTIONS(X) \
+	X(vkAcquireNextImageKHR) \
+	X(vkAllocateDescriptorSets) \
+	X(vkBeginCommandBuffer) \
+	X(vkCmdBeginQuery) \
+	X(vkCmdBeginRendering) \
+	X(vkCmdBindDescriptorSets) \
+	X(vkCmdBindIndexBuffer) \
+	X(vkCmdBindPipeline) \
+	X(vkCmdBindVertexBuffers) \
+	X(vkCmdBlitImage2) \
+	X(vkCmdCopyBuffer) \
+	X(vkCmdCopyBufferToImage) \
+	X(vkCmdDispatch) \
+	X(vkCmdDraw) \
+	X(vkCmdDrawIndexed) \
+	X(vkCmdDrawIndexedIndirectCount) \
+	X(vkCmdEndQuery) \
+	X(vkCmdEndRendering) \
+	X(vkCmdExecuteCommands) \
+	X(vkCmdFillBuffer) \
+	X(vkCmdPipelineBarrier2) \
+	X(vkCmdPushConstants) \
+	X(vkCmdResetQueryPool) \
+	X(vkCmdSetScissor) \
+	X(vkCmdSetViewport) \
+	X(vkCmdWriteTimestamp2) \
+	X(vkEndCommandBuffer) \
+	X(vkGetQueryPoolResults) \
+	X(vkGetSemaphoreCounterValue) \
+	X(vkQueuePresentKHR) \
+	X(vkQueueSubmit2) \
+	X(vkResetCommandBuffer) \
+	X(vkResetCommandPool) \
+	X(vkResetDescriptorPool) \
+	X(vkUpdateDescriptorSets) \
+	X(vkWaitSemaphores)
+
+/// Calls to one Vulkan entry point since the stats were last taken.
+struct VulkanCallStats {
+	const char* name;
+	uint64_t callCount;
+	// CPU time spent in the driver, including the shim's own clock reads
+	uint64_t nanoseconds;
+};
+
+namespace vk_util {
+	/// Replaces volk's pointers to the shimmed entry points with shims that count and time every call, so driver
+	/// overhead can be compared between draw paths without an external profiler. Does nothing unless the build sets
+	/// VK_CALL_SHIMS. Must be called after volkLoadDevice, which would replace the shims again.
+	void InstallCallShims();
+	/// Adds the entry points called since the last call to stats, most time first, and starts counting over.
+	void TakeCallStats(std::vector<VulkanCallStats>& stats);
+	void DrawCallStatsTable(std::span<const VulkanCallStats> stats);
+}
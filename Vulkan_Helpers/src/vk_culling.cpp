@@ -0,0 +1,387 @@
+// Impl
+#include "vk_culling.hpp"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define CULLING_SSE 1
+#else
+#define CULLING_SSE 0
+#endif
+
+namespace {
+	float Component(const math::float3& vector, const uint32_t axis) {
+		return axis == 0 ? vector.x : axis == 1 ? vector.y : vector.z;
+	}
+
+	/// A plane with the bounds arrays that hold the corner of a box furthest along its normal.
+	struct PlaneCorners {
+		math::float4 plane;
+		const float* x;
+		const float* y;
+		const float* z;
+	};
+}
+
+std::array<math::float4, 6> vk_util::FrustumPlanes(const math::float4x4& viewProjection) {
+	//the shaders read the matrix transposed, so what they see as a row is a column here
+	const auto row = [&](const int i) {
+		return math::float4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+	};
+	const auto add = [](const math::float4& a, const math::float4& b) {
+		return math::float4(a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w);
+	};
+	const auto subtract = [](const math::float4& a, const math::float4& b) {
+		return math::float4(a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w);
+	};
+
+	const math::float4 x = row(0);
+	const math::float4 y = row(1);
+	const math::float4 z = row(2);
+	const math::float4 w = row(3);
+	return {add(w, x), subtract(w, x), add(w, y), subtract(w, y), z, subtract(w, z)};
+}
+
+void BvhCuller::Build(const std::span<const math::float3> mins, const std::span<const math::float3> maxs) {
+	const uint32_t objectCount = static_cast<uint32_t>(std::min(mins.size(), maxs.size()));
+
+	std::vector<math::float3> centres(objectCount);
+	objectIds.resize(objectCount);
+	for (uint32_t i = 0; i < objectCount; i++) {
+		centres[i] = math::float3((mins[i].x + maxs[i].x) * 0.5f, (mins[i].y + maxs[i].y) * 0.5f, (mins[i].z + maxs[i].z) * 0.5f);
+		objectIds[i] = i;
+	}
+
+	nodes.clear();
+	jobRoots.clear();
+	jobRootThreadCount = 0;
+	if (objectCount > 0) {
+		nodes.reserve(2 * (objectCount / (maxLeafObjects / 2) + 1));
+		BuildNode(objectIds, 0, centres);
+	}
+
+	//store the bounds in tree order, so every subtree is one contiguous range
+	for (std::vector<float>* component : {&minX, &minY, &minZ, &maxX, &maxY, &maxZ}) {
+		component->resize(objectCount);
+	}
+	objectPositions.resize(objectCount);
+	for (uint32_t position = 0; position < objectCount; position++) {
+		const uint32_t id = objectIds[position];
+		objectPositions[id] = position;
+		minX[position] = mins[id].x;
+		minY[position] = mins[id].y;
+		minZ[position] = mins[id].z;
+		maxX[position] = maxs[id].x;
+		maxY[position] = maxs[id].y;
+		maxZ[position] = maxs[id].z;
+	}
+
+	Refit();
+}
+
+uint32_t BvhCuller::BuildNode(const std::span<uint32_t> ids, const uint32_t firstObject, const std::span<const math::float3> centres) {
+	const uint32_t nodeIndex = static_cast<uint32_t>(nodes.size());
+	//the bounds are filled in by Refit
+	nodes.push_back(Node{
+		.min = {},
+		.max = {},
+		.firstObject = firstObject,
+		.objectCount = static_cast<uint32_t>(ids.size()),
+	});
+	if (ids.size() <= maxLeafObjects) {
+		return nodeIndex;
+	}
+
+	//split at the median centre along the axis the centres are spread out the most on
+	math::float3 centreMin = centres[ids[0]];
+	math::float3 centreMax = centres[ids[0]];
+	for (const uint32_t id : ids) {
+		const math::float3& centre = centres[id];
+		centreMin = math::float3(std::min(centreMin.x, centre.x), std::min(centreMin.y, centre.y), std::min(centreMin.z, centre.z));
+		centreMax = math::float3(std::max(centreMax.x, centre.x), std::max(centreMax.y, centre.y), std::max(centreMax.z, centre.z));
+	}
+	const math::float3 extent(centreMax.x - centreMin.x, centreMax.y - centreMin.y, centreMax.z - centreMin.z);
+	const uint32_t axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+
+	const size_t middle = ids.size() / 2;
+	std::ranges::nth_element(ids, ids.begin() + static_cast<std::ptrdiff_t>(middle), {}, [&](const uint32_t id) { return Component(centres[id], axis); });
+
+	BuildNode(ids.first(middle), firstObject, centres);
+	const uint32_t rightChild = BuildNode(ids.subspan(middle), firstObject + static_cast<uint32_t>(middle), centres);
+	nodes[nodeIndex].rightChild = rightChild;
+
+	return nodeIndex;
+}
+
+void BvhCuller::SetBounds(const uint32_t id, const math::float3& min, const math::float3& max) {
+	const uint32_t position = objectPositions[id];
+	minX[position] = min.x;
+	minY[position] = min.y;
+	minZ[position] = min.z;
+	maxX[position] = max.x;
+	maxY[position] = max.y;
+	maxZ[position] = max.z;
+}
+
+void BvhCuller::Refit() {
+	//children always come after their parent, so going backwards visits them first
+	for (size_t i = nodes.size(); i-- > 0;) {
+		Node& node = nodes[i];
+		if (node.rightChild == 0) {
+			const uint32_t first = node.firstObject;
+			const uint32_t end = first + node.objectCount;
+			node.min = math::float3(minX[first], minY[first], minZ[first]);
+			node.max = math::float3(maxX[first], maxY[first], maxZ[first]);
+			for (uint32_t position = first + 1; position < end; position++) {
+				node.min = math::float3(std::min(node.min.x, minX[position]), std::min(node.min.y, minY[position]), std::min(node.min.z, minZ[position]));
+				node.max = math::float3(std::max(node.max.x, maxX[position]), std::max(node.max.y, maxY[position]), std::max(node.max.z, maxZ[position]));
+			}
+		} else {
+			const Node& left = nodes[i + 1];
+			const Node& right = nodes[node.rightChild];
+			node.min = math::float3(std::min(left.min.x, right.min.x), std::min(left.min.y, right.min.y), std::min(left.min.z, right.min.z));
+			node.max = math::float3(std::max(left.max.x, right.max.x), std::max(left.max.y, right.max.y), std::max(left.max.z, right.max.z));
+		}
+	}
+}
+
+void BvhCuller::PickJobRoots(const uint32_t threadCount) {
+	//a few jobs per thread, so a thread that drew mostly culled subtrees can pick up more
+	const size_t targetCount = static_cast<size_t>(threadCount) * 4;
+
+	jobRoots.assign(1, 0);
+	while (jobRoots.size() < targetCount) {
+		std::vector<uint32_t> nextRoots;
+		nextRoots.reserve(jobRoots.size() * 2);
+		bool split = false;
+		for (const uint32_t root : jobRoots) {
+			if (nodes[root].rightChild == 0) {
+				nextRoots.push_back(root);
+			} else {
+				nextRoots.push_back(root + 1);
+				nextRoots.push_back(nodes[root].rightChild);
+				split = true;
+			}
+		}
+		if (!split) break;
+		jobRoots = std::move(nextRoots);
+	}
+
+	jobRootThreadCount = threadCount;
+	jobVisible.resize(jobRoots.size());
+}
+
+void BvhCuller::Cull(const math::float4x4& viewProjection, JobPool& jobPool, std::vector<uint32_t>& visible) {
+	visible.clear();
+	if (nodes.empty()) return;
+
+	const std::array<math::float4, 6> planes = vk_util::FrustumPlanes(viewProjection);
+	if (jobRootThreadCount != jobPool.GetThreadCount()) {
+		PickJobRoots(jobPool.GetThreadCount());
+	}
+
+	jobPool.ParallelFor(static_cast<uint32_t>(jobRoots.size()), [&](const uint32_t job) {
+		jobVisible[job].clear();
+		CullSubtree(jobRoots[job], planes, jobVisible[job]);
+	});
+
+	size_t visibleCount = 0;
+	for (const std::vector<uint32_t>& jobResult : jobVisible) {
+		visibleCount += jobResult.size();
+	}
+	visible.reserve(visibleCount);
+	for (const std::vector<uint32_t>& jobResult : jobVisible) {
+		visible.insert(visible.end(), jobResult.begin(), jobResult.end());
+	}
+}
+
+void BvhCuller::CullLinear(const math::float4x4& viewProjection, std::vector<uint32_t>& visible) const {
+	visible.clear();
+	CullRange(0, static_cast<uint32_t>(objectIds.size()), vk_util::FrustumPlanes(viewProjection), (1u << 6) - 1, visible);
+}
+
+void BvhCuller::CullSubtree(const uint32_t rootNode, const std::array<math::float4, 6>& planes, std::vector<uint32_t>& visible) const {
+	struct StackEntry {
+		uint32_t node;
+		// planes the parent wasn't fully inside of, the others don't need testing anymore
+		uint32_t planeMask;
+	};
+	//median splits keep the tree balanced, so its depth stays far below this
+	std::array<StackEntry, 64> stack;
+	uint32_t stackSize = 0;
+	stack[stackSize++] = StackEntry{rootNode, (1u << 6) - 1};
+
+	while (stackSize > 0) {
+		const StackEntry entry = stack[--stackSize];
+		const Node& node = nodes[entry.node];
+
+		bool outside = false;
+		uint32_t planeMask = entry.planeMask;
+		for (uint32_t i = 0; i < planes.size(); i++) {
+			if ((planeMask & (1u << i)) == 0) continue;
+
+			const math::float4& plane = planes[i];
+			//the corner furthest along the normal is the last one to leave the plane, the nearest one the first
+			const float furthest = plane.x * (plane.x >= 0.0f ? node.max.x : node.min.x) + plane.y * (plane.y >= 0.0f ? node.max.y : node.min.y) + plane.z * (plane.z >= 0.0f ? node.max.z : node.min.z) + plane.w;
+			if (furthest < 0.0f) {
+				outside = true;
+				break;
+			}
+			const float nearest = plane.x * (plane.x >= 0.0f ? node.min.x : node.max.x) + plane.y * (plane.y >= 0.0f ? node.min.y : node.max.y) + plane.z * (plane.z >= 0.0f ? node.min.z : node.max.z) + plane.w;
+			if (nearest >= 0.0f) {
+				planeMask &= ~(1u << i);
+			}
+		}
+		if (outside) continue;
+
+		if (planeMask == 0) {
+			//fully inside, so is everything below it
+			visible.insert(visible.end(), objectIds.begin() + node.firstObject, objectIds.begin() + node.firstObject + node.objectCount);
+		} else if (node.rightChild == 0) {
+			CullRange(node.firstObject, node.objectCount, planes, planeMask, visible);
+		} else {
+			stack[stackSize++] = StackEntry{node.rightChild, planeMask};
+			stack[stackSize++] = StackEntry{entry.node + 1, planeMask};
+		}
+	}
+}
+
+void BvhCuller::CullRange(const uint32_t first, const uint32_t count, const std::array<math::float4, 6>& planes, const uint32_t planeMask, std::vector<uint32_t>& visible) const {
+	std::array<PlaneCorners, 6> activePlanes;
+	uint32_t activePlaneCount = 0;
+	for (uint32_t i = 0; i < planes.size(); i++) {
+		if ((planeMask & (1u << i)) == 0) continue;
+		const math::float4& plane = planes[i];
+		activePlanes[activePlaneCount++] = PlaneCorners{
+			.plane = plane,
+			.x = plane.x >= 0.0f ? maxX.data() : minX.data(),
+			.y = plane.y >= 0.0f ? maxY.data() : minY.data(),
+			.z = plane.z >= 0.0f ? maxZ.data() : minZ.data(),
+		};
+	}
+
+	uint32_t position = first;
+	const uint32_t end = first + count;
+#if CULLING_SSE
+	for (; position + 4 <= end; position += 4) {
+		__m128 outside = _mm_setzero_ps();
+		for (uint32_t i = 0; i < activePlaneCount; i++) {
+			const PlaneCorners& corners = activePlanes[i];
+			__m128 distance = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(corners.plane.x), _mm_loadu_ps(corners.x + position)), _mm_set1_ps(corners.plane.w));
+			distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(corners.plane.y), _mm_loadu_ps(corners.y + position)));
+			distance = _mm_add_ps(distance, _mm_mul_ps(_mm_set1_ps(corners.plane.z), _mm_loadu_ps(corners.z + position)));
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_setzero_ps()));
+		}
+		for (uint32_t visibleBits = ~static_cast<uint32_t>(_mm_movemask_ps(outside)) & 0xF; visibleBits != 0; visibleBits &= visibleBits - 1) {
+			visible.push_back(objectIds[position + std::countr_zero(visibleBits)]);
+		}
+	}
+#endif
+	//the boxes that don't fill a whole register
+	for (; position < end; position++) {
+		bool outside = false;
+		for (uint32_t i = 0; i < activePlaneCount && !outside; i++) {
+			const PlaneCorners& corners = activePlanes[i];
+			outside = corners.plane.x * corners.x[position] + corners.plane.y * corners.y[position] + corners.plane.z * corners.z[position] + corners.plane.w < 0.0f;
+		}
+		if (!outside) {
+			visible.push_back(objectIds[position]);
+		}
+	}
+}
+
+std::vector<CullingBenchmarkResult> vk_util::RunCullingBenchmark(const math::float4x4& viewProjection, const float sceneRadius, JobPool& jobPool) {
+	constexpr uint32_t cullRuns = 8;
+	constexpr double nanosecondsToMilliseconds = 1.0 / 1'000'000.0;
+
+	//a fixed seed, so every run culls the same boxes
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> positionDistribution(-sceneRadius, sceneRadius);
+	std::uniform_real_distribution<float> halfSizeDistribution(sceneRadius * 0.001f, sceneRadius * 0.01f);
+	std::uniform_real_distribution<float> moveDistribution(-sceneRadius * 0.005f, sceneRadius * 0.005f);
+
+	std::vector<CullingBenchmarkResult> results;
+	for (const uint32_t objectCount : cullingBenchmarkObjectCounts) {
+		std::vector<math::float3> mins(objectCount);
+		std::vector<math::float3> maxs(objectCount);
+		for (uint32_t i = 0; i < objectCount; i++) {
+			const math::float3 centre(positionDistribution(random), positionDistribution(random), positionDistribution(random));
+			const float halfSize = halfSizeDistribution(random);
+			mins[i] = math::float3(centre.x - halfSize, centre.y - halfSize, centre.z - halfSize);
+			maxs[i] = math::float3(centre.x + halfSize, centre.y + halfSize, centre.z + halfSize);
+		}
+
+		CullingBenchmarkResult result{.objectCount = objectCount};
+		BvhCuller culler;
+
+		uint64_t start = SDL_GetTicksNS();
+		culler.Build(mins, maxs);
+		result.buildTime = static_cast<double>(SDL_GetTicksNS() - start) * nanosecondsToMilliseconds;
+
+		//every box moves a little, like in an animated scene between two frames
+		for (uint32_t i = 0; i < objectCount; i++) {
+			const math::float3 offset(moveDistribution(random), moveDistribution(random), moveDistribution(random));
+			culler.SetBounds(i, math::float3(mins[i].x + offset.x, mins[i].y + offset.y, mins[i].z + offset.z), math::float3(maxs[i].x + offset.x, maxs[i].y + offset.y, maxs[i].z + offset.z));
+		}
+		start = SDL_GetTicksNS();
+		culler.Refit();
+		result.refitTime = static_cast<double>(SDL_GetTicksNS() - start) * nanosecondsToMilliseconds;
+
+		//the first cull picks the job subtrees and grows the result lists, which later frames don't pay for
+		std::vector<uint32_t> visible;
+		culler.Cull(viewProjection, jobPool, visible);
+
+		start = SDL_GetTicksNS();
+		for (uint32_t run = 0; run < cullRuns; run++) {
+			culler.Cull(viewProjection, jobPool, visible);
+		}
+		result.cullTime = static_cast<double>(SDL_GetTicksNS() - start) * nanosecondsToMilliseconds / cullRuns;
+		result.visibleCount = visible.size();
+
+		start = SDL_GetTicksNS();
+		for (uint32_t run = 0; run < cullRuns; run++) {
+			culler.CullLinear(viewProjection, visible);
+		}
+		result.linearCullTime = static_cast<double>(SDL_GetTicksNS() - start) * nanosecondsToMilliseconds / cullRuns;
+
+		SDL_Log("Culled %u objects on %u threads: build %.3f ms, refit %.3f ms, cull %.3f ms (%.0f objects/ms), linear cull %.3f ms (%.0f objects/ms), %zu visible",
+			objectCount, jobPool.GetThreadCount(), result.buildTime, result.refitTime,
+			result.cullTime, objectCount / std::max(result.cullTime, 1e-6),
+			result.linearCullTime, objectCount / std::max(result.linearCullTime, 1e-6), result.visibleCount);
+		results.push_back(result);
+	}
+
+	return results;
+}
+
+void vk_util::DrawCullingBenchmarkTable(const std::span<const CullingBenchmarkResult> results) {
+	if (!ImGui::BeginTable("Culling Benchmark Results", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) return;
+
+	ImGui::TableSetupColumn("Objects");
+	ImGui::TableSetupColumn("Visible");
+	ImGui::TableSetupColumn("Build ms");
+	ImGui::TableSetupColumn("Refit ms");
+	ImGui::TableSetupColumn("Cull ms");
+	ImGui::TableSetupColumn("Objects/ms");
+	ImGui::TableSetupColumn("Linear Objects/ms");
+	ImGui::TableHeadersRow();
+
+	for (const CullingBenchmarkResult& result : results) {
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::Text("%u", result.objectCount);
+		ImGui::TableNextColumn();
+		ImGui::Text("%zu", result.visibleCount);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", result.buildTime);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", result.refitTime);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", result.cullTime);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.0f", result.objectCount / std::max(result.cullTime, 1e-6));
+		ImGui::TableNextColumn();
+		ImGui::Text("%.0f", result.objectCount / std::max(result.linearCullTime, 1e-6));
+	}
+
+	ImGui::EndTable();
+}
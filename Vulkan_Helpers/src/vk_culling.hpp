@@ -0,0 +1,86 @@
+#pragma once
+
+#include "mass_includer.hpp"
+
+// Engine
+#include "vk_job_pool.hpp"
+
+namespace vk_util {
+	/// Planes of the clip space volume -w <= x, y <= w and 0 <= z <= w, the same ones cull.comp.glsl tests against.
+	/// A point is inside a plane when dot(plane.xyz, point) + plane.w >= 0. The planes aren't normalised.
+	[[nodiscard]] std::array<math::float4, 6> FrustumPlanes(const math::float4x4& viewProjection);
+}
+
+/// Frustum culling of axis aligned bounding boxes on the CPU, through a bounding volume hierarchy.
+/// The boxes are kept in tree order as a structure of arrays, so every subtree covers a contiguous range of them:
+/// a subtree that is fully inside the frustum is accepted without testing its boxes, and the boxes of a leaf
+/// are tested four at a time with SSE. Subtrees below the top levels are culled in parallel on a job pool.
+class BvhCuller {
+	struct Node {
+		math::float3 min;
+		math::float3 max;
+		// the boxes of the whole subtree
+		uint32_t firstObject = 0;
+		uint32_t objectCount = 0;
+		// the left child directly follows its parent, 0 means this is a leaf
+		uint32_t rightChild = 0;
+	};
+
+	// bounds in tree order, one array per component so four boxes load into one register per component
+	std::vector<float> minX, minY, minZ;
+	std::vector<float> maxX, maxY, maxZ;
+	// object id of every box in tree order, and the position in tree order of every object id
+	std::vector<uint32_t> objectIds;
+	std::vector<uint32_t> objectPositions;
+	std::vector<Node> nodes;
+
+	// subtrees that are culled as separate jobs, picked for the thread count of the pool they were last culled on
+	std::vector<uint32_t> jobRoots;
+	uint32_t jobRootThreadCount = 0;
+	std::vector<std::vector<uint32_t>> jobVisible;
+
+	/// Splits ids in two until the halves fit in a leaf, ordering them the way the boxes are stored.
+	uint32_t BuildNode(std::span<uint32_t> ids, uint32_t firstObject, std::span<const math::float3> centres);
+	void PickJobRoots(uint32_t threadCount);
+	void CullSubtree(uint32_t rootNode, const std::array<math::float4, 6>& planes, std::vector<uint32_t>& visible) const;
+	/// Appends the ids of the boxes in [first, first + count) that aren't outside any plane in planeMask.
+	void CullRange(uint32_t first, uint32_t count, const std::array<math::float4, 6>& planes, uint32_t planeMask, std::vector<uint32_t>& visible) const;
+
+public:
+	static constexpr uint32_t maxLeafObjects = 16;
+
+	/// Builds the hierarchy over the given boxes, the id of a box is its index.
+	void Build(std::span<const math::float3> mins, std::span<const math::float3> maxs);
+	/// Moves a box. The hierarchy only encloses it again after Refit.
+	void SetBounds(uint32_t id, const math::float3& min, const math::float3& max);
+	/// Recomputes the bounds of every node bottom-up, keeping the tree structure.
+	/// Cheaper than a rebuild, but the tree gets looser the further boxes move from where they were built.
+	void Refit();
+
+	/// Replaces the contents of visible with the ids of all boxes that intersect the frustum.
+	void Cull(const math::float4x4& viewProjection, JobPool& jobPool, std::vector<uint32_t>& visible);
+	/// Same as Cull, but tests every box on one thread without the hierarchy. A baseline for the benchmark.
+	void CullLinear(const math::float4x4& viewProjection, std::vector<uint32_t>& visible) const;
+
+	[[nodiscard]] size_t GetObjectCount() const { return objectIds.size(); }
+	[[nodiscard]] size_t GetNodeCount() const { return nodes.size(); }
+};
+
+struct CullingBenchmarkResult {
+	uint32_t objectCount = 0;
+	size_t visibleCount = 0;
+	double buildTime = 0.0;
+	double refitTime = 0.0;
+	double cullTime = 0.0;
+	double linearCullTime = 0.0;
+};
+
+namespace vk_util {
+	/// Object counts the culling benchmark runs with.
+	inline constexpr std::array cullingBenchmarkObjectCounts = {10'000u, 100'000u, 1'000'000u};
+
+	/// Culls randomly placed boxes in a cube around the origin with the given view-projection, for every benchmark object count.
+	/// Times are in milliseconds, cull times are averaged over several runs.
+	[[nodiscard]] std::vector<CullingBenchmarkResult> RunCullingBenchmark(const math::float4x4& viewProjection, float sceneRadius, JobPool& jobPool);
+	void DrawCullingBenchmarkTable(std::span<const CullingBenchmarkResult> results);
+}
@@ -9,28 +9,107 @@ struct DeletionQueue {
 		deleters.push_back(function);
 	}
 
-	void Flush() {
+	/// @return The number of deleters that ran.
+	size_t Flush() {
 		// reverse iterate the deletion queue to execute all the functions
 		for (auto& deleter : std::ranges::reverse_view(deleters)) {
 			deleter(); //call functors
 		}
 
+		const size_t flushedCount = deleters.size();
 		deleters.clear();
+		return flushedCount;
 	}
 };
 
+/// Deletion queue for resources the GPU may still be using, each deleter runs once the frame timeline reaches its value.
+struct TimelineDeletionQueue {
+	std::deque<std::pair<uint64_t, std::function<void()>>> deleters;
+
+	void PushFunction(const uint64_t timelineValue, std::function<void()>&& function) {
+		//kept sorted, as resources may be retired further ahead than ones pushed after them
+		const auto position = std::ranges::upper_bound(deleters, timelineValue, std::ranges::less{}, [](const auto& deleter) { return deleter.first; });
+		deleters.emplace(position, timelineValue, std::move(function));
+	}
+
+	/// @return The number of deleters that ran.
+	size_t Flush(const uint64_t completedTimelineValue) {
+		// the deleters are sorted by value, so everything that is done is at the front
+		size_t flushedCount = 0;
+		while (!deleters.empty() && deleters.front().first <= completedTimelineValue) {
+			deleters.front().second();
+			deleters.pop_front();
+			flushedCount++;
+		}
+		return flushedCount;
+	}
+
+	void FlushAll() {
+		for (auto& [timelineValue, deleter] : deleters) {
+			deleter();
+		}
+
+		deleters.clear();
+	}
+};
+
+/// What an image is used for next. Decides the layout and the precise stage and access masks of a barrier.
+enum class ImageUsage {
+	Undefined,
+	ComputeRead,
+	ComputeWrite,
+	ComputeReadWrite,
+	ColourAttachment,
+	DepthAttachment,
+	TransferSrc,
+	TransferDst,
+	ShaderRead,
+	Present,
+};
+
+/// What a buffer is used for next. Decides the stage and access masks of a barrier.
+enum class BufferUsage {
+	Undefined,
+	IndirectRead,
+	IndexRead,
+	VertexShaderRead,
+	UniformRead,
+	ComputeRead,
+	ComputeWrite,
+	ComputeReadWrite,
+	TransferSrc,
+	TransferDst,
+};
+
+/// The layout an image is in, and the stages and accesses of its last use.
+struct ImageState {
+	VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	VkPipelineStageFlags2 stageMask = VK_PIPELINE_STAGE_2_NONE;
+	VkAccessFlags2 accessMask = VK_ACCESS_2_NONE;
+};
+
+/// The stages and accesses of a buffer's last use.
+struct BufferState {
+	VkPipelineStageFlags2 stageMask = VK_PIPELINE_STAGE_2_NONE;
+	VkAccessFlags2 accessMask = VK_ACCESS_2_NONE;
+};
+
 struct AllocatedImage {
 	VkImage image;
 	VkImageView imageView;
 	VmaAllocation allocation;
 	VkExtent3D imageExtent;
 	VkFormat imageFormat;
+	ImageState state;
 };
 
 struct AllocatedBuffer {
 	VkBuffer internalBuffer;
 	VmaAllocation allocation;
 	VmaAllocationInfo allocationInfo;
+	// as requested at creation, the allocation can be larger
+	VkDeviceSize size;
+	BufferState state;
 };
 
 struct MyVertex {
@@ -47,7 +126,29 @@ struct GPUMeshBuffers {
 	VkDeviceAddress vertexBufferAddress;
 };
 
+struct WorkgroupSize {
+	uint32_t x = 16;
+	uint32_t y = 16;
+};
+
 struct GPUDrawPushConstants {
 	math::float4x4 worldMatrix;
 	VkDeviceAddress vertexBufferAddress;
+	VkDeviceAddress instanceBufferAddress;
+};
+
+/// Per-object data, read by the culling compute shader and by the vertex shader through gl_InstanceIndex.
+struct GPUInstance {
+	math::float4x4 transform;
+	math::float4 boundingSphere; //object space centre in xyz, radius in w
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	int32_t vertexOffset;
+	uint32_t materialIndex;
+};
+
+/// Per-instance data of an instanced draw, written by the CPU every frame and read by triangle_instanced.vert through gl_InstanceIndex.
+struct GPUInstanceData {
+	math::float4x4 transform;
+	math::float4 colour;
 };
@@ -102,6 +102,7 @@ void DescriptorAllocatorGrowable::ClearPools(const VkDevice& device) {
 		readyPools.push_back(p);
 	}
 	fullPools.clear();
+	allocatedSetCount = 0;
 }
 
 void DescriptorAllocatorGrowable::DestroyPools(const VkDevice& device) {
@@ -140,6 +141,7 @@ std::optional<VkDescriptorSet> DescriptorAllocatorGrowable::Allocate(const VkDev
 	}
 
 	readyPools.push_back(poolToUse);
+	allocatedSetCount++;
 	return ds;
 }
 
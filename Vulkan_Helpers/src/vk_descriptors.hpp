@@ -37,6 +37,8 @@ public:
 	void DestroyPools(const VkDevice& device);
 
 	[[nodiscard]] std::optional<VkDescriptorSet> Allocate(const VkDevice& device, const VkDescriptorSetLayout& layout, const void* pNext = nullptr);
+	/// @return The sets allocated since the pools were last cleared.
+	[[nodiscard]] uint32_t GetAllocatedSetCount() const { return allocatedSetCount; }
 
 private:
 	[[nodiscard]] VkDescriptorPool GetPool(const VkDevice& device);
@@ -46,6 +48,7 @@ private:
 	std::vector<VkDescriptorPool> fullPools;
 	std::vector<VkDescriptorPool> readyPools;
 	uint32_t setsPerPool = 0;
+	uint32_t allocatedSetCount = 0;
 };
 
 struct DescriptorWriter {
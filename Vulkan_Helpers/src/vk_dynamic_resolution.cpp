@@ -0,0 +1,47 @@
+// Impl
+#include "vk_dynamic_resolution.hpp"
+
+float DynamicResolutionController::Update(const double gpuFrameTime, const float currentScale) {
+	if (!enabled || gpuFrameTime <= 0.0) {
+		return currentScale;
+	}
+
+	smoothedGpuTime = smoothedSampleCount == 0 ? gpuFrameTime : smoothedGpuTime + (gpuFrameTime - smoothedGpuTime) * smoothing;
+	smoothedSampleCount++;
+
+	if (framesUntilNextChange > 0) {
+		framesUntilNextChange--;
+		return currentScale;
+	}
+
+	//inside the band around the target nothing changes, that's what keeps it from oscillating
+	const double target = targetFrameTime;
+	if (smoothedGpuTime <= target * (1.0 + overBudgetMargin) && smoothedGpuTime >= target * (1.0 - underBudgetMargin)) {
+		return currentScale;
+	}
+
+	//GPU time scales with the pixel count, so with the square of the render scale
+	const float idealScale = currentScale * static_cast<float>(std::sqrt(target / smoothedGpuTime));
+	const float step = std::clamp(idealScale - currentScale, -maxStep, maxStep);
+	const float newScale = std::clamp(currentScale + step, minScale, maxScale);
+
+	if (newScale != currentScale) {
+		//the average still holds frames at the old scale, so start over with the next samples
+		smoothedSampleCount = 0;
+		framesUntilNextChange = cooldownFrames;
+	}
+
+	return newScale;
+}
+
+void DynamicResolutionController::DrawImGui() {
+	ImGui::Checkbox("Dynamic Resolution", &enabled);
+	if (!enabled) return;
+
+	float targetFrameRate = 1000.0f / targetFrameTime;
+	if (ImGui::SliderFloat("Target FPS", &targetFrameRate, 30.0f, 240.0f, "%.0f")) {
+		targetFrameTime = 1000.0f / std::max(targetFrameRate, 1.0f);
+	}
+	ImGui::SliderFloat("Min Scale", &minScale, 0.1f, maxScale);
+	ImGui::Text("Smoothed GPU time: %.3f ms (target %.3f ms)", smoothedGpuTime, targetFrameTime);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "mass_includer.hpp"
+
+/// Drives the render scale from the measured GPU frame time, so the frame rate stays stable under varying load.
+/// GPU time is smoothed with an exponential moving average, and the scale only changes once the average leaves
+/// a band around the target, which is wider below the target than above it so the scale doesn't oscillate.
+class DynamicResolutionController {
+	double smoothedGpuTime = 0.0;
+	uint32_t smoothedSampleCount = 0;
+	// measurements lag behind by the frames in flight, so the scale holds still for a while after every change
+	uint32_t framesUntilNextChange = 0;
+
+public:
+	bool enabled = false;
+	float targetFrameTime = 1000.0f / 60.0f;
+	float minScale = 0.3f;
+	float maxScale = 1.0f;
+	/// Weight of the newest sample in the moving average.
+	float smoothing = 0.1f;
+	/// Scale down once the GPU time is this fraction over the target.
+	float overBudgetMargin = 0.02f;
+	/// Only scale up once the GPU time is this fraction under the target.
+	float underBudgetMargin = 0.15f;
+	/// Largest change to the scale in one step.
+	float maxStep = 0.05f;
+	uint32_t cooldownFrames = 8;
+
+	/// @param gpuFrameTime GPU time of a finished frame in milliseconds.
+	/// @return The render scale to use from now on.
+	[[nodiscard]] float Update(double gpuFrameTime, float currentScale);
+
+	[[nodiscard]] double GetSmoothedGpuTime() const { return smoothedGpuTime; }
+
+	void DrawImGui();
+};
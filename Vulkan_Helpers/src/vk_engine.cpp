@@ -33,6 +33,41 @@ uint32_t packUnorm4x8(math::float4 const& v) {
 	return u.out;
 }
 
+//the translation goes in the last row, which is the last column once the shaders read the matrix
+math::float4x4 TranslationScaleMatrix(const math::float3& translation, const float scale) {
+	math::float4x4 matrix;
+	for (int row = 0; row < 4; row++) {
+		for (int column = 0; column < 4; column++) {
+			matrix[row][column] = row == column ? scale : 0.0f;
+		}
+	}
+	matrix[3][0] = translation.x;
+	matrix[3][1] = translation.y;
+	matrix[3][2] = translation.z;
+	matrix[3][3] = 1.0f;
+	return matrix;
+}
+
+//rotates around the vertical axis through pivot, laid out like TranslationScaleMatrix
+math::float4x4 SpinMatrix(const math::float3& pivot, const float angle) {
+	const float c = std::cos(angle);
+	const float s = std::sin(angle);
+	math::float4x4 matrix;
+	for (int row = 0; row < 4; row++) {
+		for (int column = 0; column < 4; column++) {
+			matrix[row][column] = row == column ? 1.0f : 0.0f;
+		}
+	}
+	matrix[0][0] = c;
+	matrix[0][2] = -s;
+	matrix[2][0] = s;
+	matrix[2][2] = c;
+	//the pivot stays in place, so a bounding sphere around it still bounds the rotated mesh
+	matrix[3][0] = pivot.x - (c * pivot.x + s * pivot.z);
+	matrix[3][2] = pivot.z - (c * pivot.z - s * pivot.x);
+	return matrix;
+}
+
 #pragma region Vulkan Initialization
 
 SDL_AppResult VulkanEngine::InitVulkan() {
@@ -79,6 +114,7 @@ SDL_AppResult VulkanEngine::InitVulkan() {
 	VkPhysicalDeviceVulkan12Features features12{
 		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
 		.descriptorIndexing = true,
+		.timelineSemaphore = true,
 		.bufferDeviceAddress = true,
 	};
 
@@ -97,7 +133,43 @@ SDL_AppResult VulkanEngine::InitVulkan() {
 	}
 
 	//Yoink the physical device from the result
-	const vkb::PhysicalDevice& vkbPhysicalDevice = resVkbPhysicalDevice.value();
+	vkb::PhysicalDevice& vkbPhysicalDevice = resVkbPhysicalDevice.value();
+
+	//the compute upscaler writes the swapchain image, whose format differs per platform, so it's written without a format
+	constexpr VkPhysicalDeviceFeatures optionalFeatures{
+		.shaderStorageImageWriteWithoutFormat = true,
+	};
+	storageImageWriteWithoutFormat = vkbPhysicalDevice.enable_features_if_present(optionalFeatures);
+	//the compact draw image formats can only be declared in shaders with the extended storage formats
+	constexpr VkPhysicalDeviceFeatures extendedFormatFeatures{
+		.shaderStorageImageExtendedFormats = true,
+	};
+	storageImageExtendedFormats = vkbPhysicalDevice.enable_features_if_present(extendedFormatFeatures);
+	//the GPU-driven draw writes one indirect command per visible instance, each starting at its own instance
+	constexpr VkPhysicalDeviceFeatures indirectFeatures{
+		.multiDrawIndirect = true,
+		.drawIndirectFirstInstance = true,
+	};
+	constexpr VkPhysicalDeviceVulkan12Features indirectCountFeatures{
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+		.drawIndirectCount = true,
+	};
+	drawIndirectCountSupported = vkbPhysicalDevice.enable_features_if_present(indirectFeatures) && vkbPhysicalDevice.enable_extension_features_if_present(indirectCountFeatures);
+
+	//Pipeline statistics count the shader invocations of every render graph pass, inherited queries keep counting through secondary command buffers
+	constexpr VkPhysicalDeviceFeatures statisticsFeatures{
+		.pipelineStatisticsQuery = true,
+	};
+	pipelineStatisticsSupported = vkbPhysicalDevice.enable_features_if_present(statisticsFeatures);
+	constexpr VkPhysicalDeviceFeatures inheritedQueryFeatures{
+		.inheritedQueries = true,
+	};
+	inheritedQueriesSupported = pipelineStatisticsSupported && vkbPhysicalDevice.enable_features_if_present(inheritedQueryFeatures);
+
+	//Lines the GPU scopes up with the CPU scopes in traces
+	calibratedTimestampsSupported = vkbPhysicalDevice.enable_extension_if_present(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+	//Without it VMA only estimates the budget from its own allocations, blind to other processes and driver memory
+	memoryBudgetSupported = vkbPhysicalDevice.enable_extension_if_present(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
 
 	//Use VkBootstrap to create the final Vulkan Device
 	vkb::DeviceBuilder deviceBuilder(vkbPhysicalDevice);
@@ -114,6 +186,7 @@ SDL_AppResult VulkanEngine::InitVulkan() {
 	device = vkbDevice.device;
 	physicalDevice = vkbPhysicalDevice.physical_device;
 	volkLoadDevice(device);
+	vk_util::InstallCallShims();
 
 	//Set up the Queue
 	vkb::QueueType queueType = vkb::QueueType::graphics;
@@ -131,6 +204,18 @@ SDL_AppResult VulkanEngine::InitVulkan() {
 	}
 	graphicsQueueFamilyIndex = queueIndex.value();
 
+	//Timestamps are needed to benchmark on the actual device, so check whether the graphics queue writes them
+	physicalDeviceProperties = vkbPhysicalDevice.properties;
+	graphicsQueueTimestampValidBits = vkbPhysicalDevice.get_queue_families()[graphicsQueueFamilyIndex].timestampValidBits;
+
+	//Load the workgroup sizes tuned for this device during earlier runs
+	char* prefPath = SDL_GetPrefPath("Rythe-Interactive", name.c_str());
+	userDataDirectory = prefPath != nullptr ? prefPath : SDL_GetBasePath();
+	SDL_free(prefPath);
+	workgroupSizeCache.Load(userDataDirectory / "workgroup_sizes.cache", physicalDeviceProperties);
+
+	SelectDrawImageFormat();
+
 	// Set up VMA
 	VmaAllocatorCreateInfo allocatorCreateInfo{
 		.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT,
@@ -145,13 +230,96 @@ SDL_AppResult VulkanEngine::InitVulkan() {
 	vmaImportVulkanFunctionsFromVolk(&allocatorCreateInfo, &vmaVulkanFunctions);
 	allocatorCreateInfo.pVulkanFunctions = &vmaVulkanFunctions;
 
+	if (memoryBudgetSupported) {
+		allocatorCreateInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+	}
+
 	VK_CHECK(vmaCreateAllocator(&allocatorCreateInfo, &vmaAllocator), "Couldn't create VMA allocator");
 
-	mainDeletionQueue.PushFunction([&] { vmaDestroyAllocator(vmaAllocator); });
+	initGraph.PushDeleter([&] { vmaDestroyAllocator(vmaAllocator); });
+	memoryTracker.Init(vmaAllocator);
+
+	//Meshes get a pool of their own, so defragmenting it only ever moves buffers the engine knows how to rebind
+	const VkBufferCreateInfo meshBufferInfo{
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = 1024,
+		.usage = meshBufferUsage,
+	};
+	constexpr VmaAllocationCreateInfo directMeshAllocationInfo{
+		.flags = directUploadFlags,
+		.usage = VMA_MEMORY_USAGE_AUTO,
+	};
+	uint32_t meshMemoryTypeIndex;
+	VK_CHECK(vmaFindMemoryTypeIndexForBufferInfo(vmaAllocator, &meshBufferInfo, &directMeshAllocationInfo, &meshMemoryTypeIndex), "Couldn't find a memory type for meshes");
+
+	//Without resizable BAR the host visible device local heap is a small window, too small to hold every mesh
+	const VkPhysicalDeviceMemoryProperties* memoryProperties;
+	vmaGetMemoryProperties(vmaAllocator, &memoryProperties);
+	const VkMemoryType& meshMemoryType = memoryProperties->memoryTypes[meshMemoryTypeIndex];
+	constexpr VkMemoryPropertyFlags directUploadProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+	directMeshUploads = (meshMemoryType.propertyFlags & directUploadProperties) == directUploadProperties
+		&& memoryProperties->memoryHeaps[meshMemoryType.heapIndex].size > barWindowSize;
+	if (!directMeshUploads) {
+		constexpr VmaAllocationCreateInfo meshAllocationInfo{
+			.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+		};
+		VK_CHECK(vmaFindMemoryTypeIndexForBufferInfo(vmaAllocator, &meshBufferInfo, &meshAllocationInfo, &meshMemoryTypeIndex), "Couldn't find a memory type for meshes");
+	}
+	SDL_Log("Meshes are %s", directMeshUploads ? "written in place to host visible device local memory" : "uploaded through staging buffers");
+
+	const VmaPoolCreateInfo meshPoolInfo{
+		.memoryTypeIndex = meshMemoryTypeIndex,
+	};
+	VK_CHECK(vmaCreatePool(vmaAllocator, &meshPoolInfo, &meshMemoryPool), "Couldn't create mesh memory pool");
+
+	initGraph.PushDeleter([&] { vmaDestroyPool(vmaAllocator, meshMemoryPool); });
 
 	return SDL_APP_CONTINUE;
 }
 
+void VulkanEngine::SelectDrawImageFormat() {
+	//everything the draw image is used for: compute writes, rendering, sampling by the raster composite and blitting to the swapchain
+	constexpr VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT
+		| VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT
+		| VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT
+		| VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT
+		| VK_FORMAT_FEATURE_BLIT_SRC_BIT
+		| VK_FORMAT_FEATURE_TRANSFER_SRC_BIT
+		| VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+	constexpr std::array drawImageShaders = {"gradient_colour", "sky", "screen", "upscale"};
+	constexpr VkFormat fallbackFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+	const auto isUsable = [&](const VkFormat format) {
+		if (vk_util::StorageFormatQualifier(format) == nullptr) return false;
+		if (!vk_util::SupportsFormatFeatures(physicalDevice, format, requiredFeatures)) return false;
+		if (format == fallbackFormat) return true;
+		if (!storageImageExtendedFormats) return false;
+		return std::ranges::all_of(drawImageShaders, [&](const char* shader) { return std::filesystem::exists(DrawImageShaderPath(shader, format)); });
+	};
+
+	if (drawImageFormat != VK_FORMAT_UNDEFINED && !isUsable(drawImageFormat)) {
+		SDL_Log("Requested draw image format %d isn't supported, picking one instead", drawImageFormat);
+		drawImageFormat = VK_FORMAT_UNDEFINED;
+	}
+
+	//A2B10G10R10 is only used when asked for, it has the same size as B10G11R11 but clamps to [0, 1], which leaves nothing to tonemap
+	if (drawImageFormat == VK_FORMAT_UNDEFINED) {
+		drawImageFormat = isUsable(VK_FORMAT_B10G11R11_UFLOAT_PACK32) ? VK_FORMAT_B10G11R11_UFLOAT_PACK32 : fallbackFormat;
+	}
+
+	SDL_Log("Draw image format is %s, %u bytes per pixel", vk_util::StorageFormatQualifier(drawImageFormat), vk_util::FormatSize(drawImageFormat));
+}
+
+std::filesystem::path VulkanEngine::DrawImageShaderPath(const std::string_view shaderName, const VkFormat format) const {
+	std::string fileName(shaderName);
+	if (format != VK_FORMAT_R16G16B16A16_SFLOAT) {
+		fileName += '_';
+		fileName += vk_util::StorageFormatQualifier(format);
+	}
+	fileName += ".comp.spv";
+	return GetAssetsDir() / "shaders/compiled/" / fileName;
+}
+
 SDL_AppResult VulkanEngine::InitCommands() {
 	const VkCommandPoolCreateInfo commandPoolCreateInfo = vk_init::CommandPoolCreateInfo(graphicsQueueFamilyIndex, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 
@@ -161,13 +329,26 @@ SDL_AppResult VulkanEngine::InitCommands() {
 		VkCommandBufferAllocateInfo commandBufferAllocateInfo = vk_init::CommandBufferAllocateInfo(frame.commandPool, 1);
 
 		VK_CHECK(vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &frame.mainCommandBuffer), "Couldn't allocate command buffer");
+
+		frame.renderGraph.Init(device, vmaAllocator, memoryTracker);
+
+		//one pool per job pool thread to record draws in parallel, reset as a whole every frame
+		const VkCommandPoolCreateInfo recordingPoolCreateInfo = vk_init::CommandPoolCreateInfo(graphicsQueueFamilyIndex, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+		frame.recordingCommandPools.resize(jobPool.GetThreadCount());
+		frame.recordingCommandBuffers.resize(jobPool.GetThreadCount());
+		for (uint32_t i = 0; i < jobPool.GetThreadCount(); i++) {
+			VK_CHECK(vkCreateCommandPool(device, &recordingPoolCreateInfo, nullptr, &frame.recordingCommandPools[i]), "Couldn't create recording command pool");
+
+			const VkCommandBufferAllocateInfo secondaryAllocateInfo = vk_init::CommandBufferAllocateInfo(frame.recordingCommandPools[i], 1, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+			VK_CHECK(vkAllocateCommandBuffers(device, &secondaryAllocateInfo, &frame.recordingCommandBuffers[i]), "Couldn't allocate secondary command buffer");
+		}
 	}
 
 	VK_CHECK(vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &immediateSubmitCommandPool), "Couldn't create immediate submit command pool");
 
 	const VkCommandBufferAllocateInfo immediateCommandBufferAllocateInfo = vk_init::CommandBufferAllocateInfo(immediateSubmitCommandPool, 1);
 	VK_CHECK(vkAllocateCommandBuffers(device, &immediateCommandBufferAllocateInfo, &immediateSubmitCommandBuffer), "Couldn't allocate immediate command buffer");
-	mainDeletionQueue.PushFunction([&] { vkDestroyCommandPool(device, immediateSubmitCommandPool, nullptr); });
+	initGraph.PushDeleter([&] { vkDestroyCommandPool(device, immediateSubmitCommandPool, nullptr); });
 
 	return SDL_APP_CONTINUE;
 }
@@ -177,31 +358,62 @@ SDL_AppResult VulkanEngine::InitSyncStructures() {
 	const VkSemaphoreCreateInfo semaphoreCreateInfo = vk_init::SemaphoreCreateInfo();
 
 	for (FrameData& frame : frames) {
-		VK_CHECK(vkCreateFence(device, &fenceCreateInfo, nullptr, &frame.renderFence), "Couldn't create fence");
-
 		VK_CHECK(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frame.swapchainSemaphore), "Couldn't create swapchain semaphore");
 	}
 
+	//one timeline semaphore paces all frames, each frame waits for the value its previous submission signals
+	VkSemaphoreTypeCreateInfo timelineTypeCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+		.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+		.initialValue = 0,
+	};
+	VkSemaphoreCreateInfo timelineCreateInfo = vk_init::SemaphoreCreateInfo();
+	timelineCreateInfo.pNext = &timelineTypeCreateInfo;
+	VK_CHECK(vkCreateSemaphore(device, &timelineCreateInfo, nullptr, &frameTimeline), "Couldn't create frame timeline semaphore");
+
+	//without timestamps the GPU idle time just isn't measured
+	if (graphicsQueueTimestampValidBits != 0) {
+		const VkQueryPoolCreateInfo queryPoolCreateInfo{
+			.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+			.queryType = VK_QUERY_TYPE_TIMESTAMP,
+			.queryCount = 2,
+		};
+		for (FrameData& frame : frames) {
+			VK_CHECK(vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &frame.timestampQueryPool), "Couldn't create frame timestamp query pool");
+		}
+	}
+
+	if (const SDL_AppResult res = gpuProfiler.Init(device, physicalDevice, static_cast<uint32_t>(frames.size()), physicalDeviceProperties.limits, graphicsQueueTimestampValidBits, calibratedTimestampsSupported, pipelineStatisticsSupported); res != SDL_APP_CONTINUE) {
+		return res;
+	}
+	initGraph.PushDeleter([&] { gpuProfiler.Destroy(); });
+
 	VK_CHECK(vkCreateFence(device, &fenceCreateInfo, nullptr, &immediateSubmitFence), "Couldn't create immediate submit fence");
-	mainDeletionQueue.PushFunction([&] { vkDestroyFence(device, immediateSubmitFence, nullptr); });
+	initGraph.PushDeleter([&] { vkDestroyFence(device, immediateSubmitFence, nullptr); });
 
 	return SDL_APP_CONTINUE;
 }
 
-SDL_AppResult VulkanEngine::CreateSwapchain(const uint32_t width, const uint32_t height) {
-	swapchainImageFormat = VK_FORMAT_B8G8R8A8_UNORM;
+SDL_AppResult VulkanEngine::CreateSwapchain(const uint32_t width, const uint32_t height, const VkSwapchainKHR& oldSwapchain) {
 	const VkSurfaceFormatKHR desiredFormat{
 		.format = swapchainImageFormat,
 		.colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR,
 	};
 
+	//colour attachment usage is always there for imgui, transfer and storage only when composition needs them,
+	//without storage support Init switches away from compute composition before the first frame
+	VkImageUsageFlags compositionUsage = 0;
+	if (renderSettings.compositionMode == CompositionMode::Blit) compositionUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	if (renderSettings.compositionMode == CompositionMode::Compute && swapchainSupportsStorage) compositionUsage |= VK_IMAGE_USAGE_STORAGE_BIT;
+
 	vkb::SwapchainBuilder swapchainBuilder(physicalDevice, device, surface);
 	vkb::Result<vkb::Swapchain> retVkbSwapchain = swapchainBuilder
 	                                              // .use_default_format_selection()
 	                                              .set_desired_format(desiredFormat)
-	                                              .set_desired_present_mode(VK_PRESENT_MODE_FIFO_RELAXED_KHR)
+	                                              .set_desired_present_mode(renderSettings.presentMode)
 	                                              .set_desired_extent(width, height)
-	                                              .add_image_usage_flags(VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+	                                              .add_image_usage_flags(compositionUsage)
+	                                              .set_old_swapchain(oldSwapchain)
 	                                              .build();
 
 	if (!retVkbSwapchain.has_value()) {
@@ -216,6 +428,9 @@ SDL_AppResult VulkanEngine::CreateSwapchain(const uint32_t width, const uint32_t
 	swapchainImages = vkbSwapchain.get_images().value();
 	swapchainImageViews = vkbSwapchain.get_image_views().value();
 
+	//the presentation engine hands out images in an unknown state
+	swapchainImageStates.assign(swapchainImages.size(), ImageState{});
+
 	readyForPresentSemaphores.resize(swapchainImages.size());
 	for (size_t i = 0; i < swapchainImages.size(); i++) {
 		VkSemaphoreCreateInfo semaphoreCreateInfo{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
@@ -231,65 +446,43 @@ SDL_AppResult VulkanEngine::InitSwapchain() {
 		SDL_Log("Couldn't get window size: %s", SDL_GetError());
 		return SDL_APP_FAILURE;
 	}
+
+	//the UI only offers the present modes the surface supports, so the swapchain never has to fall back
+	uint32_t presentModeCount = 0;
+	VK_CHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeCount, nullptr), "Couldn't get present modes");
+	supportedPresentModes.resize(presentModeCount);
+	VK_CHECK(vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeCount, supportedPresentModes.data()), "Couldn't get present modes");
+
+	//the compute upscaler writes straight into the swapchain, when the surface and format allow it
+	swapchainImageFormat = VK_FORMAT_B8G8R8A8_UNORM;
+	VkSurfaceCapabilitiesKHR surfaceCapabilities;
+	VK_CHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &surfaceCapabilities), "Couldn't get surface capabilities");
+	VkFormatProperties swapchainFormatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, swapchainImageFormat, &swapchainFormatProperties);
+	swapchainSupportsStorage = storageImageWriteWithoutFormat
+		&& (surfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_STORAGE_BIT) != 0
+		&& (swapchainFormatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) != 0;
+
 	const uint32_t uWidth = static_cast<uint32_t>(width);
 	const uint32_t uHeight = static_cast<uint32_t>(height);
 
-	//draw image size will match the window
 	if (const SDL_AppResult res = CreateSwapchain(uWidth, uHeight); res != SDL_APP_CONTINUE) {
 		return res;
 	}
 
-	const VkExtent3D drawImageExtent = {uWidth, uHeight, 1};
-
-	//hardcoding the draw format to 32-bit float
-	drawImage.imageFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
-	drawImage.imageExtent = drawImageExtent;
-
-	VkImageUsageFlags drawImageUsages{};
-	drawImageUsages |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-	drawImageUsages |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-	drawImageUsages |= VK_IMAGE_USAGE_STORAGE_BIT;
-	drawImageUsages |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-
-	const VkImageCreateInfo drawImageCreateInfo = vk_init::ImageCreateInfo(drawImage.imageFormat, drawImageUsages, drawImageExtent);
-
-	//for the draw image, we want to allocate it from gpu local memory
-	constexpr VmaAllocationCreateInfo drawImageAllocationInfo = {
-		.usage = VMA_MEMORY_USAGE_GPU_ONLY,
-		.requiredFlags = VkMemoryPropertyFlags{VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT},
-	};
-	//allocate and create the image
-	VK_CHECK(vmaCreateImage(vmaAllocator, &drawImageCreateInfo, &drawImageAllocationInfo, &drawImage.image, &drawImage.allocation, nullptr), "Couldn't create image");
-
-	//build an image-view for the draw image to use for rendering
-	const VkImageViewCreateInfo drawImageViewCreateInfo = vk_init::ImageViewCreateInfo(drawImage.imageFormat, drawImage.image, VK_IMAGE_ASPECT_COLOR_BIT);
-
-	VK_CHECK(vkCreateImageView(device, &drawImageViewCreateInfo, nullptr, &drawImage.imageView), "Couldn't create image view");
-
-	// Depth Image
-	depthImage.imageFormat = VK_FORMAT_D32_SFLOAT;
-	depthImage.imageExtent = drawImageExtent;
-
-	VkImageUsageFlags depthImageUsages{};
-	depthImageUsages |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-
-	const VkImageCreateInfo depthImageCreateInfo = vk_init::ImageCreateInfo(depthImage.imageFormat, depthImageUsages, drawImageExtent);
-
-	//allocate and create the image
-	VK_CHECK(vmaCreateImage(vmaAllocator, &depthImageCreateInfo, &drawImageAllocationInfo, &depthImage.image, &depthImage.allocation, nullptr), "Couldn't create depth image");
-
-	//build an image-view for the depth image to use for rendering
-	const VkImageViewCreateInfo depthImageViewCreateInfo = vk_init::ImageViewCreateInfo(depthImage.imageFormat, depthImage.image, VK_IMAGE_ASPECT_DEPTH_BIT);
+	//draw image size will be at least the size of the window
+	if (const SDL_AppResult res = ResizeDrawImage(swapchainExtent); res != SDL_APP_CONTINUE) {
+		return res;
+	}
 
-	VK_CHECK(vkCreateImageView(device, &depthImageViewCreateInfo, nullptr, &depthImage.imageView), "Couldn't create depth image view");
+	//the depth image is a transient of the per-frame render graph, so it only needs a format here
 
 	//add to deletion queues
-	mainDeletionQueue.PushFunction([&] {
-		vkDestroyImageView(device, drawImage.imageView, nullptr);
-		vmaDestroyImage(vmaAllocator, drawImage.image, drawImage.allocation);
-
-		vkDestroyImageView(device, depthImage.imageView, nullptr);
-		vmaDestroyImage(vmaAllocator, depthImage.image, depthImage.allocation);
+	initGraph.PushDeleter([&] {
+		DestroyImage(drawImage);
+		for (const AllocatedImage& pooledImage : drawImagePool.Drain()) {
+			DestroyImage(pooledImage);
+		}
 	});
 
 	return SDL_APP_CONTINUE;
@@ -307,23 +500,130 @@ void VulkanEngine::DestroySwapchain() const {
 	}
 }
 
-SDL_AppResult VulkanEngine::ResizeSwapchain() {
-	vkDeviceWaitIdle(device);
+SDL_AppResult VulkanEngine::ResizeSwapchain(const VkExtent2D windowExtent) {
+	//a minimized window has nothing to present to, so the swapchain stays out of date until it's restored
+	if (windowExtent.width == 0 || windowExtent.height == 0) {
+		return SDL_APP_CONTINUE;
+	}
 
-	DestroySwapchain();
+	//the old swapchain is handed to the new one instead of waiting for the device to idle. The timeline doesn't show when
+	//its queued presents have consumed their semaphores, so it's kept for a whole cycle of frames in flight after the first
+	//frame on the new swapchain
+	const VkSwapchainKHR oldSwapchain = swapchain;
+	std::vector<VkImageView> oldImageViews = std::move(swapchainImageViews);
+	std::vector<VkSemaphore> oldReadyForPresentSemaphores = std::move(readyForPresentSemaphores);
+	readyForPresentSemaphores.clear();
 
-	int32_t width, height;
-	if (!SDL_GetWindowSize(window, &width, &height)) {
-		SDL_Log("Couldn't get window size: %s", SDL_GetError());
-		return SDL_APP_FAILURE;
+	const SDL_AppResult createResult = CreateSwapchain(windowExtent.width, windowExtent.height, oldSwapchain);
+
+	retiredResources.PushFunction(frameTimelineValue + 1 + frames.size(), [this, oldSwapchain, oldImageViews = std::move(oldImageViews), oldReadyForPresentSemaphores = std::move(oldReadyForPresentSemaphores)] {
+		for (const VkImageView& imageView : oldImageViews) {
+			vkDestroyImageView(device, imageView, nullptr);
+		}
+		for (const VkSemaphore& semaphore : oldReadyForPresentSemaphores) {
+			vkDestroySemaphore(device, semaphore, nullptr);
+		}
+		vkDestroySwapchainKHR(device, oldSwapchain, nullptr);
+	});
+
+	if (createResult != SDL_APP_CONTINUE) {
+		return createResult;
 	}
-	const uint32_t uWidth = static_cast<uint32_t>(width);
-	const uint32_t uHeight = static_cast<uint32_t>(height);
 
-	if (const SDL_AppResult res = CreateSwapchain(uWidth, uHeight); res != SDL_APP_CONTINUE) {
+	if (const SDL_AppResult res = ResizeDrawImage(swapchainExtent); res != SDL_APP_CONTINUE) {
 		return res;
 	}
-	resizeRequested = false;
+	swapchainOutOfDate = false;
+
+	return SDL_APP_CONTINUE;
+}
+
+SDL_AppResult VulkanEngine::ResizeDrawImage(const VkExtent2D extent) {
+	const VkExtent3D bucketExtent = ImagePool::BucketExtent(extent);
+
+	//grows when the window outgrows it, and only shrinks when it is more than twice the size it needs to be
+	if (drawImage.image != nullptr) {
+		const bool fits = extent.width <= drawImage.imageExtent.width && extent.height <= drawImage.imageExtent.height;
+		const uint64_t currentArea = static_cast<uint64_t>(drawImage.imageExtent.width) * drawImage.imageExtent.height;
+		const uint64_t neededArea = static_cast<uint64_t>(bucketExtent.width) * bucketExtent.height;
+		if (fits && currentArea <= neededArea * 2) {
+			return SDL_APP_CONTINUE;
+		}
+	}
+
+	AllocatedImage newImage;
+	if (const std::optional<AllocatedImage> pooledImage = drawImagePool.Take(bucketExtent, drawImageFormat); pooledImage.has_value()) {
+		newImage = pooledImage.value();
+	} else {
+		VkImageUsageFlags drawImageUsages{};
+		drawImageUsages |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		drawImageUsages |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		drawImageUsages |= VK_IMAGE_USAGE_STORAGE_BIT;
+		drawImageUsages |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		drawImageUsages |= VK_IMAGE_USAGE_SAMPLED_BIT;
+
+		const std::optional<AllocatedImage> imageResult = CreateImage(bucketExtent, drawImageFormat, drawImageUsages, MemoryCategory::RenderTargets);
+		if (!imageResult.has_value()) {
+			SDL_Log("Couldn't create draw image");
+			return SDL_APP_FAILURE;
+		}
+		newImage = imageResult.value();
+	}
+
+	//frames in flight may still draw into the old image, so it goes back to the pool once they're done
+	if (drawImage.image != nullptr) {
+		retiredResources.PushFunction(frameTimelineValue, [this, oldImage = drawImage] {
+			if (const std::optional<AllocatedImage> evictedImage = drawImagePool.Return(oldImage); evictedImage.has_value()) {
+				DestroyImage(evictedImage.value());
+			}
+		});
+	}
+	drawImage = newImage;
+
+	const double drawImageMegabytes = static_cast<double>(drawImage.imageExtent.width) * drawImage.imageExtent.height * vk_util::FormatSize(drawImage.imageFormat) / (1024.0 * 1024.0);
+	SDL_Log("Draw image is now %ux%u, %.1f MiB", drawImage.imageExtent.width, drawImage.imageExtent.height, drawImageMegabytes);
+
+	return SDL_APP_CONTINUE;
+}
+
+SDL_AppResult VulkanEngine::ResizeDepthPyramid() {
+	const VkExtent3D extent{
+		.width = std::bit_floor(drawImage.imageExtent.width),
+		.height = std::bit_floor(drawImage.imageExtent.height),
+		.depth = 1,
+	};
+	const AllocatedImage* currentPyramid = imagePool.Get(depthPyramid);
+	if (currentPyramid != nullptr && currentPyramid->imageExtent.width == extent.width && currentPyramid->imageExtent.height == extent.height) {
+		return SDL_APP_CONTINUE;
+	}
+
+	const std::optional<AllocatedImage> imageResult = CreateImage(extent, depthPyramidFormat, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, MemoryCategory::RenderTargets, true);
+	if (!imageResult.has_value()) {
+		SDL_Log("Couldn't create depth pyramid");
+		return SDL_APP_FAILURE;
+	}
+	const AllocatedImage newPyramid = imageResult.value();
+
+	//every level is written through its own view
+	std::vector<VkImageView> newLevelViews;
+	const uint32_t levelCount = std::bit_width(std::max(extent.width, extent.height));
+	for (uint32_t level = 0; level < levelCount; level++) {
+		VkImageViewCreateInfo viewCreateInfo = vk_init::ImageViewCreateInfo(depthPyramidFormat, newPyramid.image, VK_IMAGE_ASPECT_COLOR_BIT);
+		viewCreateInfo.subresourceRange.baseMipLevel = level;
+		VK_CHECK(vkCreateImageView(device, &viewCreateInfo, nullptr, &newLevelViews.emplace_back()), "Couldn't create depth pyramid level view");
+	}
+
+	//frames in flight may still cull against the old pyramid
+	if (currentPyramid != nullptr) {
+		imagePool.Release(depthPyramid, frameTimelineValue);
+		retiredResources.PushFunction(frameTimelineValue, [this, oldLevelViews = std::move(depthPyramidLevelViews)] {
+			for (const VkImageView& levelView : oldLevelViews) {
+				vkDestroyImageView(device, levelView, nullptr);
+			}
+		});
+	}
+	depthPyramid = imagePool.Add(newPyramid);
+	depthPyramidLevelViews = std::move(newLevelViews);
 
 	return SDL_APP_CONTINUE;
 }
@@ -412,7 +712,7 @@ SDL_AppResult VulkanEngine::InitDescriptors() {
 	screenImageDescriptors = screenAllocationResult.value();
 
 	//make sure both the descriptor allocator and the new layout get cleaned up properly
-	mainDeletionQueue.PushFunction([&] {
+	initGraph.PushDeleter([&] {
 		globalDescriptorAllocator.DestroyPool(device);
 
 		vkDestroyDescriptorSetLayout(device, gpuSceneDataDescriptorLayout, nullptr);
@@ -432,18 +732,7 @@ SDL_AppResult VulkanEngine::InitDescriptors() {
 		frame.frameDescriptors = DescriptorAllocatorGrowable{};
 		frame.frameDescriptors.InitPools(device, 1000, frameSizes);
 
-		mainDeletionQueue.PushFunction([&, frame = &frame] { frame->frameDescriptors.DestroyPools(device); });
-	}
-
-	return SDL_APP_CONTINUE;
-}
-
-SDL_AppResult VulkanEngine::InitPipelines() {
-	if (const SDL_AppResult res = InitBackgroundPipelines(); res != SDL_APP_CONTINUE) {
-		return res;
-	}
-	if (const SDL_AppResult res = InitMeshPipeline(); res != SDL_APP_CONTINUE) {
-		return res;
+		initGraph.PushDeleter([&, frame = &frame] { frame->frameDescriptors.DestroyPools(device); });
 	}
 
 	return SDL_APP_CONTINUE;
@@ -467,12 +756,11 @@ SDL_AppResult VulkanEngine::InitBackgroundPipelines() {
 	VkPipelineLayout computePipelineLayout;
 	VK_CHECK(vkCreatePipelineLayout(device, &computeLayout, nullptr, &computePipelineLayout), "Couldn't create compute pipeline layout");
 
-	const std::filesystem::path compiledShadersPath = GetAssetsDir() / "shaders/compiled/";
-
 	VkShaderModule gradientShader;
+	uint64_t gradientShaderHash = 0;
 	{
-		const std::filesystem::path gradientShaderPath = compiledShadersPath / "gradient_colour.comp.spv";
-		const std::optional<VkShaderModule> gradientShaderResult = vk_util::LoadShaderModule(gradientShaderPath.string().c_str(), device);
+		const std::filesystem::path gradientShaderPath = DrawImageShaderPath("gradient_colour", drawImageFormat);
+		const std::optional<VkShaderModule> gradientShaderResult = vk_util::LoadShaderModule(gradientShaderPath.string().c_str(), device, &gradientShaderHash);
 		if (!gradientShaderResult.has_value()) {
 			SDL_Log("Couldn't load compute shader module: %s", gradientShaderPath.string().c_str());
 			return SDL_APP_FAILURE;
@@ -480,9 +768,10 @@ SDL_AppResult VulkanEngine::InitBackgroundPipelines() {
 		gradientShader = gradientShaderResult.value();
 	}
 	VkShaderModule skyShader;
+	uint64_t skyShaderHash = 0;
 	{
-		const std::filesystem::path skyShaderPath = compiledShadersPath / "sky.comp.spv";
-		const std::optional<VkShaderModule> skyShaderResult = vk_util::LoadShaderModule(skyShaderPath.string().c_str(), device);
+		const std::filesystem::path skyShaderPath = DrawImageShaderPath("sky", drawImageFormat);
+		const std::optional<VkShaderModule> skyShaderResult = vk_util::LoadShaderModule(skyShaderPath.string().c_str(), device, &skyShaderHash);
 		if (!skyShaderResult.has_value()) {
 			SDL_Log("Couldn't load compute shader module: %s", skyShaderPath.string().c_str());
 			return SDL_APP_FAILURE;
@@ -490,9 +779,10 @@ SDL_AppResult VulkanEngine::InitBackgroundPipelines() {
 		skyShader = skyShaderResult.value();
 	}
 	VkShaderModule screenShader;
+	uint64_t screenShaderHash = 0;
 	{
-		const std::filesystem::path screenShaderPath = compiledShadersPath / "screen.comp.spv";
-		const std::optional<VkShaderModule> screenShaderResult = vk_util::LoadShaderModule(screenShaderPath.string().c_str(), device);
+		const std::filesystem::path screenShaderPath = DrawImageShaderPath("screen", drawImageFormat);
+		const std::optional<VkShaderModule> screenShaderResult = vk_util::LoadShaderModule(screenShaderPath.string().c_str(), device, &screenShaderHash);
 		if (!screenShaderResult.has_value()) {
 			SDL_Log("Couldn't load compute shader module: %s", screenShaderPath.string().c_str());
 			return SDL_APP_FAILURE;
@@ -500,45 +790,34 @@ SDL_AppResult VulkanEngine::InitBackgroundPipelines() {
 		screenShader = screenShaderResult.value();
 	}
 
-	const VkPipelineShaderStageCreateInfo stageCreateInfo{
-		.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-		.stage = VK_SHADER_STAGE_COMPUTE_BIT,
-		.module = gradientShader,
-		.pName = "main",
-	};
-
-	VkComputePipelineCreateInfo computePipelineCreateInfo{
-		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
-		.pNext = nullptr,
-		.stage = stageCreateInfo,
-		.layout = computePipelineLayout,
-	};
-
 	ComputeEffect gradientEffect{
 		.name = "gradient",
 		.layout = computePipelineLayout,
 		.descriptorSet = drawImageDescriptors,
+		.descriptorLayout = drawImageDescriptorLayout,
 		.data = ComputePushConstants{
 			//default colours
 			.data1 = math::float4{1.0f, 0.0f, 0.0f, 1.0f}, // Red
 			.data2 = math::float4{0.0f, 0.0f, 1.0f, 1.0f}, // Blue
 		},
 	};
-	VK_CHECK(vkCreateComputePipelines(device, nullptr, 1, &computePipelineCreateInfo, nullptr, &gradientEffect.pipeline), "Couldn't create compute pipeline: gradient");
-
-	//reuse the structs we've already made, but with the other shader
-	computePipelineCreateInfo.stage.module = skyShader;
+	if (const SDL_AppResult res = CreateBackgroundPipeline(gradientEffect, gradientShader, gradientShaderHash); res != SDL_APP_CONTINUE) {
+		return res;
+	}
 
 	ComputeEffect skyEffect{
 		.name = "sky",
 		.layout = computePipelineLayout,
 		.descriptorSet = drawImageDescriptors,
+		.descriptorLayout = drawImageDescriptorLayout,
 		.data = ComputePushConstants{
 			//default colours
 			.data1 = math::float4{0.1f, 0.2f, 0.4f, 0.97f}, // Light blue
 		},
 	};
-	VK_CHECK(vkCreateComputePipelines(device, nullptr, 1, &computePipelineCreateInfo, nullptr, &skyEffect.pipeline), "Couldn't create compute pipeline: sky");
+	if (const SDL_AppResult res = CreateBackgroundPipeline(skyEffect, skyShader, skyShaderHash); res != SDL_APP_CONTINUE) {
+		return res;
+	}
 
 	const VkPipelineLayoutCreateInfo computeLayoutScreen{
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
@@ -549,16 +828,27 @@ SDL_AppResult VulkanEngine::InitBackgroundPipelines() {
 	VkPipelineLayout computePipelineLayoutScreen;
 	VK_CHECK(vkCreatePipelineLayout(device, &computeLayoutScreen, nullptr, &computePipelineLayoutScreen), "Couldn't create screen compute pipeline layout");
 
-	computePipelineCreateInfo.stage.module = screenShader;
-	computePipelineCreateInfo.layout = computePipelineLayoutScreen;
-
 	ComputeEffect screenEffect{
 		.name = "screen",
 		.layout = computePipelineLayoutScreen,
 		.descriptorSet = screenImageDescriptors,
+		.descriptorLayout = screenImageDescriptorLayout,
 		.hasPushConstants = false,
 	};
-	VK_CHECK(vkCreateComputePipelines(device, nullptr, 1, &computePipelineCreateInfo, nullptr, &screenEffect.pipeline), "Couldn't create compute pipeline: sky");
+	{
+		//the screen effect reads the per-frame screen image, so one has to be bound while it is benchmarked
+		constexpr std::array<uint32_t, 16 * 16> screenPixels{};
+		if (const SDL_AppResult res = CreateScreenImage(screenPixels.data(), sizeof(uint32_t), 16, 16); res != SDL_APP_CONTINUE) {
+			return res;
+		}
+		const SDL_AppResult res = CreateBackgroundPipeline(screenEffect, screenShader, screenShaderHash);
+		DestroyImage(GetCurrentFrame().screenImage);
+		if (res != SDL_APP_CONTINUE) {
+			return res;
+		}
+	}
+
+	workgroupSizeCache.Save();
 
 	//add the effects to the background effects vector
 	backgroundEffects.push_back(gradientEffect);
@@ -570,7 +860,7 @@ SDL_AppResult VulkanEngine::InitBackgroundPipelines() {
 	vkDestroyShaderModule(device, skyShader, nullptr);
 	vkDestroyShaderModule(device, screenShader, nullptr);
 
-	mainDeletionQueue.PushFunction([=, this] {
+	initGraph.PushDeleter([=, this] {
 		vkDestroyPipelineLayout(device, computePipelineLayoutScreen, nullptr);
 		vkDestroyPipelineLayout(device, computePipelineLayout, nullptr);
 		vkDestroyPipeline(device, screenEffect.pipeline, nullptr);
@@ -581,6 +871,144 @@ SDL_AppResult VulkanEngine::InitBackgroundPipelines() {
 	return SDL_APP_CONTINUE;
 }
 
+SDL_AppResult VulkanEngine::CreateBackgroundPipeline(ComputeEffect& effect, const VkShaderModule& shaderModule, const uint64_t shaderHash) {
+	if (const std::optional<WorkgroupSize> cachedSize = workgroupSizeCache.Find(effect.name, shaderHash); cachedSize.has_value()) {
+		effect.workgroupSize = cachedSize.value();
+	} else if (const std::optional<WorkgroupSize> tunedSize = BenchmarkWorkgroupSize(effect, shaderModule); tunedSize.has_value()) {
+		effect.workgroupSize = tunedSize.value();
+		workgroupSizeCache.Store(effect.name, shaderHash, effect.workgroupSize);
+	}
+
+	const std::optional<VkPipeline> pipelineResult = vk_util::CreateComputePipeline(device, shaderModule, effect.layout, effect.workgroupSize);
+	if (!pipelineResult.has_value()) {
+		SDL_Log("Couldn't create compute pipeline: %s", effect.name);
+		return SDL_APP_FAILURE;
+	}
+	effect.pipeline = pipelineResult.value();
+
+	SDL_Log("Compute effect %s uses workgroup size %ux%u", effect.name, effect.workgroupSize.x, effect.workgroupSize.y);
+
+	return SDL_APP_CONTINUE;
+}
+
+std::optional<WorkgroupSize> VulkanEngine::BenchmarkWorkgroupSize(const ComputeEffect& effect, const VkShaderModule& shaderModule) {
+	if (graphicsQueueTimestampValidBits == 0) {
+		SDL_Log("Graphics queue doesn't support timestamps, using the default workgroup size for %s", effect.name);
+		return std::nullopt;
+	}
+
+	const std::vector<WorkgroupSize> candidates = vk_util::WorkgroupSizeCandidates(physicalDeviceProperties.limits);
+	if (candidates.empty()) {
+		return std::nullopt;
+	}
+
+	std::vector<VkPipeline> pipelines;
+	for (const WorkgroupSize& candidate : candidates) {
+		const std::optional<VkPipeline> pipelineResult = vk_util::CreateComputePipeline(device, shaderModule, effect.layout, candidate);
+		if (!pipelineResult.has_value()) {
+			break;
+		}
+		pipelines.push_back(pipelineResult.value());
+	}
+
+	//every candidate is timed a few times, interleaved, so clock ramp-up doesn't favour the last ones
+	constexpr uint32_t rounds = 3;
+	constexpr uint32_t dispatchesPerSample = 4;
+	const uint32_t queryCount = static_cast<uint32_t>(pipelines.size()) * rounds * 2;
+
+	const VkQueryPoolCreateInfo queryPoolCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.queryType = VK_QUERY_TYPE_TIMESTAMP,
+		.queryCount = queryCount,
+	};
+	VkQueryPool queryPool = nullptr;
+	const bool canBenchmark = pipelines.size() == candidates.size() && vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &queryPool) == VK_SUCCESS;
+
+	const VkExtent2D extent{drawImage.imageExtent.width, drawImage.imageExtent.height};
+	std::vector<uint64_t> timestamps(queryCount);
+
+	if (canBenchmark && ImmediateSubmit([&](const VkCommandBuffer& commandBuffer) {
+		vkCmdResetQueryPool(commandBuffer, queryPool, 0, queryCount);
+
+		BarrierBuilder barriers;
+		barriers.Transition(drawImage, ImageUsage::ComputeWrite, true);
+		barriers.Flush(commandBuffer);
+
+		//all candidates share the layout, so the bindings stay valid across pipeline binds
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, effect.layout, 0, 1, &effect.descriptorSet, 0, nullptr);
+		if (effect.hasPushConstants) {
+			vkCmdPushConstants(commandBuffer, effect.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputePushConstants), &effect.data);
+		}
+
+		constexpr VkMemoryBarrier2 dispatchBarrier{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+			.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+			.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+			.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+			.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+		};
+		const VkDependencyInfo dispatchDependency{
+			.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+			.memoryBarrierCount = 1,
+			.pMemoryBarriers = &dispatchBarrier,
+		};
+
+		uint32_t query = 0;
+		for (uint32_t round = 0; round < rounds; round++) {
+			for (size_t i = 0; i < pipelines.size(); i++) {
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[i]);
+
+				vkCmdWriteTimestamp2(commandBuffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, queryPool, query++);
+				for (uint32_t d = 0; d < dispatchesPerSample; d++) {
+					vk_util::DispatchForExtent(commandBuffer, extent, candidates[i]);
+					vkCmdPipelineBarrier2(commandBuffer, &dispatchDependency);
+				}
+				vkCmdWriteTimestamp2(commandBuffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, queryPool, query++);
+			}
+		}
+	}) == SDL_APP_CONTINUE) {
+		if (vkGetQueryPoolResults(device, queryPool, 0, queryCount, timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) != VK_SUCCESS) {
+			timestamps.clear();
+		}
+	} else {
+		timestamps.clear();
+	}
+
+	for (const VkPipeline& pipeline : pipelines) {
+		vkDestroyPipeline(device, pipeline, nullptr);
+	}
+	if (queryPool != nullptr) {
+		vkDestroyQueryPool(device, queryPool, nullptr);
+	}
+
+	if (timestamps.empty()) {
+		SDL_Log("Couldn't benchmark workgroup sizes for %s, using the default", effect.name);
+		return std::nullopt;
+	}
+
+	//take the best round per candidate, so one-off hiccups don't count against it
+	const uint64_t timestampMask = graphicsQueueTimestampValidBits >= 64 ? ~0ull : (1ull << graphicsQueueTimestampValidBits) - 1;
+	std::vector<uint64_t> bestTicks(candidates.size(), ~0ull);
+	for (uint32_t round = 0; round < rounds; round++) {
+		for (size_t i = 0; i < candidates.size(); i++) {
+			const size_t query = (round * candidates.size() + i) * 2;
+			const uint64_t ticks = (timestamps[query + 1] - timestamps[query]) & timestampMask;
+			bestTicks[i] = std::min(bestTicks[i], ticks);
+		}
+	}
+
+	size_t fastest = 0;
+	for (size_t i = 0; i < candidates.size(); i++) {
+		const double milliseconds = static_cast<double>(bestTicks[i]) * physicalDeviceProperties.limits.timestampPeriod / 1'000'000.0 / dispatchesPerSample;
+		SDL_Log("Workgroup size %ux%u for %s: %.4f ms", candidates[i].x, candidates[i].y, effect.name, milliseconds);
+		if (bestTicks[i] < bestTicks[fastest]) {
+			fastest = i;
+		}
+	}
+
+	return candidates[fastest];
+}
+
 SDL_AppResult VulkanEngine::InitMeshPipeline() {
 	VkShaderModule meshFragShader;
 	{
@@ -627,7 +1055,7 @@ SDL_AppResult VulkanEngine::InitMeshPipeline() {
 
 	//connect the image format we will draw into, from draw image
 	pipelineBuilder.SetColourAttachmentFormat(drawImage.imageFormat);
-	pipelineBuilder.SetDepthFormat(depthImage.imageFormat);
+	pipelineBuilder.SetDepthFormat(depthImageFormat);
 
 	//finally build the pipeline
 	const std::optional<VkPipeline> pipelineResult = pipelineBuilder.BuildPipeline(device);
@@ -641,40 +1069,314 @@ SDL_AppResult VulkanEngine::InitMeshPipeline() {
 	vkDestroyShaderModule(device, meshFragShader, nullptr);
 	vkDestroyShaderModule(device, meshVertShader, nullptr);
 
-	mainDeletionQueue.PushFunction([&] {
+	initGraph.PushDeleter([&] {
 		vkDestroyPipelineLayout(device, meshPipelineLayout, nullptr);
 		vkDestroyPipeline(device, meshPipeline, nullptr);
 	});
 
+	//the instanced variant has the same layout and state, only its shaders read the per-frame instance data
+	const std::filesystem::path compiledShadersPath = GetAssetsDir() / "shaders/compiled/";
+	const std::optional<VkShaderModule> instancedVertShaderResult = vk_util::LoadShaderModule((compiledShadersPath / "triangle_instanced.vert.spv").string().c_str(), device);
+	const std::optional<VkShaderModule> tintedFragShaderResult = vk_util::LoadShaderModule((compiledShadersPath / "tex_image_tinted.frag.spv").string().c_str(), device);
+	if (instancedVertShaderResult.has_value() && tintedFragShaderResult.has_value()) {
+		pipelineBuilder.SetShaders(instancedVertShaderResult.value(), tintedFragShaderResult.value());
+		instancedMeshPipeline = pipelineBuilder.BuildPipeline(device).value_or(nullptr);
+	}
+	if (instancedVertShaderResult.has_value()) {
+		vkDestroyShaderModule(device, instancedVertShaderResult.value(), nullptr);
+	}
+	if (tintedFragShaderResult.has_value()) {
+		vkDestroyShaderModule(device, tintedFragShaderResult.value(), nullptr);
+	}
+	if (instancedMeshPipeline == nullptr) {
+		SDL_Log("Couldn't create instanced mesh pipeline, instanced drawing is unavailable");
+	} else {
+		initGraph.PushDeleter([&] {
+			vkDestroyPipeline(device, instancedMeshPipeline, nullptr);
+		});
+	}
+
 	return SDL_APP_CONTINUE;
 }
 
-SDL_AppResult VulkanEngine::ImmediateSubmit(std::function<void(VkCommandBuffer commandBuffer)>&& function) const {
-	VK_CHECK(vkResetFences(device, 1, &immediateSubmitFence), "Couldn't reset immediate submit fence");
-	VK_CHECK(vkResetCommandBuffer(immediateSubmitCommandBuffer, 0), "Couldn't reset immediate submit command buffer");
+SDL_AppResult VulkanEngine::InitUpscalePipeline() {
+	{
+		DescriptorLayoutBuilder builder;
+		builder.AddBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		builder.AddBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		const std::optional<VkDescriptorSetLayout> buildResult = builder.Build(device, VK_SHADER_STAGE_COMPUTE_BIT);
+		if (!buildResult.has_value()) {
+			SDL_Log("Couldn't create descriptor set layout for upscaling");
+			return SDL_APP_FAILURE;
+		}
+		upscaleDescriptorLayout = buildResult.value();
+	}
 
-	const VkCommandBuffer& commandBuffer = immediateSubmitCommandBuffer;
+	VkPushConstantRange pushConstantRange{
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(UpscalePushConstants),
+	};
 
-	const VkCommandBufferBeginInfo cmdBeginInfo = vk_init::CommandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vk_init::PipelineLayoutCreateInfo(&pushConstantRange, &upscaleDescriptorLayout);
+	VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &upscalePipelineLayout), "Couldn't create upscale pipeline layout");
 
-	VK_CHECK(vkBeginCommandBuffer(commandBuffer, &cmdBeginInfo), "Couldn't begin immediate command buffer");
+	initGraph.PushDeleter([&] {
+		if (upscalePipeline != nullptr) {
+			vkDestroyPipeline(device, upscalePipeline, nullptr);
+		}
+		vkDestroyPipelineLayout(device, upscalePipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, upscaleDescriptorLayout, nullptr);
+	});
 
-	function(commandBuffer);
+	//without the upscaler the draw image is blitted to the swapchain like before
+	const std::filesystem::path fullPath = DrawImageShaderPath("upscale", drawImageFormat);
+	const std::optional<VkShaderModule> upscaleShaderResult = vk_util::LoadShaderModule(fullPath.string().c_str(), device);
+	if (!upscaleShaderResult.has_value()) {
+		SDL_Log("Couldn't load upscale shader module, falling back to blitting");
+		return SDL_APP_CONTINUE;
+	}
 
-	VK_CHECK(vkEndCommandBuffer(commandBuffer), "Couldn't end immediate command buffer");
+	const std::optional<VkPipeline> pipelineResult = vk_util::CreateComputePipeline(device, upscaleShaderResult.value(), upscalePipelineLayout, upscaleWorkgroupSize);
+	vkDestroyShaderModule(device, upscaleShaderResult.value(), nullptr);
+	if (!pipelineResult.has_value()) {
+		SDL_Log("Couldn't create upscale pipeline, falling back to blitting");
+		return SDL_APP_CONTINUE;
+	}
+	upscalePipeline = pipelineResult.value();
 
-	const VkCommandBufferSubmitInfo commandBufferSubmitInfo = vk_init::CommandBufferSubmitInfo(commandBuffer);
-	const VkSubmitInfo2 submit = vk_init::SubmitInfo(&commandBufferSubmitInfo, nullptr, nullptr);
+	return SDL_APP_CONTINUE;
+}
 
-	VK_CHECK(vkQueueSubmit2(graphicsQueue, 1, &submit, immediateSubmitFence), "Couldn't submit immediate command buffer");
+SDL_AppResult VulkanEngine::InitCompositePipeline() {
+	VkPushConstantRange pushConstantRange{
+		.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+		.offset = 0,
+		.size = sizeof(CompositePushConstants),
+	};
 
-	VK_CHECK(vkWaitForFences(device, 1, &immediateSubmitFence, true, secondInNanoseconds), "Couldn't wait for immediate submit fence");
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vk_init::PipelineLayoutCreateInfo(&pushConstantRange, &singleImageDescriptorLayout);
+	VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &compositePipelineLayout), "Couldn't create composite pipeline layout");
 
-	return SDL_APP_CONTINUE;
-}
+	initGraph.PushDeleter([&] {
+		if (compositePipeline != nullptr) {
+			vkDestroyPipeline(device, compositePipeline, nullptr);
+		}
+		vkDestroyPipelineLayout(device, compositePipelineLayout, nullptr);
+	});
 
-SDL_AppResult VulkanEngine::InitImgui() {
-	// 1: create descriptor pool for IMGUI
+	const std::filesystem::path vertexPath = GetAssetsDir() / "shaders/compiled/" / "composite.vert.spv";
+	const std::filesystem::path fragmentPath = GetAssetsDir() / "shaders/compiled/" / "composite.frag.spv";
+	const std::optional<VkShaderModule> vertexShaderResult = vk_util::LoadShaderModule(vertexPath.string().c_str(), device);
+	const std::optional<VkShaderModule> fragmentShaderResult = vk_util::LoadShaderModule(fragmentPath.string().c_str(), device);
+	if (!vertexShaderResult.has_value() || !fragmentShaderResult.has_value()) {
+		SDL_Log("Couldn't load composite shader modules, raster composition is unavailable");
+		if (vertexShaderResult.has_value()) vkDestroyShaderModule(device, vertexShaderResult.value(), nullptr);
+		if (fragmentShaderResult.has_value()) vkDestroyShaderModule(device, fragmentShaderResult.value(), nullptr);
+		return SDL_APP_CONTINUE;
+	}
+
+	PipelineBuilder pipelineBuilder;
+	pipelineBuilder.pipelineLayout = compositePipelineLayout;
+	pipelineBuilder.SetShaders(vertexShaderResult.value(), fragmentShaderResult.value());
+	pipelineBuilder.SetInputTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+	pipelineBuilder.SetPolygonMode(VK_POLYGON_MODE_FILL);
+	pipelineBuilder.SetCullMode(VK_CULL_MODE_NONE, VK_FRONT_FACE_CLOCKWISE);
+	pipelineBuilder.SetMultiSamplingNone();
+	pipelineBuilder.DisableBlending();
+	pipelineBuilder.DisableDepthTest();
+
+	//draws straight into the swapchain
+	pipelineBuilder.SetColourAttachmentFormat(swapchainImageFormat);
+	pipelineBuilder.SetDepthFormat(VK_FORMAT_UNDEFINED);
+
+	const std::optional<VkPipeline> pipelineResult = pipelineBuilder.BuildPipeline(device);
+	vkDestroyShaderModule(device, vertexShaderResult.value(), nullptr);
+	vkDestroyShaderModule(device, fragmentShaderResult.value(), nullptr);
+	if (!pipelineResult.has_value()) {
+		SDL_Log("Couldn't build composite pipeline, raster composition is unavailable");
+		return SDL_APP_CONTINUE;
+	}
+	compositePipeline = pipelineResult.value();
+
+	return SDL_APP_CONTINUE;
+}
+
+SDL_AppResult VulkanEngine::InitCullPipeline() {
+	VkPushConstantRange pushConstantRange{
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(CullPushConstants),
+	};
+
+	//everything is reached through buffer device addresses, so there are no descriptors
+	const VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = vk_init::PipelineLayoutCreateInfo(&pushConstantRange);
+	VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &cullPipelineLayout), "Couldn't create cull pipeline layout");
+
+	initGraph.PushDeleter([&] {
+		if (cullPipeline != nullptr) {
+			vkDestroyPipeline(device, cullPipeline, nullptr);
+		}
+		vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+	});
+
+	//without indirect count draws every instance is drawn from the CPU instead, Init picks the mode from the pipeline
+	if (!drawIndirectCountSupported) {
+		SDL_Log("Indirect count draws aren't supported, drawing instances from the CPU");
+		return SDL_APP_CONTINUE;
+	}
+
+	const std::filesystem::path fullPath = GetAssetsDir() / "shaders/compiled/" / "cull.comp.spv";
+	const std::optional<VkShaderModule> cullShaderResult = vk_util::LoadShaderModule(fullPath.string().c_str(), device);
+	if (!cullShaderResult.has_value()) {
+		SDL_Log("Couldn't load cull shader module, drawing instances from the CPU");
+		return SDL_APP_CONTINUE;
+	}
+
+	const std::optional<VkPipeline> pipelineResult = vk_util::CreateComputePipeline(device, cullShaderResult.value(), cullPipelineLayout, cullWorkgroupSize);
+	vkDestroyShaderModule(device, cullShaderResult.value(), nullptr);
+	if (!pipelineResult.has_value()) {
+		SDL_Log("Couldn't create cull pipeline, drawing instances from the CPU");
+		return SDL_APP_CONTINUE;
+	}
+	cullPipeline = pipelineResult.value();
+
+	return InitOcclusionCullPipelines();
+}
+
+SDL_AppResult VulkanEngine::InitOcclusionCullPipelines() {
+	{
+		DescriptorLayoutBuilder builder;
+		builder.AddBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+		builder.AddBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		const std::optional<VkDescriptorSetLayout> buildResult = builder.Build(device, VK_SHADER_STAGE_COMPUTE_BIT);
+		if (!buildResult.has_value()) {
+			SDL_Log("Couldn't create descriptor set layout for the depth pyramid");
+			return SDL_APP_FAILURE;
+		}
+		depthPyramidDescriptorLayout = buildResult.value();
+	}
+	{
+		DescriptorLayoutBuilder builder;
+		builder.AddBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+		const std::optional<VkDescriptorSetLayout> buildResult = builder.Build(device, VK_SHADER_STAGE_COMPUTE_BIT);
+		if (!buildResult.has_value()) {
+			SDL_Log("Couldn't create descriptor set layout for occlusion culling");
+			return SDL_APP_FAILURE;
+		}
+		occlusionCullDescriptorLayout = buildResult.value();
+	}
+
+	VkPushConstantRange depthPyramidPushConstantRange{
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(DepthPyramidPushConstants),
+	};
+	const VkPipelineLayoutCreateInfo depthPyramidLayoutCreateInfo = vk_init::PipelineLayoutCreateInfo(&depthPyramidPushConstantRange, &depthPyramidDescriptorLayout);
+	VK_CHECK(vkCreatePipelineLayout(device, &depthPyramidLayoutCreateInfo, nullptr, &depthPyramidPipelineLayout), "Couldn't create depth pyramid pipeline layout");
+
+	VkPushConstantRange cullPushConstantRange{
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(CullPushConstants),
+	};
+	const VkPipelineLayoutCreateInfo cullLayoutCreateInfo = vk_init::PipelineLayoutCreateInfo(&cullPushConstantRange, &occlusionCullDescriptorLayout);
+	VK_CHECK(vkCreatePipelineLayout(device, &cullLayoutCreateInfo, nullptr, &occlusionCullPipelineLayout), "Couldn't create occlusion cull pipeline layout");
+
+	initGraph.PushDeleter([&] {
+		//the pyramid image itself is destroyed with the rest of imagePool
+		for (const VkImageView& levelView : depthPyramidLevelViews) {
+			vkDestroyImageView(device, levelView, nullptr);
+		}
+		if (occlusionCullPipeline != nullptr) {
+			vkDestroyPipeline(device, occlusionCullPipeline, nullptr);
+		}
+		if (depthPyramidPipeline != nullptr) {
+			vkDestroyPipeline(device, depthPyramidPipeline, nullptr);
+		}
+		vkDestroyPipelineLayout(device, occlusionCullPipelineLayout, nullptr);
+		vkDestroyPipelineLayout(device, depthPyramidPipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, occlusionCullDescriptorLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, depthPyramidDescriptorLayout, nullptr);
+	});
+
+	//the pyramid is written as a two channel float storage image, one of the extended storage formats
+	if (!storageImageExtendedFormats || !vk_util::SupportsFormatFeatures(physicalDevice, depthPyramidFormat, VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+		SDL_Log("The depth pyramid format isn't supported, culling without occlusion");
+		return SDL_APP_CONTINUE;
+	}
+
+	const std::filesystem::path compiledShadersPath = GetAssetsDir() / "shaders/compiled/";
+	const std::optional<VkShaderModule> depthPyramidShaderResult = vk_util::LoadShaderModule((compiledShadersPath / "hzb.comp.spv").string().c_str(), device);
+	const std::optional<VkShaderModule> occlusionCullShaderResult = vk_util::LoadShaderModule((compiledShadersPath / "cull_occlusion.comp.spv").string().c_str(), device);
+	if (depthPyramidShaderResult.has_value()) {
+		depthPyramidPipeline = vk_util::CreateComputePipeline(device, depthPyramidShaderResult.value(), depthPyramidPipelineLayout, depthPyramidWorkgroupSize).value_or(nullptr);
+		vkDestroyShaderModule(device, depthPyramidShaderResult.value(), nullptr);
+	}
+	if (occlusionCullShaderResult.has_value()) {
+		occlusionCullPipeline = vk_util::CreateComputePipeline(device, occlusionCullShaderResult.value(), occlusionCullPipelineLayout, cullWorkgroupSize).value_or(nullptr);
+		vkDestroyShaderModule(device, occlusionCullShaderResult.value(), nullptr);
+	}
+	if (depthPyramidPipeline == nullptr || occlusionCullPipeline == nullptr) {
+		SDL_Log("Couldn't create occlusion culling pipelines, culling without occlusion");
+		return SDL_APP_CONTINUE;
+	}
+
+	return SDL_APP_CONTINUE;
+}
+
+bool VulkanEngine::IsCompositionModeAvailable(const CompositionMode mode) const {
+	switch (mode) {
+		case CompositionMode::Compute:
+			return upscalePipeline != nullptr && swapchainSupportsStorage;
+		case CompositionMode::Raster:
+			return compositePipeline != nullptr;
+		case CompositionMode::Blit:
+		default:
+			return true;
+	}
+}
+
+bool VulkanEngine::IsInstanceDrawModeAvailable(const InstanceDrawMode mode) const {
+	switch (mode) {
+		case InstanceDrawMode::GpuDriven:
+			return cullPipeline != nullptr;
+		case InstanceDrawMode::Instanced:
+			return instancedMeshPipeline != nullptr;
+		case InstanceDrawMode::PerInstance:
+		default:
+			return true;
+	}
+}
+
+SDL_AppResult VulkanEngine::ImmediateSubmit(std::function<void(VkCommandBuffer commandBuffer)>&& function) const {
+	std::scoped_lock lock(immediateSubmitMutex);
+
+	VK_CHECK(vkResetFences(device, 1, &immediateSubmitFence), "Couldn't reset immediate submit fence");
+	VK_CHECK(vkResetCommandBuffer(immediateSubmitCommandBuffer, 0), "Couldn't reset immediate submit command buffer");
+
+	const VkCommandBuffer& commandBuffer = immediateSubmitCommandBuffer;
+
+	const VkCommandBufferBeginInfo cmdBeginInfo = vk_init::CommandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
+	VK_CHECK(vkBeginCommandBuffer(commandBuffer, &cmdBeginInfo), "Couldn't begin immediate command buffer");
+
+	function(commandBuffer);
+
+	VK_CHECK(vkEndCommandBuffer(commandBuffer), "Couldn't end immediate command buffer");
+
+	const VkCommandBufferSubmitInfo commandBufferSubmitInfo = vk_init::CommandBufferSubmitInfo(commandBuffer);
+	const VkSubmitInfo2 submit = vk_init::SubmitInfo(&commandBufferSubmitInfo, nullptr, nullptr);
+
+	VK_CHECK(vkQueueSubmit2(graphicsQueue, 1, &submit, immediateSubmitFence), "Couldn't submit immediate command buffer");
+
+	VK_CHECK(vkWaitForFences(device, 1, &immediateSubmitFence, true, secondInNanoseconds), "Couldn't wait for immediate submit fence");
+
+	return SDL_APP_CONTINUE;
+}
+
+SDL_AppResult VulkanEngine::InitImgui() {
+	// 1: create descriptor pool for IMGUI
 	//  the size of the pool is very oversized, but it's copied from imgui demo
 	//  itself.
 	std::array poolSizes = {
@@ -717,8 +1419,9 @@ SDL_AppResult VulkanEngine::InitImgui() {
 		.Device = device,
 		.Queue = graphicsQueue,
 		.DescriptorPool = imguiPool,
-		.MinImageCount = 3,
-		.ImageCount = 3,
+		.MinImageCount = 2,
+		//the backend cycles its vertex and index buffers by ImageCount, so it has to cover every frame in flight
+		.ImageCount = std::max(framePacing.framesInFlight, static_cast<uint32_t>(swapchainImages.size())),
 		.MSAASamples = VK_SAMPLE_COUNT_1_BIT,
 		.UseDynamicRendering = true,
 		//dynamic rendering parameters for imgui to use
@@ -732,7 +1435,7 @@ SDL_AppResult VulkanEngine::InitImgui() {
 	ImGui_ImplVulkan_Init(&imguiVulkanInitInfo);
 
 	// destroy the imgui created structures
-	mainDeletionQueue.PushFunction([=, this] {
+	initGraph.PushDeleter([=, this] {
 		ImGui_ImplVulkan_Shutdown();
 		vkDestroyDescriptorPool(device, imguiPool, nullptr);
 	});
@@ -740,16 +1443,32 @@ SDL_AppResult VulkanEngine::InitImgui() {
 	return SDL_APP_CONTINUE;
 }
 
-SDL_AppResult VulkanEngine::InitDefaultData() {
-	const std::filesystem::path fullPath = GetAssetsDir() / "models/suzanne/suzanne.obj";
-	// const std::filesystem::path fullPath = GetAssetsDir() / "models/container/blender_quad.obj";
-	std::optional<std::vector<std::shared_ptr<MeshAsset>>> meshResult = ImportMesh(this, fullPath);
+SDL_AppResult VulkanEngine::InitMeshes(std::vector<ParsedMesh>&& parsedMeshes) {
+	std::optional<std::vector<MeshAsset>> meshResult = UploadMeshes(this, std::move(parsedMeshes));
 	if (!meshResult.has_value()) {
-		SDL_Log("Couldn't import mesh!");
+		SDL_Log("Couldn't upload meshes!");
 		return SDL_APP_FAILURE;
 	}
-	meshes = std::move(meshResult.value());
+	for (MeshAsset& mesh : meshResult.value()) {
+		meshInfos.push_back(MeshInfo{
+			.texturePath = mesh.texturePath,
+			.boundingSphere = mesh.boundingSphere,
+			.firstIndex = mesh.surfaces[0].startIndex,
+			.indexCount = mesh.surfaces[0].count,
+		});
+		const VmaAllocation vertexAllocation = mesh.meshBuffers.vertexBuffer.allocation;
+		const VmaAllocation indexAllocation = mesh.meshBuffers.indexBuffer.allocation;
+		const Handle<MeshAsset> handle = meshPool.Add(std::move(mesh));
+		//defragmentation finds the mesh of a moved allocation through its owner
+		memoryTracker.SetOwner(vertexAllocation, handle.value);
+		memoryTracker.SetOwner(indexAllocation, handle.value);
+		meshes.push_back(handle);
+	}
+
+	return SDL_APP_CONTINUE;
+}
 
+SDL_AppResult VulkanEngine::InitTextures(const SDL_Surface& imageData) {
 	//3 default textures, white, grey, black. 1 pixel each
 	constexpr VkExtent3D pixelSize{1, 1, 1};
 
@@ -760,7 +1479,7 @@ SDL_AppResult VulkanEngine::InitDefaultData() {
 		SDL_Log("Couldn't create white image");
 		return SDL_APP_FAILURE;
 	}
-	whiteImage = whiteImageResult.value();
+	whiteImage = imagePool.Add(whiteImageResult.value());
 
 	// grey
 	const uint32_t grey = packUnorm4x8(math::float4(0.66f, 0.66f, 0.66f, 1));
@@ -769,7 +1488,7 @@ SDL_AppResult VulkanEngine::InitDefaultData() {
 		SDL_Log("Couldn't create grey image");
 		return SDL_APP_FAILURE;
 	}
-	greyImage = greyImageResult.value();
+	greyImage = imagePool.Add(greyImageResult.value());
 
 	// black
 	const uint32_t black = packUnorm4x8(math::float4(0, 0, 0, 0));
@@ -778,7 +1497,7 @@ SDL_AppResult VulkanEngine::InitDefaultData() {
 		SDL_Log("Couldn't create black image");
 		return SDL_APP_FAILURE;
 	}
-	blackImage = blackImageResult.value();
+	blackImage = imagePool.Add(blackImageResult.value());
 
 	//checkerboard image
 	const uint32_t magenta = packUnorm4x8(math::float4(1, 0, 1, 1));
@@ -793,80 +1512,237 @@ SDL_AppResult VulkanEngine::InitDefaultData() {
 		SDL_Log("Couldn't create error checkerboard image");
 		return SDL_APP_FAILURE;
 	}
-	errorCheckerboardImage = errorCheckerboardImageResult.value();
+	errorCheckerboardImage = imagePool.Add(errorCheckerboardImageResult.value());
 
 	//image texture
-	SDL_Surface* imageData = LoadImage(meshes[selectedMeshIndex]->texturePath, 4);
-	if (imageData == nullptr) {
-		SDL_Log("Couldn't load image data!");
+	std::optional<AllocatedImage> imageTextureResult = CreateImage(imageData.pixels, VkExtent3D{static_cast<uint32_t>(imageData.w), static_cast<uint32_t>(imageData.h), 1}, sizeof(uint32_t), VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT);
+	if (!imageTextureResult.has_value()) {
+		SDL_Log("Couldn't create image texture");
 		return SDL_APP_FAILURE;
 	}
-	std::optional<AllocatedImage> imageTextureResult = CreateImage(imageData->pixels, VkExtent3D{static_cast<uint32_t>(imageData->w), static_cast<uint32_t>(imageData->h), 1}, sizeof(uint32_t), VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT);
-	if (!errorCheckerboardImageResult.has_value()) {
-		SDL_Log("Couldn't create error checkerboard image");
-		return SDL_APP_FAILURE;
-	}
-	imageTexture = imageTextureResult.value();
-	SDL_DestroySurface(imageData);
+	imageTexture = imagePool.Add(imageTextureResult.value());
+	images = {whiteImage, blackImage, greyImage, errorCheckerboardImage, imageTexture};
 
 	VkSamplerCreateInfo sampler = {.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,};
 
 	sampler.magFilter = VK_FILTER_NEAREST;
 	sampler.minFilter = VK_FILTER_NEAREST;
-	vkCreateSampler(device, &sampler, nullptr, &defaultSamplerNearest);
+	VkSampler nearestSampler = nullptr;
+	VK_CHECK(vkCreateSampler(device, &sampler, nullptr, &nearestSampler), "Couldn't create nearest sampler");
+	defaultSamplerNearest = samplerPool.Add(nearestSampler);
 
 	sampler.magFilter = VK_FILTER_LINEAR;
 	sampler.minFilter = VK_FILTER_LINEAR;
-	vkCreateSampler(device, &sampler, nullptr, &defaultSamplerLinear);
-	mainDeletionQueue.PushFunction([&] {
-		vkDestroySampler(device, defaultSamplerNearest, nullptr);
-		vkDestroySampler(device, defaultSamplerLinear, nullptr);
-
-		DestroyImage(whiteImage);
-		DestroyImage(greyImage);
-		DestroyImage(blackImage);
-		DestroyImage(errorCheckerboardImage);
-		DestroyImage(imageTexture);
+	VkSampler linearSampler = nullptr;
+	VK_CHECK(vkCreateSampler(device, &sampler, nullptr, &linearSampler), "Couldn't create linear sampler");
+	defaultSamplerLinear = samplerPool.Add(linearSampler);
+
+	initGraph.PushDeleter([&] {
+		samplerPool.Clear([&](const VkSampler pooledSampler) { vkDestroySampler(device, pooledSampler, nullptr); });
+		imagePool.Clear([&](const AllocatedImage& image) { DestroyImage(image); });
+	});
+
+	return SDL_APP_CONTINUE;
+}
+
+SDL_AppResult VulkanEngine::InitInstances() {
+	BuildInstances();
+	if (const SDL_AppResult res = UploadInstances(instances); res != SDL_APP_CONTINUE) {
+		return res;
+	}
+	initGraph.PushDeleter([&] {
+		DestroyBuffer(instanceBuffer);
+		DestroyBuffer(drawCommandBuffer);
+		DestroyBuffer(drawCountBuffer);
+		DestroyBuffer(visibilityBuffer);
+		for (const FrameData& frame : frames) {
+			if (frame.instanceDataBuffer.internalBuffer != nullptr) {
+				DestroyBuffer(frame.instanceDataBuffer);
+			}
+		}
 	});
 
 	return SDL_APP_CONTINUE;
 }
 
-std::optional<AllocatedBuffer> VulkanEngine::CreateBuffer(const size_t allocSize, const VkBufferUsageFlags bufferUsage, const VmaMemoryUsage memoryUsage) const {
+void VulkanEngine::BuildInstances() {
+	const MeshInfo& mesh = meshInfos[selectedMeshIndex];
+	//every instance is the mesh where its node puts it, moved to its place in the grid
+	const std::optional<uint32_t> meshNode = sceneGraph.FindMeshNode(static_cast<uint32_t>(selectedMeshIndex));
+	const math::float4x4 meshWorldMatrix = meshNode.has_value() ? sceneGraph.GetWorldMatrix(meshNode.value()) : vk_util::IdentityMatrix();
+	const float worldRadius = mesh.boundingSphere.w * vk_util::MaxScale(meshWorldMatrix);
+	const uint32_t gridSize = static_cast<uint32_t>(std::max(instanceGridSize, 1));
+	//far enough apart that neighbours never overlap, centred on the origin the camera circles
+	const float spacing = worldRadius * 2.5f;
+	const float gridOffset = static_cast<float>(gridSize - 1) * spacing * 0.5f;
+
+	instances.clear();
+	instances.reserve(static_cast<size_t>(gridSize) * gridSize * gridSize);
+	std::vector<math::float3> boundsMins;
+	std::vector<math::float3> boundsMaxs;
+	boundsMins.reserve(instances.capacity());
+	boundsMaxs.reserve(instances.capacity());
+	for (uint32_t z = 0; z < gridSize; z++) {
+		for (uint32_t y = 0; y < gridSize; y++) {
+			for (uint32_t x = 0; x < gridSize; x++) {
+				const math::float3 position(static_cast<float>(x) * spacing - gridOffset, static_cast<float>(y) * spacing - gridOffset, static_cast<float>(z) * spacing - gridOffset);
+				instances.push_back(GPUInstance{
+					.transform = vk_util::MultiplyMatrices(TranslationScaleMatrix(position, 1.0f), meshWorldMatrix),
+					.boundingSphere = mesh.boundingSphere,
+					.firstIndex = mesh.firstIndex,
+					.indexCount = mesh.indexCount,
+					.vertexOffset = 0,
+					//there is only the one textured material so far
+					.materialIndex = 0,
+				});
+				//the box around the bounding sphere, for culling on the CPU
+				const math::float3 centre = vk_util::TransformPoint(instances.back().transform, math::float3(mesh.boundingSphere.x, mesh.boundingSphere.y, mesh.boundingSphere.z));
+				boundsMins.emplace_back(centre.x - worldRadius, centre.y - worldRadius, centre.z - worldRadius);
+				boundsMaxs.emplace_back(centre.x + worldRadius, centre.y + worldRadius, centre.z + worldRadius);
+			}
+		}
+	}
+
+	instanceGridRadius = gridOffset * std::sqrt(3.0f) + worldRadius;
+	cpuCuller.Build(boundsMins, boundsMaxs);
+	instancesChanged = false;
+
+	SDL_Log("Scene has %zu instances", instances.size());
+}
+
+SDL_AppResult VulkanEngine::UploadInstances(const std::vector<GPUInstance>& newInstances) {
+	const size_t instanceBufferSize = newInstances.size() * sizeof(GPUInstance);
+	const size_t drawCommandBufferSize = 2 * newInstances.size() * sizeof(VkDrawIndexedIndirectCommand);
+	const size_t visibilityBufferSize = newInstances.size() * sizeof(uint32_t);
+	//the same budget as the meshes, a small BAR window is left to them rather than shared with every upload
+	const VmaAllocationCreateFlags instanceUploadFlags = directMeshUploads ? directUploadFlags : 0;
+
+	const std::optional<AllocatedBuffer> instanceBufferResult = CreateBuffer(instanceBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, MemoryCategory::Buffers, instanceUploadFlags);
+	if (!instanceBufferResult.has_value()) {
+		SDL_Log("Couldn't create instance buffer");
+		return SDL_APP_FAILURE;
+	}
+	const std::optional<AllocatedBuffer> drawCommandBufferResult = CreateBuffer(drawCommandBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, MemoryCategory::Buffers);
+	if (!drawCommandBufferResult.has_value()) {
+		SDL_Log("Couldn't create draw command buffer");
+		return SDL_APP_FAILURE;
+	}
+	const std::optional<AllocatedBuffer> drawCountBufferResult = CreateBuffer(2 * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, MemoryCategory::Buffers);
+	if (!drawCountBufferResult.has_value()) {
+		SDL_Log("Couldn't create draw count buffer");
+		return SDL_APP_FAILURE;
+	}
+	//only ever written by the GPU, so it stays in device local memory and is cleared there
+	const std::optional<AllocatedBuffer> visibilityBufferResult = CreateBuffer(visibilityBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, MemoryCategory::Buffers);
+	if (!visibilityBufferResult.has_value()) {
+		SDL_Log("Couldn't create visibility buffer");
+		return SDL_APP_FAILURE;
+	}
+
+	//an instance buffer VMA put in host visible memory is written in place, otherwise it's filled by the graphics queue
+	const AllocatedBuffer& newInstanceBuffer = instanceBufferResult.value();
+	const AllocatedBuffer& newVisibilityBuffer = visibilityBufferResult.value();
+	const bool instancesMapped = newInstanceBuffer.allocationInfo.pMappedData != nullptr;
+	frameCounters.bytesUploaded += instanceBufferSize;
+
+	std::optional<AllocatedBuffer> stagingBuffer;
+	if (instancesMapped) {
+		memcpy(newInstanceBuffer.allocationInfo.pMappedData, newInstances.data(), instanceBufferSize);
+		VK_CHECK(vmaFlushAllocation(vmaAllocator, newInstanceBuffer.allocation, 0, instanceBufferSize), "Couldn't flush instance buffer");
+	} else {
+		stagingBuffer = CreateBuffer(instanceBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MemoryCategory::Staging, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+		if (!stagingBuffer.has_value()) {
+			SDL_Log("Couldn't create instance staging buffer");
+			return SDL_APP_FAILURE;
+		}
+		memcpy(stagingBuffer->allocationInfo.pMappedData, newInstances.data(), instanceBufferSize);
+	}
+
+	if (const SDL_AppResult res = ImmediateSubmit([&](const VkCommandBuffer& commandBuffer) {
+		if (stagingBuffer.has_value()) {
+			const VkBufferCopy instanceCopy{
+				.srcOffset = 0,
+				.dstOffset = 0,
+				.size = instanceBufferSize,
+			};
+			vkCmdCopyBuffer(commandBuffer, stagingBuffer->internalBuffer, newInstanceBuffer.internalBuffer, 1, &instanceCopy);
+		}
+		//nothing counts as visible in the first frame, so it's all drawn by the late pass
+		vkCmdFillBuffer(commandBuffer, newVisibilityBuffer.internalBuffer, 0, VK_WHOLE_SIZE, 0);
+	}); res != SDL_APP_CONTINUE) {
+		return res;
+	}
+
+	if (stagingBuffer.has_value()) {
+		DestroyBuffer(stagingBuffer.value());
+	}
+
+	//frames in flight may still draw with the old buffers
+	if (instanceBuffer.internalBuffer != nullptr) {
+		retiredResources.PushFunction(frameTimelineValue, [this, oldBuffers = std::array{instanceBuffer, drawCommandBuffer, drawCountBuffer, visibilityBuffer}] {
+			for (const AllocatedBuffer& buffer : oldBuffers) {
+				DestroyBuffer(buffer);
+			}
+		});
+	}
+	instanceBuffer = instanceBufferResult.value();
+	drawCommandBuffer = drawCommandBufferResult.value();
+	drawCountBuffer = drawCountBufferResult.value();
+	visibilityBuffer = visibilityBufferResult.value();
+	renderInstances = newInstances;
+
+	return SDL_APP_CONTINUE;
+}
+
+std::optional<AllocatedBuffer> VulkanEngine::CreateBuffer(const size_t allocSize, const VkBufferUsageFlags bufferUsage, const MemoryCategory category, const VmaAllocationCreateFlags allocationFlags, const VmaPool& pool) const {
 	const VkBufferCreateInfo bufferInfo = {
 		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
 		.size = allocSize,
 		.usage = bufferUsage,
 	};
 
+	//buffers the CPU writes stay mapped for their whole lifetime, the automatic usage keeps the others in device local memory
+	constexpr VmaAllocationCreateFlags hostAccessFlags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT;
 	const VmaAllocationCreateInfo vmaAllocInfo = {
-		.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
-		.usage = memoryUsage,
+		.flags = allocationFlags | ((allocationFlags & hostAccessFlags) != 0 ? VMA_ALLOCATION_CREATE_MAPPED_BIT : 0),
+		.usage = VMA_MEMORY_USAGE_AUTO,
+		.pool = pool,
 	};
 
-	AllocatedBuffer newBuffer{};
+	AllocatedBuffer newBuffer{.size = allocSize};
 	VK_CHECK_EMPTY_OPTIONAL(vmaCreateBuffer(vmaAllocator, &bufferInfo, &vmaAllocInfo, &newBuffer.internalBuffer, &newBuffer.allocation, &newBuffer.allocationInfo), "Failed to create buffer");
+	frameCounters.vmaAllocations++;
+	memoryTracker.Track(newBuffer.allocation, category);
 
 	return newBuffer;
 }
 
 void VulkanEngine::DestroyBuffer(const AllocatedBuffer& buffer) const {
+	memoryTracker.Untrack(buffer.allocation);
 	vmaDestroyBuffer(vmaAllocator, buffer.internalBuffer, buffer.allocation);
 }
 
+VkDeviceAddress VulkanEngine::GetBufferDeviceAddress(const AllocatedBuffer& buffer) const {
+	const VkBufferDeviceAddressInfo bufferDeviceAddressInfo{
+		.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+		.buffer = buffer.internalBuffer,
+	};
+	return vkGetBufferDeviceAddress(device, &bufferDeviceAddressInfo);
+}
+
 std::optional<GPUMeshBuffers> VulkanEngine::UploadMesh(std::span<Uint16> indices, std::span<MyVertex> vertices) const {
 	const size_t vertexBufferSize = vertices.size() * sizeof(MyVertex);
 	const size_t indexBufferSize = indices.size() * sizeof(Uint16);
 
 	//create vertex buffer
-	std::optional<AllocatedBuffer> vertexBufferResult = CreateBuffer(vertexBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+	std::optional<AllocatedBuffer> vertexBufferResult = CreateBuffer(vertexBufferSize, meshBufferUsage, MemoryCategory::Meshes, directUploadFlags, meshMemoryPool);
 	if (!vertexBufferResult.has_value()) {
 		SDL_Log("Failed to create vertex buffer");
 		return std::nullopt;
 	}
 	AllocatedBuffer vertexBuffer = vertexBufferResult.value();
 
-	std::optional<AllocatedBuffer> indexBufferResult = CreateBuffer(indexBufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+	std::optional<AllocatedBuffer> indexBufferResult = CreateBuffer(indexBufferSize, meshBufferUsage, MemoryCategory::Meshes, directUploadFlags, meshMemoryPool);
 	if (!indexBufferResult.has_value()) {
 		SDL_Log("Failed to create index buffer");
 		return std::nullopt;
@@ -885,7 +1761,18 @@ std::optional<GPUMeshBuffers> VulkanEngine::UploadMesh(std::span<Uint16> indices
 		.vertexBufferAddress = vkGetBufferDeviceAddress(device, &bufferDeviceAddressInfo),
 	};
 
-	std::optional<AllocatedBuffer> stagingResult = CreateBuffer(vertexBufferSize + indexBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+	//the mesh pool is mapped when it is in host visible memory, then the buffers are written in place without a copy
+	if (vertexBuffer.allocationInfo.pMappedData != nullptr && indexBuffer.allocationInfo.pMappedData != nullptr) {
+		memcpy(vertexBuffer.allocationInfo.pMappedData, vertices.data(), vertexBufferSize);
+		memcpy(indexBuffer.allocationInfo.pMappedData, indices.data(), indexBufferSize);
+		frameCounters.bytesUploaded += vertexBufferSize + indexBufferSize;
+		//host writes are made visible to the GPU by the next queue submit, but non-coherent memory has to be flushed first
+		VK_CHECK_EMPTY_OPTIONAL(vmaFlushAllocation(vmaAllocator, vertexBuffer.allocation, 0, vertexBufferSize), "Couldn't flush vertex buffer");
+		VK_CHECK_EMPTY_OPTIONAL(vmaFlushAllocation(vmaAllocator, indexBuffer.allocation, 0, indexBufferSize), "Couldn't flush index buffer");
+		return newSurface;
+	}
+
+	std::optional<AllocatedBuffer> stagingResult = CreateBuffer(vertexBufferSize + indexBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MemoryCategory::Staging, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
 	if (!stagingResult.has_value()) {
 		SDL_Log("Failed to create staging buffer");
 		return std::nullopt;
@@ -896,6 +1783,7 @@ std::optional<GPUMeshBuffers> VulkanEngine::UploadMesh(std::span<Uint16> indices
 
 	memcpy(data, vertices.data(), vertexBufferSize); // copy vertex buffer
 	memcpy(static_cast<char*>(data) + vertexBufferSize, indices.data(), indexBufferSize); // copy index buffer
+	frameCounters.bytesUploaded += vertexBufferSize + indexBufferSize;
 
 	if (const SDL_AppResult res = ImmediateSubmit([&](const VkCommandBuffer& commandBuffer) {
 		const VkBufferCopy vertexCopy{
@@ -921,7 +1809,7 @@ std::optional<GPUMeshBuffers> VulkanEngine::UploadMesh(std::span<Uint16> indices
 }
 
 SDL_AppResult VulkanEngine::CreateScreenImage(const void* pixels, const size_t pixelSize, const uint32_t width, const uint32_t height) {
-	const std::optional<AllocatedImage> screenImageResult = CreateImage(pixels, VkExtent3D{width, height, 1}, pixelSize, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_STORAGE_BIT, false, VK_IMAGE_LAYOUT_GENERAL);
+	const std::optional<AllocatedImage> screenImageResult = CreateImage(pixels, VkExtent3D{width, height, 1}, pixelSize, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_STORAGE_BIT, false, ImageUsage::ComputeRead);
 	if (!screenImageResult.has_value()) {
 		SDL_Log("Couldn't create screen image");
 		return SDL_APP_FAILURE;
@@ -940,9 +1828,14 @@ SDL_AppResult VulkanEngine::CreateScreenImage(const void* pixels, const size_t p
 
 #pragma endregion
 
-VulkanEngine::VulkanEngine(std::string name, const bool debugMode)
+VulkanEngine::VulkanEngine(std::string name, const bool debugMode, const uint32_t framesInFlight, const VkFormat drawImageFormat)
 	: name(std::move(name)),
-	  debugMode(debugMode) {
+	  debugMode(debugMode),
+	  drawImageFormat(drawImageFormat) {
+	framePacing.framesInFlight = std::clamp(framesInFlight, vk_util::minFramesInFlight, vk_util::maxFramesInFlight);
+	frames.resize(framePacing.framesInFlight);
+	//a new scale shows up in the measurements only after the frames already in flight
+	dynamicResolution.cooldownFrames = framePacing.framesInFlight + 6;
 }
 
 std::filesystem::path VulkanEngine::GetAssetsDir() const {
@@ -977,51 +1870,93 @@ SDL_Surface* VulkanEngine::LoadImage(const std::filesystem::path& imagePath, con
 }
 
 SDL_AppResult VulkanEngine::Init(const int width, const int height) {
-	constexpr SDL_WindowFlags windowFlags = SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE;
-	window = SDL_CreateWindow(name.c_str(), width, height, windowFlags);
-
-	if (window == nullptr) {
-		SDL_Log("Couldn't create window: %s", SDL_GetError());
-		return SDL_APP_FAILURE;
-	}
-
-	if (const SDL_AppResult res = InitVulkan(); res != SDL_APP_CONTINUE) {
-		return res;
-	}
-
-	if (const SDL_AppResult res = InitSwapchain(); res != SDL_APP_CONTINUE) {
-		return res;
-	}
-
-	if (const SDL_AppResult res = InitCommands(); res != SDL_APP_CONTINUE) {
-		return res;
-	}
-
-	if (const SDL_AppResult res = InitSyncStructures(); res != SDL_APP_CONTINUE) {
-		return res;
-	}
-
-	if (const SDL_AppResult res = InitDescriptors(); res != SDL_APP_CONTINUE) {
-		return res;
-	}
+	initStartTime = SDL_GetTicksNS();
+	tracer.SetThreadName("Simulation");
+
+	//every stage only waits for what it uses, so reading the assets and compiling the pipelines overlap with each other
+	//and with the Vulkan setup, the window and imgui stay on the main thread since SDL wants its video calls there
+	std::vector<ParsedMesh> parsedMeshes;
+	//kept apart, the mesh upload moves the parsed meshes while the texture is still being decoded
+	std::filesystem::path texturePath;
+	const InitStage parseMeshesStage = initGraph.AddStage("Mesh Parsing", [&] {
+		const std::filesystem::path fullPath = GetAssetsDir() / "models/suzanne/suzanne.obj";
+		// const std::filesystem::path fullPath = GetAssetsDir() / "models/container/blender_quad.obj";
+		std::optional<std::vector<ParsedMesh>> parseResult = ParseMesh(fullPath, &sceneGraph);
+		if (!parseResult.has_value()) {
+			SDL_Log("Couldn't import mesh!");
+			return SDL_APP_FAILURE;
+		}
+		parsedMeshes = std::move(parseResult.value());
+		texturePath = parsedMeshes[selectedMeshIndex].asset.texturePath;
+		sceneGraph.UpdateWorldMatrices(jobPool);
+		return SDL_APP_CONTINUE;
+	});
 
-	if (const SDL_AppResult res = InitPipelines(); res != SDL_APP_CONTINUE) {
-		return res;
-	}
+	SDL_Surface* textureData = nullptr;
+	const InitStage decodeTextureStage = initGraph.AddStage("Texture Decoding", [&] {
+		textureData = LoadImage(texturePath, 4);
+		if (textureData == nullptr) {
+			SDL_Log("Couldn't load image data!");
+			return SDL_APP_FAILURE;
+		}
+		return SDL_APP_CONTINUE;
+	}, {parseMeshesStage});
 
-	if (const SDL_AppResult res = InitImgui(); res != SDL_APP_CONTINUE) {
-		return res;
+	const InitStage windowStage = initGraph.AddMainThreadStage("Window", [&] {
+		constexpr SDL_WindowFlags windowFlags = SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE;
+		window = SDL_CreateWindow(name.c_str(), width, height, windowFlags);
+		if (window == nullptr) {
+			SDL_Log("Couldn't create window: %s", SDL_GetError());
+			return SDL_APP_FAILURE;
+		}
+		return SDL_APP_CONTINUE;
+	});
+	const InitStage vulkanStage = initGraph.AddMainThreadStage("Vulkan", [this] { return InitVulkan(); }, {windowStage});
+	const InitStage swapchainStage = initGraph.AddMainThreadStage("Swapchain", [this] { return InitSwapchain(); }, {vulkanStage});
+	const InitStage commandsStage = initGraph.AddStage("Commands", [this] { return InitCommands(); }, {vulkanStage});
+	const InitStage syncStage = initGraph.AddStage("Sync Structures", [this] { return InitSyncStructures(); }, {vulkanStage});
+	const InitStage descriptorsStage = initGraph.AddStage("Descriptors", [this] { return InitDescriptors(); }, {swapchainStage});
+
+	//the background effects are benchmarked on the GPU, which needs the immediate command buffer
+	initGraph.AddStage("Background Pipelines", [this] { return InitBackgroundPipelines(); }, {descriptorsStage, commandsStage, syncStage});
+	initGraph.AddStage("Mesh Pipelines", [this] { return InitMeshPipeline(); }, {descriptorsStage});
+	initGraph.AddStage("Upscale Pipeline", [this] { return InitUpscalePipeline(); }, {vulkanStage});
+	initGraph.AddStage("Composite Pipeline", [this] { return InitCompositePipeline(); }, {swapchainStage, descriptorsStage});
+	initGraph.AddStage("Cull Pipelines", [this] { return InitCullPipeline(); }, {vulkanStage});
+	initGraph.AddMainThreadStage("Imgui", [this] { return InitImgui(); }, {swapchainStage});
+
+	const InitStage meshesStage = initGraph.AddStage("Mesh Upload", [&] { return InitMeshes(std::move(parsedMeshes)); }, {parseMeshesStage, commandsStage, syncStage});
+	initGraph.AddStage("Texture Upload", [&] { return InitTextures(*textureData); }, {decodeTextureStage, commandsStage, syncStage});
+	initGraph.AddStage("Instances", [this] { return InitInstances(); }, {meshesStage});
+
+	const SDL_AppResult initResult = initGraph.Run(jobPool);
+	initGraph.LogTimeline();
+	SDL_DestroySurface(textureData);
+	if (initResult != SDL_APP_CONTINUE) {
+		return initResult;
+	}
+
+	//the stages only create what the device and the shipped shaders support, the settings follow from that here, on the
+	//main thread, rather than being written by stages running on other threads
+	settings.instanceDrawMode = IsInstanceDrawModeAvailable(InstanceDrawMode::GpuDriven) ? InstanceDrawMode::GpuDriven : InstanceDrawMode::PerInstance;
+	settings.occlusionCulling = depthPyramidPipeline != nullptr && occlusionCullPipeline != nullptr;
+
+	//the swapchain was created before the pipelines, so if the chosen mode's shaders are missing it's rebuilt for another mode
+	if (!IsCompositionModeAvailable(settings.compositionMode)) {
+		settings.compositionMode = IsCompositionModeAvailable(CompositionMode::Raster) ? CompositionMode::Raster : CompositionMode::Blit;
+		resizeRequested = true;
 	}
 
-	if (const SDL_AppResult res = InitDefaultData(); res != SDL_APP_CONTINUE) {
-		return res;
-	}
+	//from here on the swapchain, the frames and the queue belong to the render thread
+	renderSettings = settings;
+	renderSettings.presentMode = framePacing.presentMode;
+	renderThread = std::jthread([this] { RenderLoop(); });
 
 	return SDL_APP_CONTINUE;
 }
 
 SDL_AppResult VulkanEngine::DrawBackground(const VkCommandBuffer& commandBuffer) {
-	if (currentBackgroundEffectIndex == 2) {
+	if (renderSettings.currentBackgroundEffectIndex == 2) {
 		constexpr uint32_t width = 16;
 		constexpr uint32_t height = 16;
 		//screen image
@@ -1043,17 +1978,34 @@ SDL_AppResult VulkanEngine::DrawBackground(const VkCommandBuffer& commandBuffer)
 		currentFrame.frameDeletionQueue.PushFunction([&] { DestroyImage(currentFrame.screenImage); });
 	}
 
-	const ComputeEffect& currentEffect = backgroundEffects[currentBackgroundEffectIndex];
+	const ComputeEffect& currentEffect = backgroundEffects[renderSettings.currentBackgroundEffectIndex];
 
 	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, currentEffect.pipeline);
+	frameCounters.pipelineBinds++;
+
+	//the draw image can be reallocated on resize while older frames are in flight, so the set is written per frame
+	const std::optional<VkDescriptorSet> descriptorSetResult = GetCurrentFrame().frameDescriptors.Allocate(device, currentEffect.descriptorLayout);
+	if (!descriptorSetResult.has_value()) {
+		SDL_Log("Couldn't allocate descriptor set for background effect %s", currentEffect.name);
+		return SDL_APP_FAILURE;
+	}
+	const VkDescriptorSet descriptorSet = descriptorSetResult.value();
+	{
+		DescriptorWriter writer;
+		writer.WriteImage(0, drawImage.imageView, nullptr, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		if (currentEffect.descriptorLayout == screenImageDescriptorLayout) {
+			writer.WriteImage(1, GetCurrentFrame().screenImage.imageView, nullptr, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		}
+		writer.UpdateSet(device, descriptorSet);
+	}
 
-	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, currentEffect.layout, 0, 1, &currentEffect.descriptorSet, 0, nullptr);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, currentEffect.layout, 0, 1, &descriptorSet, 0, nullptr);
 
 	if (currentEffect.hasPushConstants) {
-		vkCmdPushConstants(commandBuffer, currentEffect.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputePushConstants), &currentEffect.data);
+		vkCmdPushConstants(commandBuffer, currentEffect.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ComputePushConstants), &renderSettings.backgroundEffectData);
 	}
 
-	vkCmdDispatch(commandBuffer, std::ceil(drawExtent.width / 16.0), std::ceil(drawExtent.height / 16.0), 1);
+	vk_util::DispatchForExtent(commandBuffer, drawExtent, currentEffect.workgroupSize);
 
 	return SDL_APP_CONTINUE;
 }
@@ -1064,44 +2016,12 @@ void VulkanEngine::DrawImGui(const VkCommandBuffer& commandBuffer, const VkImage
 
 	vkCmdBeginRendering(commandBuffer, &renderingInfo);
 
-	ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
+	ImGui_ImplVulkan_RenderDrawData(renderPacket->ui.GetDrawData(), commandBuffer);
 
 	vkCmdEndRendering(commandBuffer);
 }
 
-SDL_AppResult VulkanEngine::DrawGeometry(const VkCommandBuffer& commandBuffer) {
-	//begin a render pass  connected to our draw image
-	const VkRenderingAttachmentInfo colorAttachment = vk_init::AttachmentInfo(drawImage.imageView, nullptr, VK_IMAGE_LAYOUT_GENERAL);
-	const VkRenderingAttachmentInfo depthAttachment = vk_init::DepthAttachmentInfo(depthImage.imageView, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
-
-	const VkRenderingInfo renderInfo = vk_init::RenderingInfo(drawExtent, &colorAttachment, &depthAttachment);
-	vkCmdBeginRendering(commandBuffer, &renderInfo);
-
-	//set dynamic viewport and scissor
-	const VkViewport viewport{
-		.x = 0,
-		.y = 0,
-		.width = static_cast<float>(drawExtent.width),
-		.height = static_cast<float>(drawExtent.height),
-		.minDepth = 0.0f,
-		.maxDepth = 1.0f,
-	};
-
-	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-
-	const VkRect2D scissor = {
-		.offset = VkOffset2D{
-			.x = 0,
-			.y = 0
-		},
-		.extent = VkExtent2D{
-			.width = drawExtent.width,
-			.height = drawExtent.height,
-		},
-	};
-
-	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
+void VulkanEngine::UpdateCamera() {
 	if (ImGui::Begin("Camera")) {
 		ImGui::SliderFloat("Camera Radius", &cameraRadius, -20.0f, 20.0f);
 		ImGui::SliderFloat("Camera Height", &cameraHeight, -20.0f, 20.0f);
@@ -1110,7 +2030,209 @@ SDL_AppResult VulkanEngine::DrawGeometry(const VkCommandBuffer& commandBuffer) {
 	}
 	ImGui::End();
 
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, meshPipeline);
+	// > View Matrix
+	float camX = sinf(static_cast<float>(SDL_GetTicks()) * cameraRotationSpeed) * cameraRadius;
+	float camZ = cosf(static_cast<float>(SDL_GetTicks()) * cameraRotationSpeed) * cameraRadius;
+	math::float3 cameraPos = math::float3(camX, -cameraHeight, camZ);
+	math::float3 cameraTarget = math::float3(0.0f, 0.0f, 0.0f);
+	math::float3 up = math::float3(0.0f, 1.0f, 0.0f);
+	math::float4x4 view = inverse(look_at(cameraPos, cameraTarget, up));
+
+	// > Projection Matrix
+	math::int2 screenSize;
+	SDL_GetWindowSize(window, &screenSize.x, &screenSize.y);
+	math::float4x4 projection = perspective(math::degrees(cameraFOV).radians(),
+	                                        static_cast<float>(screenSize.x) / static_cast<float>(screenSize.y),
+	                                        0.1f, 1000.0f);
+
+	// invert the Y direction on projection matrix so that we are more similar to opengl and gltf axis
+	projection[1][1] *= -1;
+
+	sceneData.view = view;
+	sceneData.proj = projection;
+	sceneData.viewProj = view * projection;
+}
+
+void VulkanEngine::CullInstancesOnCpu(FramePacket& packet) {
+	TraceScope scope(tracer, "Cull Instances");
+	//the GPU-driven path culls on the GPU, the others record or write every instance so it pays off to skip the ones out of view
+	std::vector<uint32_t>& visibleInstances = packet.visibleInstances;
+	if (settings.instanceDrawMode == InstanceDrawMode::GpuDriven) {
+		visibleInstances.clear();
+		visibleInstanceCount = 0;
+		return;
+	}
+
+	const uint64_t cullStart = SDL_GetTicksNS();
+	if (cpuCulling) {
+		cpuCuller.Cull(sceneData.viewProj, jobPool, visibleInstances);
+	} else {
+		visibleInstances.resize(instances.size());
+		std::ranges::iota(visibleInstances, 0u);
+	}
+	cpuCullTime = static_cast<double>(SDL_GetTicksNS() - cullStart) / 1'000'000.0;
+	visibleInstanceCount = visibleInstances.size();
+}
+
+void VulkanEngine::WriteInstanceData(FramePacket& packet) const {
+	packet.instanceData.clear();
+	if (settings.instanceDrawMode != InstanceDrawMode::Instanced) return;
+
+	//every instance spins around its bounding sphere centre, so the culling bounds stay valid, and cycles through colours
+	const float time = static_cast<float>(SDL_GetTicks()) / 1000.0f;
+	packet.instanceData.reserve(packet.visibleInstances.size());
+	for (const uint32_t i : packet.visibleInstances) {
+		const GPUInstance& instance = instances[i];
+		const math::float3 centre = vk_util::TransformPoint(instance.transform, math::float3(instance.boundingSphere.x, instance.boundingSphere.y, instance.boundingSphere.z));
+		const float phase = static_cast<float>(i) * 0.37f;
+		packet.instanceData.push_back(GPUInstanceData{
+			.transform = vk_util::MultiplyMatrices(SpinMatrix(centre, time + phase), instance.transform),
+			.colour = math::float4(0.6f + 0.4f * std::cos(time + phase), 0.6f + 0.4f * std::cos(time + phase + 2.0f), 0.6f + 0.4f * std::cos(time + phase + 4.0f), 1.0f),
+		});
+	}
+}
+
+SDL_AppResult VulkanEngine::UploadInstanceData() {
+	const std::vector<GPUInstanceData>& instanceData = renderPacket->instanceData;
+	streamedInstanceCount = 0;
+	if (renderSettings.instanceDrawMode != InstanceDrawMode::Instanced) return SDL_APP_CONTINUE;
+
+	//this frame's buffer was last read by the frame that was waited on already, so it can be replaced right away
+	AllocatedBuffer& instanceDataBuffer = GetCurrentFrame().instanceDataBuffer;
+	const size_t requiredSize = std::max<size_t>(renderInstances.size(), 1) * sizeof(GPUInstanceData);
+	if (instanceDataBuffer.internalBuffer == nullptr || instanceDataBuffer.size < requiredSize) {
+		if (instanceDataBuffer.internalBuffer != nullptr) {
+			DestroyBuffer(instanceDataBuffer);
+		}
+		const std::optional<AllocatedBuffer> bufferResult = CreateBuffer(requiredSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, MemoryCategory::Buffers, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+		if (!bufferResult.has_value()) {
+			instanceDataBuffer = {};
+			SDL_Log("Couldn't create instance data buffer");
+			return SDL_APP_FAILURE;
+		}
+		instanceDataBuffer = bufferResult.value();
+	}
+
+	streamedInstanceCount = static_cast<uint32_t>(instanceData.size());
+	memcpy(instanceDataBuffer.allocationInfo.pMappedData, instanceData.data(), instanceData.size() * sizeof(GPUInstanceData));
+	//host writes are made visible to the GPU by the queue submit, but non-coherent memory has to be flushed first
+	VK_CHECK(vmaFlushAllocation(vmaAllocator, instanceDataBuffer.allocation, 0, streamedInstanceCount * sizeof(GPUInstanceData)), "Couldn't flush instance data");
+
+	return SDL_APP_CONTINUE;
+}
+
+SDL_AppResult VulkanEngine::DrawCull(const VkCommandBuffer& commandBuffer, const CullPhase phase) {
+	const bool occlusion = phase != CullPhase::Frustum;
+	const VkPipelineLayout& layout = occlusion ? occlusionCullPipelineLayout : cullPipelineLayout;
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, occlusion ? occlusionCullPipeline : cullPipeline);
+	frameCounters.pipelineBinds++;
+
+	//the frustum-only phase runs without a pyramid
+	const AllocatedImage* pyramid = imagePool.Get(depthPyramid);
+	const VkExtent3D pyramidExtent = pyramid != nullptr ? pyramid->imageExtent : VkExtent3D{};
+
+	if (occlusion) {
+		const std::optional<VkDescriptorSet> descriptorSetResult = GetCurrentFrame().frameDescriptors.Allocate(device, occlusionCullDescriptorLayout);
+		if (!descriptorSetResult.has_value()) {
+			SDL_Log("Couldn't allocate descriptor set for occlusion culling");
+			return SDL_APP_FAILURE;
+		}
+		DescriptorWriter writer;
+		writer.WriteImage(0, pyramid->imageView, *samplerPool.Get(defaultSamplerNearest), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+		writer.UpdateSet(device, descriptorSetResult.value());
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout, 0, 1, &descriptorSetResult.value(), 0, nullptr);
+	}
+
+	const CullPushConstants pushConstants{
+		.viewProjection = renderPacket->sceneData.viewProj,
+		.instanceBufferAddress = GetBufferDeviceAddress(instanceBuffer),
+		.drawCommandBufferAddress = GetBufferDeviceAddress(drawCommandBuffer),
+		.drawCountBufferAddress = GetBufferDeviceAddress(drawCountBuffer),
+		.visibilityBufferAddress = GetBufferDeviceAddress(visibilityBuffer),
+		.instanceCount = static_cast<uint32_t>(renderInstances.size()),
+		.frustumCulling = renderSettings.frustumCulling ? 1u : 0u,
+		.phase = phase,
+		.depthPyramidLevels = static_cast<uint32_t>(depthPyramidLevelViews.size()),
+		.depthPyramidSize = math::float2(static_cast<float>(pyramidExtent.width), static_cast<float>(pyramidExtent.height)),
+	};
+	vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &pushConstants);
+
+	vkCmdDispatch(commandBuffer, (pushConstants.instanceCount + cullWorkgroupSize.x - 1) / cullWorkgroupSize.x, 1, 1);
+
+	return SDL_APP_CONTINUE;
+}
+
+SDL_AppResult VulkanEngine::DrawDepthPyramid(const VkCommandBuffer& commandBuffer, const VkImageView& depthImageView) {
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, depthPyramidPipeline);
+	frameCounters.pipelineBinds++;
+
+	//the first level covers the part of the depth image that was rendered to
+	const VkExtent3D pyramidExtent = imagePool.Get(depthPyramid)->imageExtent;
+	VkExtent2D sourceExtent = drawExtent;
+	for (uint32_t level = 0; level < depthPyramidLevelViews.size(); level++) {
+		const VkExtent2D levelExtent{
+			.width = std::max(pyramidExtent.width >> level, 1u),
+			.height = std::max(pyramidExtent.height >> level, 1u),
+		};
+
+		const std::optional<VkDescriptorSet> descriptorSetResult = GetCurrentFrame().frameDescriptors.Allocate(device, depthPyramidDescriptorLayout);
+		if (!descriptorSetResult.has_value()) {
+			SDL_Log("Couldn't allocate descriptor set for the depth pyramid");
+			return SDL_APP_FAILURE;
+		}
+		{
+			DescriptorWriter writer;
+			if (level == 0) {
+				writer.WriteImage(0, depthImageView, *samplerPool.Get(defaultSamplerNearest), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+			} else {
+				writer.WriteImage(0, depthPyramidLevelViews[level - 1], *samplerPool.Get(defaultSamplerNearest), VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+			}
+			writer.WriteImage(1, depthPyramidLevelViews[level], nullptr, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+			writer.UpdateSet(device, descriptorSetResult.value());
+		}
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, depthPyramidPipelineLayout, 0, 1, &descriptorSetResult.value(), 0, nullptr);
+
+		const DepthPyramidPushConstants pushConstants{
+			.sourceSize = math::float2(static_cast<float>(sourceExtent.width), static_cast<float>(sourceExtent.height)),
+			.destinationSize = math::float2(static_cast<float>(levelExtent.width), static_cast<float>(levelExtent.height)),
+			.sourceIsDepth = level == 0 ? 1u : 0u,
+		};
+		vkCmdPushConstants(commandBuffer, depthPyramidPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DepthPyramidPushConstants), &pushConstants);
+
+		vkCmdDispatch(commandBuffer, (levelExtent.width + depthPyramidWorkgroupSize.x - 1) / depthPyramidWorkgroupSize.x, (levelExtent.height + depthPyramidWorkgroupSize.y - 1) / depthPyramidWorkgroupSize.y, 1);
+
+		//the next level reads this one, the render graph makes the last one visible to the late cull
+		if (level + 1 < depthPyramidLevelViews.size()) {
+			const VkMemoryBarrier2 memoryBarrier{
+				.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+				.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+				.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+				.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+				.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+			};
+			const VkDependencyInfo dependencyInfo{
+				.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+				.memoryBarrierCount = 1,
+				.pMemoryBarriers = &memoryBarrier,
+			};
+			vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+		}
+
+		sourceExtent = levelExtent;
+	}
+
+	return SDL_APP_CONTINUE;
+}
+
+SDL_AppResult VulkanEngine::DrawGeometry(const VkCommandBuffer& commandBuffer, const VkImageView& depthImageView, const CullPhase phase) {
+	const uint64_t recordStart = SDL_GetTicksNS();
+
+	const MeshAsset* mesh = meshPool.Get(meshes[selectedMeshIndex]);
+	const AllocatedImage* texture = imagePool.Get(images[renderSettings.selectedTextureIndex]);
+	if (mesh == nullptr || texture == nullptr) {
+		SDL_Log("Selected mesh or texture was released");
+		return SDL_APP_FAILURE;
+	}
 
 	//bind a texture
 	std::optional<VkDescriptorSet> imageSetResult = GetCurrentFrame().frameDescriptors.Allocate(device, singleImageDescriptorLayout);
@@ -1121,47 +2243,253 @@ SDL_AppResult VulkanEngine::DrawGeometry(const VkCommandBuffer& commandBuffer) {
 	VkDescriptorSet imageSet = imageSetResult.value();
 	{
 		DescriptorWriter writer;
-		writer.WriteImage(0, images[selectedTextureIndex]->imageView, defaultSamplerNearest, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+		writer.WriteImage(0, texture->imageView, *samplerPool.Get(defaultSamplerNearest), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
 		writer.UpdateSet(device, imageSet);
 	}
 
-	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, meshPipelineLayout, 0, 1, &imageSet, 0, nullptr);
+	//set dynamic viewport and scissor
+	const VkViewport viewport{
+		.x = 0,
+		.y = 0,
+		.width = static_cast<float>(drawExtent.width),
+		.height = static_cast<float>(drawExtent.height),
+		.minDepth = 0.0f,
+		.maxDepth = 1.0f,
+	};
 
-	// > View Matrix
-	float camX = sinf(static_cast<float>(SDL_GetTicks()) * cameraRotationSpeed) * cameraRadius;
-	float camZ = cosf(static_cast<float>(SDL_GetTicks()) * cameraRotationSpeed) * cameraRadius;
-	math::float3 cameraPos = math::float3(camX, -cameraHeight, camZ);
-	math::float3 cameraTarget = math::float3(0.0f, 0.0f, 0.0f);
-	math::float3 up = math::float3(0.0f, 1.0f, 0.0f);
-	math::float4x4 view = inverse(look_at(cameraPos, cameraTarget, up));
+	const VkRect2D scissor = {
+		.offset = VkOffset2D{
+			.x = 0,
+			.y = 0
+		},
+		.extent = VkExtent2D{
+			.width = drawExtent.width,
+			.height = drawExtent.height,
+		},
+	};
 
-	// > Projection Matrix
-	math::int2 screenSize;
-	SDL_GetWindowSize(window, &screenSize.x, &screenSize.y);
-	math::float4x4 projection = perspective(math::degrees(cameraFOV).radians(),
-	                                        static_cast<float>(screenSize.x) / static_cast<float>(screenSize.y),
-	                                        0.1f, 1000.0f);
+	const GPUDrawPushConstants pushConstants{
+		.worldMatrix = renderPacket->sceneData.viewProj,
+		.vertexBufferAddress = mesh->meshBuffers.vertexBufferAddress,
+		.instanceBufferAddress = renderSettings.instanceDrawMode == InstanceDrawMode::Instanced ? GetBufferDeviceAddress(GetCurrentFrame().instanceDataBuffer) : GetBufferDeviceAddress(instanceBuffer),
+	};
 
-	// invert the Y direction on projection matrix so that we are more similar to opengl and gltf axis
-	projection[1][1] *= -1;
+	//a secondary command buffer inherits none of this from the primary, so every buffer that draws binds it
+	const auto bindDrawState = [&](const VkCommandBuffer& cmd) {
+		vkCmdSetViewport(cmd, 0, 1, &viewport);
+		vkCmdSetScissor(cmd, 0, 1, &scissor);
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, renderSettings.instanceDrawMode == InstanceDrawMode::Instanced ? instancedMeshPipeline : meshPipeline);
+		frameCounters.pipelineBinds++;
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, meshPipelineLayout, 0, 1, &imageSet, 0, nullptr);
+		vkCmdPushConstants(cmd, meshPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(GPUDrawPushConstants), &pushConstants);
+		vkCmdBindIndexBuffer(cmd, mesh->meshBuffers.indexBuffer.internalBuffer, 0, VK_INDEX_TYPE_UINT16);
+	};
 
-	const GPUDrawPushConstants pushConstants{
-		.worldMatrix = view * projection,
-		.vertexBufferAddress = meshes[selectedMeshIndex]->meshBuffers.vertexBufferAddress,
+	//only the per-instance draws make a list long enough to be worth splitting over threads
+	const bool recordInParallel = renderSettings.parallelRecording && renderSettings.instanceDrawMode == InstanceDrawMode::PerInstance;
+
+	//begin a render pass  connected to our draw image, the late draws test against the depth of the early ones
+	const VkRenderingAttachmentInfo colorAttachment = vk_init::AttachmentInfo(drawImage.imageView, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	const VkRenderingAttachmentInfo depthAttachment = vk_init::DepthAttachmentInfo(depthImageView, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, phase == CullPhase::Late ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR);
+
+	VkRenderingInfo renderInfo = vk_init::RenderingInfo(drawExtent, &colorAttachment, &depthAttachment);
+	if (recordInParallel) {
+		renderInfo.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+	}
+	vkCmdBeginRendering(commandBuffer, &renderInfo);
+
+	if (recordInParallel) {
+		if (const SDL_AppResult res = RecordInstanceDrawsInParallel(commandBuffer, bindDrawState); res != SDL_APP_CONTINUE) {
+			return res;
+		}
+		vkCmdEndRendering(commandBuffer);
+		geometryRecordTime = static_cast<double>(SDL_GetTicksNS() - recordStart) / 1'000'000.0;
+		return SDL_APP_CONTINUE;
+	}
+
+	bindDrawState(commandBuffer);
+
+	switch (renderSettings.instanceDrawMode) {
+		case InstanceDrawMode::GpuDriven: {
+			//the cull pass wrote the commands and their count, so this costs the same for any number of instances
+			const uint32_t list = phase == CullPhase::Late ? 1 : 0;
+			vkCmdDrawIndexedIndirectCount(commandBuffer, drawCommandBuffer.internalBuffer, list * renderInstances.size() * sizeof(VkDrawIndexedIndirectCommand), drawCountBuffer.internalBuffer, list * sizeof(uint32_t), static_cast<uint32_t>(renderInstances.size()), sizeof(VkDrawIndexedIndirectCommand));
+			frameCounters.drawCalls++;
+			break;
+		}
+		case InstanceDrawMode::PerInstance:
+			//every draw starts at its own instance, so the vertex shader finds the same transform as with indirect draws
+			for (const uint32_t i : renderPacket->visibleInstances) {
+				vkCmdDrawIndexed(commandBuffer, renderInstances[i].indexCount, 1, renderInstances[i].firstIndex, renderInstances[i].vertexOffset, i);
+			}
+			frameCounters.drawCalls += renderPacket->visibleInstances.size();
+			break;
+		case InstanceDrawMode::Instanced: {
+			//all instances share the mesh, so a single draw covers every one that was written
+			const GeoSurface& surface = mesh->surfaces[0];
+			if (streamedInstanceCount > 0) {
+				vkCmdDrawIndexed(commandBuffer, surface.count, streamedInstanceCount, surface.startIndex, 0, 0);
+				frameCounters.drawCalls++;
+			}
+			break;
+		}
+	}
+
+	vkCmdEndRendering(commandBuffer);
+	geometryRecordTime = static_cast<double>(SDL_GetTicksNS() - recordStart) / 1'000'000.0;
+
+	return SDL_APP_CONTINUE;
+}
+
+SDL_AppResult VulkanEngine::RecordInstanceDrawsInParallel(const VkCommandBuffer& commandBuffer, const std::function<void(const VkCommandBuffer&)>& bindDrawState) {
+	FrameData& frame = GetCurrentFrame();
+
+	//contiguous ranges of the draw list, so executing them in order draws in the same order as a single thread would
+	const std::vector<uint32_t>& visibleInstances = renderPacket->visibleInstances;
+	const uint32_t drawCount = static_cast<uint32_t>(visibleInstances.size());
+	const uint32_t chunkCount = std::clamp((drawCount + minDrawsPerRecordingChunk - 1) / minDrawsPerRecordingChunk, 1u, static_cast<uint32_t>(frame.recordingCommandPools.size()));
+	const uint32_t drawsPerChunk = (drawCount + chunkCount - 1) / chunkCount;
+
+	const VkFormat colourFormat = drawImage.imageFormat;
+	const VkCommandBufferInheritanceRenderingInfo inheritanceRenderingInfo{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+		.colorAttachmentCount = 1,
+		.pColorAttachmentFormats = &colourFormat,
+		.depthAttachmentFormat = depthImageFormat,
+		.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+	};
+	//the statistics query of the geometry pass keeps counting the draws in the secondaries when they declare the same statistics
+	const VkCommandBufferInheritanceInfo inheritanceInfo{
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+		.pNext = &inheritanceRenderingInfo,
+		.pipelineStatistics = gpuProfiler.IsCollectingPipelineStatistics() ? GpuProfiler::pipelineStatisticFlags : 0u,
+	};
+	VkCommandBufferBeginInfo beginInfo = vk_init::CommandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT);
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+	//a chunk is recorded by one thread and every chunk has its own pool, so no pool is ever used by two threads at once
+	std::atomic<bool> failed = false;
+	jobPool.ParallelFor(chunkCount, [&](const uint32_t chunk) {
+		TraceScope scope(tracer, "Record Draw Chunk");
+		const VkCommandBuffer secondaryCommandBuffer = frame.recordingCommandBuffers[chunk];
+		//resetting the whole pool is cheaper than resetting its command buffers one by one
+		if (vkResetCommandPool(device, frame.recordingCommandPools[chunk], 0) != VK_SUCCESS || vkBeginCommandBuffer(secondaryCommandBuffer, &beginInfo) != VK_SUCCESS) {
+			failed = true;
+			return;
+		}
+
+		bindDrawState(secondaryCommandBuffer);
+		const uint32_t chunkEnd = std::min(drawCount, (chunk + 1) * drawsPerChunk);
+		frameCounters.drawCalls += chunkEnd - std::min(chunkEnd, chunk * drawsPerChunk);
+		for (uint32_t draw = chunk * drawsPerChunk; draw < chunkEnd; draw++) {
+			const uint32_t i = visibleInstances[draw];
+			vkCmdDrawIndexed(secondaryCommandBuffer, renderInstances[i].indexCount, 1, renderInstances[i].firstIndex, renderInstances[i].vertexOffset, i);
+		}
+
+		if (vkEndCommandBuffer(secondaryCommandBuffer) != VK_SUCCESS) {
+			failed = true;
+		}
+	});
+
+	if (failed) {
+		SDL_Log("Couldn't record secondary command buffers");
+		return SDL_APP_FAILURE;
+	}
+
+	vkCmdExecuteCommands(commandBuffer, chunkCount, frame.recordingCommandBuffers.data());
+	recordingChunkCount = chunkCount;
+
+	return SDL_APP_CONTINUE;
+}
+
+SDL_AppResult VulkanEngine::DrawUpscale(const VkCommandBuffer& commandBuffer, const VkImageView& targetImageView) {
+	const std::optional<VkDescriptorSet> descriptorSetResult = GetCurrentFrame().frameDescriptors.Allocate(device, upscaleDescriptorLayout);
+	if (!descriptorSetResult.has_value()) {
+		SDL_Log("Couldn't allocate descriptor set for upscaling");
+		return SDL_APP_FAILURE;
+	}
+	const VkDescriptorSet descriptorSet = descriptorSetResult.value();
+	{
+		DescriptorWriter writer;
+		writer.WriteImage(0, drawImage.imageView, nullptr, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		writer.WriteImage(1, targetImageView, nullptr, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		writer.UpdateSet(device, descriptorSet);
+	}
+
+	const UpscalePushConstants pushConstants{
+		.inputSize = math::float2(static_cast<float>(drawExtent.width), static_cast<float>(drawExtent.height)),
+		.outputSize = math::float2(static_cast<float>(swapchainExtent.width), static_cast<float>(swapchainExtent.height)),
+		.sharpness = renderSettings.upscaleSharpness,
+		.tonemapOperator = static_cast<uint32_t>(renderSettings.tonemapOperator),
+	};
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, upscalePipeline);
+	frameCounters.pipelineBinds++;
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, upscalePipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, upscalePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(UpscalePushConstants), &pushConstants);
+
+	vk_util::DispatchForExtent(commandBuffer, swapchainExtent, upscaleWorkgroupSize);
+
+	return SDL_APP_CONTINUE;
+}
+
+SDL_AppResult VulkanEngine::DrawComposite(const VkCommandBuffer& commandBuffer, const VkImageView& targetImageView) {
+	const std::optional<VkDescriptorSet> descriptorSetResult = GetCurrentFrame().frameDescriptors.Allocate(device, singleImageDescriptorLayout);
+	if (!descriptorSetResult.has_value()) {
+		SDL_Log("Couldn't allocate descriptor set for composition");
+		return SDL_APP_FAILURE;
+	}
+	const VkDescriptorSet descriptorSet = descriptorSetResult.value();
+	{
+		DescriptorWriter writer;
+		writer.WriteImage(0, drawImage.imageView, *samplerPool.Get(renderSettings.renderScaleFilter == VK_FILTER_NEAREST ? defaultSamplerNearest : defaultSamplerLinear), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+		writer.UpdateSet(device, descriptorSet);
+	}
+
+	//every pixel is overwritten, so the old contents don't have to be loaded
+	VkRenderingAttachmentInfo colourAttachment = vk_init::AttachmentInfo(targetImageView, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	colourAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	const VkRenderingInfo renderingInfo = vk_init::RenderingInfo(swapchainExtent, &colourAttachment, nullptr);
+
+	vkCmdBeginRendering(commandBuffer, &renderingInfo);
+
+	const VkViewport viewport{
+		.x = 0,
+		.y = 0,
+		.width = static_cast<float>(swapchainExtent.width),
+		.height = static_cast<float>(swapchainExtent.height),
+		.minDepth = 0.0f,
+		.maxDepth = 1.0f,
+	};
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+	const VkRect2D scissor = {
+		.offset = {0, 0},
+		.extent = swapchainExtent,
 	};
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-	vkCmdPushConstants(commandBuffer, meshPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(GPUDrawPushConstants), &pushConstants);
-	vkCmdBindIndexBuffer(commandBuffer, meshes[selectedMeshIndex]->meshBuffers.indexBuffer.internalBuffer, 0, VK_INDEX_TYPE_UINT16);
+	const CompositePushConstants pushConstants{
+		.uvScale = math::float2(static_cast<float>(drawExtent.width) / static_cast<float>(drawImage.imageExtent.width), static_cast<float>(drawExtent.height) / static_cast<float>(drawImage.imageExtent.height)),
+		.tonemapOperator = static_cast<uint32_t>(renderSettings.tonemapOperator),
+	};
 
-	vkCmdDrawIndexed(commandBuffer, meshes[selectedMeshIndex]->surfaces[0].count, 1, meshes[selectedMeshIndex]->surfaces[0].startIndex, 0, 0);
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, compositePipeline);
+	frameCounters.pipelineBinds++;
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, compositePipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, compositePipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(CompositePushConstants), &pushConstants);
+	vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+	frameCounters.drawCalls++;
 
+	//imgui goes on top in the same render pass, so the swapchain image is only written once
+	ImGui_ImplVulkan_RenderDrawData(renderPacket->ui.GetDrawData(), commandBuffer);
 
 	vkCmdEndRendering(commandBuffer);
 
 	return SDL_APP_CONTINUE;
 }
 
-std::optional<AllocatedImage> VulkanEngine::CreateImage(const VkExtent3D size, const VkFormat format, const VkImageUsageFlags usage, const bool mipmapped) const {
+std::optional<AllocatedImage> VulkanEngine::CreateImage(const VkExtent3D size, const VkFormat format, const VkImageUsageFlags usage, const MemoryCategory category, const bool mipmapped) const {
 	AllocatedImage newImage{
 		.imageExtent = size,
 		.imageFormat = format,
@@ -1174,17 +2502,16 @@ std::optional<AllocatedImage> VulkanEngine::CreateImage(const VkExtent3D size, c
 
 	// always allocate images on dedicated GPU memory
 	constexpr VmaAllocationCreateInfo allocationCreateInfo{
-		.usage = VMA_MEMORY_USAGE_GPU_ONLY,
+		.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
 		.requiredFlags = VkMemoryPropertyFlags{VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT},
 	};
 	// allocate and create the image
 	VK_CHECK_EMPTY_OPTIONAL(vmaCreateImage(vmaAllocator, &imageCreateInfo, &allocationCreateInfo, &newImage.image, &newImage.allocation, nullptr), "Failed to create image");
+	frameCounters.vmaAllocations++;
+	memoryTracker.Track(newImage.allocation, category);
 
 	// if the format is a depth format, we will need to have it use the correct aspect flag
-	VkImageAspectFlags aspectFlag = VK_IMAGE_ASPECT_COLOR_BIT;
-	if (format == VK_FORMAT_D32_SFLOAT) {
-		aspectFlag = VK_IMAGE_ASPECT_DEPTH_BIT;
-	}
+	const VkImageAspectFlags aspectFlag = vk_util::AspectMaskForFormat(format);
 
 	// build an image-view for the image
 	VkImageViewCreateInfo viewCreateInfo = vk_init::ImageViewCreateInfo(format, newImage.image, aspectFlag);
@@ -1195,9 +2522,9 @@ std::optional<AllocatedImage> VulkanEngine::CreateImage(const VkExtent3D size, c
 	return newImage;
 }
 
-std::optional<AllocatedImage> VulkanEngine::CreateImage(const void* data, const VkExtent3D imageSize, const size_t pixelSize, const VkFormat format, const VkImageUsageFlags usage, const bool mipmapped, const VkImageLayout finalLayout) const {
+std::optional<AllocatedImage> VulkanEngine::CreateImage(const void* data, const VkExtent3D imageSize, const size_t pixelSize, const VkFormat format, const VkImageUsageFlags usage, const bool mipmapped, const ImageUsage finalUsage) const {
 	const size_t dataSize = imageSize.depth * imageSize.width * imageSize.height * pixelSize;
-	const std::optional<AllocatedBuffer> uploadBufferResult = CreateBuffer(dataSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+	const std::optional<AllocatedBuffer> uploadBufferResult = CreateBuffer(dataSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MemoryCategory::Staging, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
 	if (!uploadBufferResult.has_value()) {
 		SDL_Log("Couldn't create upload buffer for image");
 		return std::nullopt;
@@ -1205,8 +2532,9 @@ std::optional<AllocatedImage> VulkanEngine::CreateImage(const void* data, const
 	const AllocatedBuffer uploadBuffer = uploadBufferResult.value();
 
 	memcpy(uploadBuffer.allocationInfo.pMappedData, data, dataSize);
+	frameCounters.bytesUploaded += dataSize;
 
-	const std::optional<AllocatedImage> newImageResult = CreateImage(imageSize, format, usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, mipmapped);
+	const std::optional<AllocatedImage> newImageResult = CreateImage(imageSize, format, usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, MemoryCategory::Textures, mipmapped);
 	if (!newImageResult.has_value()) {
 		SDL_Log("Couldn't create image");
 		return std::nullopt;
@@ -1214,7 +2542,9 @@ std::optional<AllocatedImage> VulkanEngine::CreateImage(const void* data, const
 	AllocatedImage new_image = newImageResult.value();
 
 	if (const SDL_AppResult res = ImmediateSubmit([&](const VkCommandBuffer& commandBuffer) {
-		vk_util::TransitionImage(commandBuffer, new_image.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		BarrierBuilder barriers;
+		barriers.Transition(new_image, ImageUsage::TransferDst, true);
+		barriers.Flush(commandBuffer);
 
 		const VkBufferImageCopy copyRegion = {
 			.bufferOffset = 0,
@@ -1232,7 +2562,8 @@ std::optional<AllocatedImage> VulkanEngine::CreateImage(const void* data, const
 		// copy the buffer into the image
 		vkCmdCopyBufferToImage(commandBuffer, uploadBuffer.internalBuffer, new_image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
 
-		vk_util::TransitionImage(commandBuffer, new_image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, finalLayout);
+		barriers.Transition(new_image, finalUsage);
+		barriers.Flush(commandBuffer);
 	}); res != SDL_APP_CONTINUE) {
 		return std::nullopt;
 	}
@@ -1244,16 +2575,216 @@ std::optional<AllocatedImage> VulkanEngine::CreateImage(const void* data, const
 
 void VulkanEngine::DestroyImage(const AllocatedImage& allocatedImage) const {
 	vkDestroyImageView(device, allocatedImage.imageView, nullptr);
+	memoryTracker.Untrack(allocatedImage.allocation);
 	vmaDestroyImage(vmaAllocator, allocatedImage.image, allocatedImage.allocation);
 }
 
-SDL_AppResult VulkanEngine::Draw() {
-	if (resizeRequested) {
-		if (const SDL_AppResult res = ResizeSwapchain(); res != SDL_APP_CONTINUE) {
-			return res;
+void VulkanEngine::DrawFramePacingUi() {
+	if (ImGui::Begin("Frame Pacing")) {
+		ImGui::Text("Frames in flight: %u (set at startup)", framePacing.framesInFlight);
+
+		if (ImGui::BeginCombo("Present Mode", vk_util::PresentModeName(framePacing.presentMode))) {
+			for (const VkPresentModeKHR presentMode : vk_util::selectablePresentModes) {
+				const bool supported = std::ranges::find(supportedPresentModes, presentMode) != supportedPresentModes.end();
+				ImGui::BeginDisabled(!supported);
+				if (ImGui::Selectable(vk_util::PresentModeName(presentMode), presentMode == framePacing.presentMode) && presentMode != framePacing.presentMode) {
+					//the present mode is fixed per swapchain, so switching it recreates the swapchain
+					framePacing.presentMode = presentMode;
+					resizeRequested = true;
+				}
+				ImGui::EndDisabled();
+			}
+			ImGui::EndCombo();
+		}
+
+		int frameLimit = static_cast<int>(framePacing.frameLimit);
+		if (ImGui::SliderInt("Frame Limit", &frameLimit, 0, 480, frameLimit == 0 ? "Off" : "%d fps")) {
+			framePacing.frameLimit = static_cast<uint32_t>(std::max(frameLimit, 0));
+		}
+
+		framePacingStats.DrawImGuiTable();
+	}
+	ImGui::End();
+}
+
+void VulkanEngine::DrawGpuProfilerUi() {
+	if (ImGui::Begin("GPU Profiler")) {
+		if (!gpuProfiler.IsEnabled()) {
+			ImGui::TextUnformatted("The graphics queue doesn't support timestamps");
+		} else {
+			ImGui::Text("Over the last %zu frames", GpuTimingStats::rollingSampleCount);
+			if (ImGui::Button("Export CSV")) {
+				gpuTimingStats.ExportCsv(userDataDirectory / "gpu_timings.csv");
+			}
+			ImGui::SameLine();
+			if (ImGui::Button("Clear")) {
+				gpuTimingStats.Clear();
+			}
+
+			gpuTimingStats.DrawImGuiTable();
+		}
+	}
+	ImGui::End();
+}
+
+void VulkanEngine::DrawTraceUi() {
+	if (ImGui::Begin("Trace")) {
+		ImGui::SliderInt("Frames", &traceFrameCount, 1, 300);
+		ImGui::BeginDisabled(tracer.IsCapturing());
+		if (ImGui::Button("Capture Trace")) {
+			tracer.BeginCapture(static_cast<uint32_t>(traceFrameCount), userDataDirectory / "trace.json");
+		}
+		ImGui::EndDisabled();
+
+		if (tracer.IsCapturing()) {
+			ImGui::Text("Capturing, %u frames left", tracer.GetFramesLeft());
+		} else {
+			ImGui::TextUnformatted("Written to trace.json in the user data directory, open it in ui.perfetto.dev");
+		}
+		if (!calibratedTimestampsSupported) {
+			ImGui::TextUnformatted("No calibrated timestamps, GPU scopes are aligned to the recording of their frame");
+		}
+	}
+	ImGui::End();
+}
+
+void VulkanEngine::DrawCountersUi() {
+	if (ImGui::Begin("Counters")) {
+		if (ImGui::Button("Export JSON")) {
+			vk_util::ExportFrameCountersJson(userDataDirectory / "frame_counters.json", lastFrameResults.counters, lastFrameResults.gpuScopeTimings);
+		}
+		if (!pipelineStatisticsSupported) {
+			ImGui::TextUnformatted("The device doesn't support pipeline statistics queries");
+		}
+
+		//the GPU results are read once the frame's slot comes around again, so they trail the engine counters by the frames in flight
+		vk_util::DrawFrameCountersTable(lastFrameResults.counters, lastFrameResults.gpuScopeTimings);
+	}
+	ImGui::End();
+}
+
+void VulkanEngine::DrawVulkanCallsUi() {
+	if (ImGui::Begin("Vulkan Calls")) {
+		if constexpr (VK_CALL_SHIMS) {
+			ImGui::Text("%zu entry points called last frame", lastFrameResults.vulkanCalls.size());
+			vk_util::DrawCallStatsTable(lastFrameResults.vulkanCalls);
+		} else {
+			ImGui::TextUnformatted("Configure with -DVULKAN_HELPERS_CALL_SHIMS=ON to count and time Vulkan calls");
+		}
+	}
+	ImGui::End();
+}
+
+void VulkanEngine::DrawMemoryUi() {
+	if (ImGui::Begin("Memory")) {
+		if (ImGui::Button("Export JSON")) {
+			memoryTracker.ExportJson(userDataDirectory / "memory_stats.json");
 		}
+		if (!memoryBudgetSupported) {
+			ImGui::TextUnformatted("No VK_EXT_memory_budget, the budgets are estimates");
+		}
+		ImGui::Text("Mesh uploads: %s", directMeshUploads ? "written in place (host visible device local)" : "staged");
+
+		ImGui::Checkbox("Auto Defragment Meshes", &settings.autoDefragmentation);
+		ImGui::BeginDisabled(lastFrameResults.defragmenting);
+		if (ImGui::Button("Defragment Meshes")) {
+			defragmentationRequested = true;
+		}
+		ImGui::EndDisabled();
+		if (lastFrameResults.defragmenting) {
+			ImGui::SameLine();
+			ImGui::TextUnformatted("Defragmenting");
+		}
+
+		memoryTracker.DrawImGuiTables(lastFrameResults.heapBudgets);
 	}
+	ImGui::End();
+}
+
+void VulkanEngine::ReadFrameTimestamps(FrameData& frame, FrameResults& results) {
+	if (!frame.timestampsWritten) return;
+	frame.timestampsWritten = false;
+
+	//the frame's timeline value has been reached, so the results are available without waiting
+	std::array<uint64_t, 2> timestamps{};
+	if (vkGetQueryPoolResults(device, frame.timestampQueryPool, 0, 2, sizeof(timestamps), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+		return;
+	}
+
+	const uint64_t validMask = graphicsQueueTimestampValidBits >= 64 ? ~0ull : (1ull << graphicsQueueTimestampValidBits) - 1;
+	const uint64_t gpuFrameStart = timestamps[0] & validMask;
+	const uint64_t gpuFrameEnd = timestamps[1] & validMask;
 
+	//frames are read back in submission order, so the last end belongs to the frame right before this one
+	if (lastGpuFrameEnd != 0 && gpuFrameStart >= lastGpuFrameEnd) {
+		const double idleTicks = static_cast<double>(gpuFrameStart - lastGpuFrameEnd);
+		results.gpuIdleTime = static_cast<uint64_t>(idleTicks * physicalDeviceProperties.limits.timestampPeriod);
+	}
+	lastGpuFrameEnd = gpuFrameEnd;
+
+	//the frame's own timestamps also span waiting for the acquired image under FIFO, the passes only start after it.
+	//From the first pass to the last still counts the barriers and gaps between them
+	if (!results.gpuScopeTimings.empty()) {
+		uint64_t passesStart = UINT64_MAX;
+		uint64_t passesEnd = 0;
+		for (const GpuScopeTiming& timing : results.gpuScopeTimings) {
+			passesStart = std::min(passesStart, timing.startTime);
+			passesEnd = std::max(passesEnd, timing.endTime);
+		}
+		if (passesEnd > passesStart) {
+			results.gpuFrameTime = static_cast<double>(passesEnd - passesStart) / 1'000'000.0;
+		}
+	} else if (gpuFrameEnd > gpuFrameStart) {
+		results.gpuFrameTime = static_cast<double>(gpuFrameEnd - gpuFrameStart) * physicalDeviceProperties.limits.timestampPeriod / 1'000'000.0;
+	}
+}
+
+void VulkanEngine::ApplyFrameResults(const FrameResults& results) {
+	if (results.gpuIdleTime.has_value()) {
+		framePacingStats.RecordGpuIdle(results.gpuIdleTime.value());
+	}
+	settings.renderScale = dynamicResolution.Update(results.gpuFrameTime, settings.renderScale);
+	gpuTimingStats.Record(results.gpuScopeTimings);
+	if (results.rendered) {
+		lastFrameResults = results;
+	}
+}
+
+SDL_AppResult VulkanEngine::Simulate() {
+	//the render thread only records its first failure and stops drawing, the failure ends the app from here
+	if (const SDL_AppResult res = renderResult.load(); res != SDL_APP_CONTINUE) {
+		return res;
+	}
+
+	const uint64_t simulateStart = SDL_GetTicksNS();
+	framePacingStats.BeginFrame(framePacing);
+
+	//blocks while the render thread still draws the packet before the last one, so the simulation stays one frame ahead
+	FramePacket& packet = framePackets.BeginWrite();
+	const uint64_t packetWaitEnd = SDL_GetTicksNS();
+	tracer.RecordCpu("Wait For Render Thread", simulateStart, packetWaitEnd);
+
+	//the slot comes back with what the render thread measured while drawing it
+	const uint64_t renderWaitTime = packet.results.cpuWaitTime;
+	ApplyFrameResults(packet.results);
+	packet.results = {};
+
+	//limiting after the wait means everything below, including input, happens as late as possible
+	const uint64_t limiterWaitTime = frameLimiter.Wait(framePacing.frameLimit);
+	const uint64_t limiterWaitEnd = SDL_GetTicksNS();
+	tracer.RecordCpu("Frame Limiter", limiterWaitEnd - limiterWaitTime, limiterWaitEnd);
+	framePacingStats.RecordCpuWait(renderWaitTime, limiterWaitTime);
+
+	//the render thread keeps its own copy of the instances, so it only gets them when they change
+	packet.instancesRebuilt = instancesChanged;
+	packet.rebuiltInstances.clear();
+	if (instancesChanged) {
+		BuildInstances();
+		packet.rebuiltInstances = instances;
+	}
+
+	//before any packet is drawn the render thread is idle, so imgui's first frame can set up its font texture from here
+	const uint64_t uiStart = SDL_GetTicksNS();
 	ImGui_ImplVulkan_NewFrame();
 	ImGui_ImplSDL3_NewFrame();
 	ImGui::NewFrame();
@@ -1261,97 +2792,621 @@ SDL_AppResult VulkanEngine::Draw() {
 	// ImGui::ShowDemoWindow();
 
 	if (ImGui::Begin("Background")) {
-		ImGui::SliderFloat("Render Scale", &renderScale, 0.3f, 1.0f);
-		renderScale = math::clamp(renderScale, 0.01f, 1.0f); //to prevent manual (typed, not slid) input from going out of bounds
-		ImGui::SliderInt("Render Scale Filter", reinterpret_cast<int*>(&renderScaleFilter), 0, 1);
+		//the controller needs GPU timestamps to measure frame times
+		if (graphicsQueueTimestampValidBits != 0) {
+			dynamicResolution.DrawImGui();
+		}
+		ImGui::BeginDisabled(dynamicResolution.enabled);
+		ImGui::SliderFloat("Render Scale", &settings.renderScale, 0.3f, 1.0f);
+		ImGui::EndDisabled();
+		settings.renderScale = math::clamp(settings.renderScale, 0.01f, 1.0f); //to prevent manual (typed, not slid) input from going out of bounds
+		constexpr std::array compositionModeNames = {"Blit", "Compute", "Raster"};
+		if (ImGui::BeginCombo("Composition", compositionModeNames[static_cast<size_t>(settings.compositionMode)])) {
+			for (size_t i = 0; i < compositionModeNames.size(); i++) {
+				const CompositionMode mode = static_cast<CompositionMode>(i);
+				ImGui::BeginDisabled(!IsCompositionModeAvailable(mode));
+				if (ImGui::Selectable(compositionModeNames[i], mode == settings.compositionMode) && mode != settings.compositionMode) {
+					//the swapchain usage flags depend on the mode
+					settings.compositionMode = mode;
+					resizeRequested = true;
+				}
+				ImGui::EndDisabled();
+			}
+			ImGui::EndCombo();
+		}
+		if (settings.compositionMode == CompositionMode::Compute) {
+			ImGui::SliderFloat("Sharpness", &settings.upscaleSharpness, 0.0f, 1.0f);
+		} else {
+			ImGui::SliderInt("Render Scale Filter", reinterpret_cast<int*>(&settings.renderScaleFilter), 0, 1);
+		}
+		if (settings.compositionMode != CompositionMode::Blit) {
+			ImGui::Combo("Tonemap", &settings.tonemapOperator, "Clamp\0Reinhard\0ACES\0");
+		}
+		ImGui::Text("Draw format: %s, %ux%u", vk_util::StorageFormatQualifier(drawImageFormat), lastFrameResults.drawImageExtent.width, lastFrameResults.drawImageExtent.height);
 
-		const ComputeEffect& currentEffect = backgroundEffects[currentBackgroundEffectIndex];
+		const ComputeEffect& currentEffect = backgroundEffects[settings.currentBackgroundEffectIndex];
 
 		ImGui::Text("Selected effect: ", currentEffect.name);
-		ImGui::SliderInt("Effect Index", &currentBackgroundEffectIndex, 0, static_cast<int>(backgroundEffects.size() - 1));
+		ImGui::SliderInt("Effect Index", &settings.currentBackgroundEffectIndex, 0, static_cast<int>(backgroundEffects.size() - 1));
 
 		ImGui::InputFloat4("data1", const_cast<float*>(&currentEffect.data.data1.x));
 		ImGui::InputFloat4("data2", const_cast<float*>(&currentEffect.data.data2.x));
 		ImGui::InputFloat4("data3", const_cast<float*>(&currentEffect.data.data3.x));
 		ImGui::InputFloat4("data4", const_cast<float*>(&currentEffect.data.data4.x));
 
-		ImGui::Text("Monkey Texture: %s", meshes[selectedMeshIndex]->texturePath.string().c_str());
-		ImGui::SliderInt("Selected Texture", &selectedTextureIndex, 0, static_cast<int>(images.size()) - 1);
+		ImGui::Text("Monkey Texture: %s", meshInfos[selectedMeshIndex].texturePath.string().c_str());
+		ImGui::SliderInt("Selected Texture", &settings.selectedTextureIndex, 0, static_cast<int>(images.size()) - 1);
 	}
 	ImGui::End();
 
-	VK_CHECK(vkWaitForFences(device, 1, &GetCurrentFrame().renderFence, true, secondInNanoseconds), "Couldn't wait for fence");
+	if (ImGui::Begin("Scene")) {
+		ImGui::Text("Instances: %zu", instances.size());
+		if (ImGui::SliderInt("Grid Size", &instanceGridSize, 1, 64)) {
+			instancesChanged = true;
+		}
+		constexpr std::array instanceDrawModeNames = {"GPU-Driven", "Per Instance", "Instanced"};
+		if (ImGui::BeginCombo("Draw Mode", instanceDrawModeNames[static_cast<size_t>(settings.instanceDrawMode)])) {
+			for (size_t i = 0; i < instanceDrawModeNames.size(); i++) {
+				const InstanceDrawMode mode = static_cast<InstanceDrawMode>(i);
+				ImGui::BeginDisabled(!IsInstanceDrawModeAvailable(mode));
+				if (ImGui::Selectable(instanceDrawModeNames[i], mode == settings.instanceDrawMode)) {
+					settings.instanceDrawMode = mode;
+				}
+				ImGui::EndDisabled();
+			}
+			ImGui::EndCombo();
+		}
+		const bool gpuDriven = settings.instanceDrawMode == InstanceDrawMode::GpuDriven;
+		ImGui::BeginDisabled(!gpuDriven);
+		ImGui::Checkbox("Frustum Culling", &settings.frustumCulling);
+		ImGui::EndDisabled();
+		ImGui::BeginDisabled(!gpuDriven || occlusionCullPipeline == nullptr);
+		ImGui::Checkbox("Occlusion Culling", &settings.occlusionCulling);
+		ImGui::EndDisabled();
+		ImGui::BeginDisabled(gpuDriven);
+		ImGui::Checkbox("CPU Frustum Culling", &cpuCulling);
+		ImGui::EndDisabled();
+		if (!gpuDriven) {
+			ImGui::Text("Drawn: %zu, CPU cull time: %.3f ms on %u threads", visibleInstanceCount, cpuCullTime, jobPool.GetThreadCount());
+		}
+		ImGui::BeginDisabled(settings.instanceDrawMode != InstanceDrawMode::PerInstance);
+		ImGui::Checkbox("Parallel Recording", &settings.parallelRecording);
+		ImGui::EndDisabled();
+		//measured on the render thread, for the frame before the last one
+		if (settings.parallelRecording && settings.instanceDrawMode == InstanceDrawMode::PerInstance) {
+			ImGui::Text("Geometry recording: %.3f ms in %u secondary command buffers", lastFrameResults.geometryRecordTime, lastFrameResults.recordingChunkCount);
+		} else {
+			ImGui::Text("Geometry recording: %.3f ms", lastFrameResults.geometryRecordTime);
+		}
+		if (ImGui::CollapsingHeader("Scene Graph")) {
+			ImGui::Text("Nodes: %u", sceneGraph.GetNodeCount());
+			for (uint32_t node = 0; node < sceneGraph.GetNodeCount(); node++) {
+				uint32_t depth = 0;
+				for (uint32_t parent = sceneGraph.GetParent(node); parent != SceneGraph::noParent; parent = sceneGraph.GetParent(parent)) {
+					depth++;
+				}
+				ImGui::Text("%*s%s (%zu meshes)", static_cast<int>(depth * 2), "", sceneGraph.GetName(node).c_str(), sceneGraph.GetMeshes(node).size());
+			}
+			//runs within this frame, so it stalls for a moment
+			if (ImGui::Button("Run Scene Graph Benchmark")) {
+				//a pool of its own, the render thread keeps recording on the shared one meanwhile
+				JobPool benchmarkPool;
+				sceneGraphBenchmarkResults = vk_util::RunSceneGraphBenchmark(benchmarkPool);
+			}
+			vk_util::DrawSceneGraphBenchmarkTable(sceneGraphBenchmarkResults);
+		}
+		if (ImGui::CollapsingHeader("CPU Culling Benchmark")) {
+			//runs within this frame, so it stalls for a moment
+			if (ImGui::Button("Run Benchmark")) {
+				JobPool benchmarkPool;
+				cullingBenchmarkResults = vk_util::RunCullingBenchmark(sceneData.viewProj, instanceGridRadius, benchmarkPool);
+			}
+			vk_util::DrawCullingBenchmarkTable(cullingBenchmarkResults);
+		}
+		if (ImGui::CollapsingHeader("Job System Benchmark")) {
+			//runs within this frame, so it stalls for a while
+			if (ImGui::Button("Run Job System Benchmark")) {
+				jobBenchmarkResults = vk_util::RunJobBenchmark(sceneData.viewProj, instanceGridRadius);
+			}
+			vk_util::DrawJobBenchmarkTable(jobBenchmarkResults);
+		}
+	}
+	ImGui::End();
+
+	DrawFramePacingUi();
+	DrawGpuProfilerUi();
+	DrawTraceUi();
+	DrawCountersUi();
+	DrawVulkanCallsUi();
+	DrawMemoryUi();
+	tracer.RecordCpu("ImGui UI", uiStart, SDL_GetTicksNS());
+	UpdateCamera();
+	CullInstancesOnCpu(packet);
+	WriteInstanceData(packet);
+
+	const uint64_t imguiRenderStart = SDL_GetTicksNS();
+	ImGui::Render();
+
+#if IMGUI_VERSION_NUM >= 19200
+	//the backend uploads textures with a submit of its own on the graphics queue, which the render thread mustn't use meanwhile
+	if (const ImDrawData* drawData = ImGui::GetDrawData(); drawData->Textures != nullptr) {
+		for (ImTextureData* texture : *drawData->Textures) {
+			if (texture->Status != ImTextureStatus_OK) {
+				framePackets.WaitUntilEmpty();
+				ImGui_ImplVulkan_UpdateTexture(texture);
+			}
+		}
+	}
+#endif
+	packet.ui.Capture(*ImGui::GetDrawData());
+	tracer.RecordCpu("ImGui Render", imguiRenderStart, SDL_GetTicksNS());
+
+	int32_t width, height;
+	if (!SDL_GetWindowSize(window, &width, &height)) {
+		SDL_Log("Couldn't get window size: %s", SDL_GetError());
+		return SDL_APP_FAILURE;
+	}
+
+	packet.stop = false;
+	packet.windowExtent = VkExtent2D{static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+	packet.resizeRequested = resizeRequested;
+	packet.defragmentationRequested = defragmentationRequested;
+	packet.settings = settings;
+	packet.settings.presentMode = framePacing.presentMode;
+	packet.settings.backgroundEffectData = backgroundEffects[settings.currentBackgroundEffectIndex].data;
+	packet.sceneData = sceneData;
+	framePackets.Publish();
+	resizeRequested = false;
+	defragmentationRequested = false;
+
+	tracer.RecordCpu("Simulate", simulateStart, SDL_GetTicksNS());
+	tracer.EndFrame();
+
+	return SDL_APP_CONTINUE;
+}
+
+void VulkanEngine::RenderLoop() {
+	tracer.SetThreadName("Render");
+	while (true) {
+		FramePacket& packet = framePackets.BeginRead();
+		if (packet.stop) {
+			framePackets.Release();
+			return;
+		}
+
+		//after a failure the packets are still released, so the simulation thread never blocks on them
+		if (renderResult.load() == SDL_APP_CONTINUE) {
+			if (const SDL_AppResult res = Render(packet); res != SDL_APP_CONTINUE) {
+				renderResult = res;
+			}
+		}
+		renderPacket = nullptr;
+		framePackets.Release();
+	}
+}
+
+void VulkanEngine::StopRenderThread() {
+	if (!renderThread.joinable()) return;
+
+	//the render thread releases every packet, so there is always a slot for this one
+	FramePacket& packet = framePackets.BeginWrite();
+	packet.stop = true;
+	framePackets.Publish();
+	renderThread.join();
+}
+
+SDL_AppResult VulkanEngine::DefragmentMeshMemory(const uint64_t completedTimelineValue, const bool start) {
+	if (pendingDefragmentationPass.has_value()) {
+		//frames recorded before the pass still read the old buffers
+		if (completedTimelineValue < pendingDefragmentationPass->timelineValue) return SDL_APP_CONTINUE;
+
+		for (const VkBuffer oldBuffer : pendingDefragmentationPass->oldBuffers) {
+			vkDestroyBuffer(device, oldBuffer, nullptr);
+		}
+		const VkResult passResult = vmaEndDefragmentationPass(vmaAllocator, meshDefragmentation, &pendingDefragmentationPass->moveInfo);
+		pendingDefragmentationPass.reset();
+		if (passResult == VK_SUCCESS) {
+			EndMeshDefragmentation();
+			return SDL_APP_CONTINUE;
+		}
+	} else if (meshDefragmentation == nullptr) {
+		if (!start) return SDL_APP_CONTINUE;
+
+		const VmaDefragmentationInfo defragmentationInfo{
+			.flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT,
+			.pool = meshMemoryPool,
+			.maxBytesPerPass = defragmentationBytesPerPass,
+			.maxAllocationsPerPass = defragmentationMovesPerPass,
+		};
+		VK_CHECK(vmaBeginDefragmentation(vmaAllocator, &defragmentationInfo, &meshDefragmentation), "Couldn't begin mesh memory defragmentation");
+	}
 
-	GetCurrentFrame().frameDeletionQueue.Flush();
+	VmaDefragmentationPassMoveInfo moveInfo{};
+	const VkResult beginResult = vmaBeginDefragmentationPass(vmaAllocator, meshDefragmentation, &moveInfo);
+	//nothing is left to move
+	if (beginResult == VK_SUCCESS) {
+		EndMeshDefragmentation();
+		return SDL_APP_CONTINUE;
+	}
+	if (beginResult != VK_INCOMPLETE) {
+		VK_CHECK(beginResult, "Couldn't begin mesh memory defragmentation pass");
+	}
+
+	//every moved buffer is recreated on its new memory, the old buffer stays valid for the frames still in flight
+	struct BufferMove {
+		GPUMeshBuffers* meshBuffers;
+		AllocatedBuffer* buffer;
+		VkBuffer newBuffer;
+	};
+	std::vector<BufferMove> bufferMoves;
+	for (uint32_t i = 0; i < moveInfo.moveCount; i++) {
+		VmaDefragmentationMove& move = moveInfo.pMoves[i];
+
+		//the allocation's owner is the handle of its mesh, which stops resolving once the mesh is released
+		VmaAllocationInfo allocationInfo;
+		vmaGetAllocationInfo(vmaAllocator, move.srcAllocation, &allocationInfo);
+		BufferMove bufferMove{};
+		if (MeshAsset* mesh = meshPool.Get(Handle<MeshAsset>{MemoryTracker::GetOwner(allocationInfo)}); mesh != nullptr) {
+			if (mesh->meshBuffers.vertexBuffer.allocation == move.srcAllocation) {
+				bufferMove = BufferMove{.meshBuffers = &mesh->meshBuffers, .buffer = &mesh->meshBuffers.vertexBuffer};
+			} else if (mesh->meshBuffers.indexBuffer.allocation == move.srcAllocation) {
+				bufferMove = BufferMove{.meshBuffers = &mesh->meshBuffers, .buffer = &mesh->meshBuffers.indexBuffer};
+			}
+		}
+		//released meshes are freed once the pass is over, moving them would be wasted
+		if (bufferMove.buffer == nullptr) {
+			move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+			continue;
+		}
+
+		//the allocation was made for the old buffer's memory requirements, so a buffer of the same size fits it
+		const VkBufferCreateInfo bufferInfo{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+			.size = bufferMove.buffer->size,
+			.usage = meshBufferUsage,
+		};
+		VK_CHECK(vkCreateBuffer(device, &bufferInfo, nullptr, &bufferMove.newBuffer), "Couldn't create defragmented mesh buffer");
+		VK_CHECK(vmaBindBufferMemory(vmaAllocator, move.dstTmpAllocation, bufferMove.newBuffer), "Couldn't bind defragmented mesh buffer");
+		bufferMoves.push_back(bufferMove);
+	}
+
+	if (!bufferMoves.empty()) {
+		if (const SDL_AppResult res = ImmediateSubmit([&](const VkCommandBuffer& commandBuffer) {
+			for (const BufferMove& bufferMove : bufferMoves) {
+				const VkBufferCopy copy{
+					.srcOffset = 0,
+					.dstOffset = 0,
+					.size = bufferMove.buffer->size,
+				};
+				vkCmdCopyBuffer(commandBuffer, bufferMove.buffer->internalBuffer, bufferMove.newBuffer, 1, &copy);
+			}
+		}); res != SDL_APP_CONTINUE) {
+			return res;
+		}
+	}
+
+	//frames from here on draw from the new buffers
+	MeshDefragmentationPass pass{
+		.moveInfo = moveInfo,
+		.timelineValue = frameTimelineValue,
+	};
+	for (const BufferMove& bufferMove : bufferMoves) {
+		pass.oldBuffers.push_back(bufferMove.buffer->internalBuffer);
+		bufferMove.buffer->internalBuffer = bufferMove.newBuffer;
+		if (bufferMove.buffer == &bufferMove.meshBuffers->vertexBuffer) {
+			bufferMove.meshBuffers->vertexBufferAddress = GetBufferDeviceAddress(*bufferMove.buffer);
+		}
+	}
+	pendingDefragmentationPass = std::move(pass);
+
+	return SDL_APP_CONTINUE;
+}
+
+void VulkanEngine::EndMeshDefragmentation() {
+	if (pendingDefragmentationPass.has_value()) {
+		for (const VkBuffer oldBuffer : pendingDefragmentationPass->oldBuffers) {
+			vkDestroyBuffer(device, oldBuffer, nullptr);
+		}
+		vmaEndDefragmentationPass(vmaAllocator, meshDefragmentation, &pendingDefragmentationPass->moveInfo);
+		pendingDefragmentationPass.reset();
+	}
+	if (meshDefragmentation == nullptr) return;
+
+	VmaDefragmentationStats stats;
+	vmaEndDefragmentation(vmaAllocator, meshDefragmentation, &stats);
+	meshDefragmentation = nullptr;
+	meshDefragmentationEndFrame = frameNumber;
+
+	//moved allocations keep their handle, only the memory and offset they report changed
+	for (MeshAsset& mesh : meshPool.GetAll()) {
+		vmaGetAllocationInfo(vmaAllocator, mesh.meshBuffers.vertexBuffer.allocation, &mesh.meshBuffers.vertexBuffer.allocationInfo);
+		vmaGetAllocationInfo(vmaAllocator, mesh.meshBuffers.indexBuffer.allocation, &mesh.meshBuffers.indexBuffer.allocationInfo);
+	}
+
+	if (stats.allocationsMoved > 0) {
+		SDL_Log("Defragmented mesh memory: moved %u allocations (%.2f MB), freed %u blocks", stats.allocationsMoved, static_cast<double>(stats.bytesMoved) / (1024.0 * 1024.0), stats.deviceMemoryBlocksFreed);
+	}
+}
+
+bool VulkanEngine::IsMeshMemoryFragmented() const {
+	if (meshDefragmentation != nullptr) return false;
+
+	VmaStatistics statistics;
+	vmaGetPoolStatistics(vmaAllocator, meshMemoryPool, &statistics);
+	if (statistics.blockCount < 2) return false;
+	return statistics.blockBytes - statistics.allocationBytes >= statistics.blockBytes / statistics.blockCount;
+}
+
+SDL_AppResult VulkanEngine::Render(FramePacket& packet) {
+	renderPacket = &packet;
+	renderSettings = packet.settings;
+
+	//the instances are only in the packet of the frame they changed in, so they're taken over even when nothing is drawn
+	if (packet.instancesRebuilt) {
+		if (const SDL_AppResult res = UploadInstances(packet.rebuiltInstances); res != SDL_APP_CONTINUE) {
+			return res;
+		}
+	}
+
+	//resize events only request a resize, so any number of them within a frame cost a single swapchain rebuild
+	if (packet.resizeRequested) {
+		swapchainOutOfDate = true;
+	}
+	if (swapchainOutOfDate) {
+		if (const SDL_AppResult res = ResizeSwapchain(packet.windowExtent); res != SDL_APP_CONTINUE) {
+			return res;
+		}
+		//still minimized
+		if (swapchainOutOfDate) {
+			return SDL_APP_CONTINUE;
+		}
+	}
+
+	//wait until the GPU is done with the last frame that used this frame's resources
+	const uint64_t gpuWaitStart = SDL_GetTicksNS();
+	const VkSemaphoreWaitInfo timelineWaitInfo{
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+		.semaphoreCount = 1,
+		.pSemaphores = &frameTimeline,
+		.pValues = &GetCurrentFrame().timelineValue,
+	};
+	VK_CHECK(vkWaitSemaphores(device, &timelineWaitInfo, secondInNanoseconds), "Couldn't wait for frame timeline");
+	const uint64_t gpuWaitEnd = SDL_GetTicksNS();
+	uint64_t cpuWaitTime = gpuWaitEnd - gpuWaitStart;
+	tracer.RecordCpu("Wait For Frame", gpuWaitStart, gpuWaitEnd);
+
+	uint64_t completedTimelineValue = 0;
+	VK_CHECK(vkGetSemaphoreCounterValue(device, frameTimeline, &completedTimelineValue), "Couldn't get frame timeline value");
+	frameCounters.deletionQueueEntriesFlushed += retiredResources.Flush(completedTimelineValue);
+
+	vmaSetCurrentFrameIndex(vmaAllocator, static_cast<uint32_t>(frameNumber));
+	//a pool that stays fragmented after a defragmentation is only tried again after a while
+	const bool autoDefragmentationDue = renderSettings.autoDefragmentation && frameNumber >= meshDefragmentationEndFrame + autoDefragmentationInterval;
+	const bool startDefragmentation = packet.defragmentationRequested || (autoDefragmentationDue && IsMeshMemoryFragmented());
+	if (const SDL_AppResult res = DefragmentMeshMemory(completedTimelineValue, startDefragmentation); res != SDL_APP_CONTINUE) {
+		return res;
+	}
+	//VMA doesn't allow freeing allocations that are part of an unfinished pass
+	if (!pendingDefragmentationPass.has_value()) {
+		meshPool.Collect(completedTimelineValue, [&](const MeshAsset& mesh) {
+			DestroyBuffer(mesh.meshBuffers.indexBuffer);
+			DestroyBuffer(mesh.meshBuffers.vertexBuffer);
+		});
+	}
+	imagePool.Collect(completedTimelineValue, [&](const AllocatedImage& image) { DestroyImage(image); });
+	samplerPool.Collect(completedTimelineValue, [&](const VkSampler sampler) { vkDestroySampler(device, sampler, nullptr); });
+
+	if (occlusionCullPipeline != nullptr) {
+		if (const SDL_AppResult res = ResizeDepthPyramid(); res != SDL_APP_CONTINUE) {
+			return res;
+		}
+	}
+
+	gpuProfiler.ReadResults(static_cast<uint32_t>(frameNumber % frames.size()), packet.results.gpuScopeTimings);
+	ReadFrameTimestamps(GetCurrentFrame(), packet.results);
+	if (tracer.IsCapturing()) {
+		for (const GpuScopeTiming& timing : packet.results.gpuScopeTimings) {
+			tracer.RecordGpu(timing.name, timing.startTime, timing.endTime);
+		}
+	}
+
+	if (const SDL_AppResult res = UploadInstanceData(); res != SDL_APP_CONTINUE) {
+		return res;
+	}
+
+	frameCounters.deletionQueueEntriesFlushed += GetCurrentFrame().frameDeletionQueue.Flush();
 	GetCurrentFrame().frameDescriptors.ClearPools(device);
 
+	const uint64_t acquireStart = SDL_GetTicksNS();
 	uint32_t swapchainImageIndex;
-	if (const VkResult err = vkAcquireNextImageKHR(device, swapchain, secondInNanoseconds, GetCurrentFrame().swapchainSemaphore, nullptr, &swapchainImageIndex);
-		err == VK_ERROR_OUT_OF_DATE_KHR || err == VK_SUBOPTIMAL_KHR) {
-		resizeRequested = true;
-		ImGui::EndFrame();
+	const VkResult acquireResult = vkAcquireNextImageKHR(device, swapchain, secondInNanoseconds, GetCurrentFrame().swapchainSemaphore, nullptr, &swapchainImageIndex);
+	const uint64_t acquireEnd = SDL_GetTicksNS();
+	cpuWaitTime += acquireEnd - acquireStart;
+	tracer.RecordCpu("Acquire Image", acquireStart, acquireEnd);
+	packet.results.cpuWaitTime = cpuWaitTime;
+
+	//a suboptimal image can still be presented, and its acquire semaphore has been signalled so the frame has to go on
+	if (acquireResult == VK_SUBOPTIMAL_KHR) {
+		swapchainOutOfDate = true;
+	} else if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR) {
+		swapchainOutOfDate = true;
 		return SDL_APP_CONTINUE;
-	} else if (err != VK_SUCCESS) {
-		SDL_Log("Detected Vulkan error: %s: %s", "Couldn't acquire next image", string_VkResult(err));
+	} else if (acquireResult != VK_SUCCESS) {
+		SDL_Log("Detected Vulkan error: %s: %s", "Couldn't acquire next image", string_VkResult(acquireResult));
 		SDL_TriggerBreakpoint();
 		return SDL_APP_FAILURE;
 	}
 
-	drawExtent.height = static_cast<uint32_t>(static_cast<float>(std::min(swapchainExtent.height, drawImage.imageExtent.height)) * renderScale);
-	drawExtent.width = static_cast<uint32_t>(static_cast<float>(std::min(swapchainExtent.width, drawImage.imageExtent.width)) * renderScale);
-
-	VK_CHECK(vkResetFences(device, 1, &GetCurrentFrame().renderFence), "Couldn't reset fence");
+	drawExtent.height = static_cast<uint32_t>(static_cast<float>(std::min(swapchainExtent.height, drawImage.imageExtent.height)) * renderSettings.renderScale);
+	drawExtent.width = static_cast<uint32_t>(static_cast<float>(std::min(swapchainExtent.width, drawImage.imageExtent.width)) * renderSettings.renderScale);
 
 	const VkCommandBuffer& commandBuffer = GetCurrentFrame().mainCommandBuffer;
 
+	const uint64_t recordStart = SDL_GetTicksNS();
 	VK_CHECK(vkResetCommandBuffer(commandBuffer, 0), "Couldn't reset command buffer");
 
 	const VkCommandBufferBeginInfo commandBufferBeginInfo = vk_init::CommandBufferBeginInfo(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 
 	VK_CHECK(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo), "Couldn't begin command buffer");
 
-	// transition our main draw image into general layout so we can write into it.
-	// we will overwrite it all so we don't care about what was the older layout
-	vk_util::TransitionImage(commandBuffer, drawImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
-
-	if (const SDL_AppResult res = DrawBackground(commandBuffer); res != SDL_APP_CONTINUE) {
-		return res;
+	if (GetCurrentFrame().timestampQueryPool != nullptr) {
+		vkCmdResetQueryPool(commandBuffer, GetCurrentFrame().timestampQueryPool, 0, 2);
+		vkCmdWriteTimestamp2(commandBuffer, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, GetCurrentFrame().timestampQueryPool, 0);
 	}
+	//without inherited queries no query may be active while the parallel recording's secondaries execute
+	const bool recordsSecondaries = renderSettings.parallelRecording && renderSettings.instanceDrawMode == InstanceDrawMode::PerInstance;
+	gpuProfiler.BeginFrame(commandBuffer, static_cast<uint32_t>(frameNumber % frames.size()), inheritedQueriesSupported || !recordsSecondaries);
 
-	vk_util::TransitionImage(commandBuffer, drawImage.image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
-	vk_util::TransitionImage(commandBuffer, depthImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+	//the swapchain image becomes usable once the acquire semaphore is waited on, at the colour attachment output stage
+	ImageState& swapchainImageState = swapchainImageStates[swapchainImageIndex];
+	swapchainImageState = ImageState{
+		.layout = VK_IMAGE_LAYOUT_UNDEFINED,
+		.stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+	};
 
-	if (const SDL_AppResult res = DrawGeometry(commandBuffer); res != SDL_APP_CONTINUE) {
-		return res;
+	RenderGraph& renderGraph = GetCurrentFrame().renderGraph;
+	renderGraph.Reset();
+
+	//two-phase occlusion culling samples the depth of the early draws to build the pyramid
+	const bool gpuDriven = renderSettings.instanceDrawMode == InstanceDrawMode::GpuDriven;
+	const bool twoPhaseCulling = gpuDriven && renderSettings.occlusionCulling && occlusionCullPipeline != nullptr;
+
+	const RenderGraphImage drawTarget = renderGraph.ImportImage("draw", drawImage);
+	const RenderGraphImage depthTarget = renderGraph.CreateImage("depth", TransientImageDescription{
+		.extent = drawImage.imageExtent,
+		.format = depthImageFormat,
+		.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | (twoPhaseCulling ? VK_IMAGE_USAGE_SAMPLED_BIT : 0u),
+	});
+	const RenderGraphImage swapchainTarget = renderGraph.ImportImage("swapchain", swapchainImages[swapchainImageIndex], swapchainImageViews[swapchainImageIndex], swapchainImageState, swapchainImageFormat, VkExtent3D{swapchainExtent.width, swapchainExtent.height, 1});
+	renderGraph.MarkOutput(swapchainTarget, ImageUsage::Present);
+
+	//the background covers the whole draw image so its older contents are discarded
+	renderGraph.AddPass("background", [&](const VkCommandBuffer& cmd) {
+		return DrawBackground(cmd);
+	}).Write(drawTarget, ImageUsage::ComputeWrite, true);
+
+	const RenderGraphBuffer instanceResource = renderGraph.ImportBuffer("instances", instanceBuffer);
+	const RenderGraphBuffer drawCommandResource = renderGraph.ImportBuffer("draw commands", drawCommandBuffer);
+	const RenderGraphBuffer drawCountResource = renderGraph.ImportBuffer("draw counts", drawCountBuffer);
+	const RenderGraphBuffer visibilityResource = renderGraph.ImportBuffer("visibility", visibilityBuffer);
+	//only resized into existence when the occlusion cull pipelines are there
+	RenderGraphImage depthPyramidTarget;
+	if (twoPhaseCulling) {
+		depthPyramidTarget = renderGraph.ImportImage("depth pyramid", *imagePool.Get(depthPyramid));
+	}
+	const CullPhase firstPhase = twoPhaseCulling ? CullPhase::Early : CullPhase::Frustum;
+
+	// cull every instance and write an indirect command for each visible one
+	if (gpuDriven) {
+		renderGraph.AddPass("reset draw counts", [&](const VkCommandBuffer& cmd) {
+			vkCmdFillBuffer(cmd, drawCountBuffer.internalBuffer, 0, VK_WHOLE_SIZE, 0);
+			return SDL_APP_CONTINUE;
+		}).Write(drawCountResource, BufferUsage::TransferDst);
+
+		RenderGraphPass& cullPass = renderGraph.AddPass("cull", [&, firstPhase](const VkCommandBuffer& cmd) {
+			return DrawCull(cmd, firstPhase);
+		}).Read(instanceResource, BufferUsage::ComputeRead).Write(drawCommandResource, BufferUsage::ComputeWrite).Write(drawCountResource, BufferUsage::ComputeReadWrite);
+		//the early pass doesn't test against the pyramid, but the shader still declares it
+		if (twoPhaseCulling) {
+			cullPass.Read(visibilityResource, BufferUsage::ComputeRead).Read(depthPyramidTarget, ImageUsage::ShaderRead);
+		}
 	}
 
-	// transition the draw image and the swapchain image into their correct transfer layouts
-	vk_util::TransitionImage(commandBuffer, drawImage.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
-	vk_util::TransitionImage(commandBuffer, swapchainImages[swapchainImageIndex], VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	//the depth image is cleared so its contents are discarded
+	RenderGraphPass& geometryPass = renderGraph.AddPass("geometry", [&, firstPhase](const VkCommandBuffer& cmd) {
+		return DrawGeometry(cmd, renderGraph.GetImageView(depthTarget), firstPhase);
+	}).Write(drawTarget, ImageUsage::ColourAttachment).Write(depthTarget, ImageUsage::DepthAttachment, true).Read(instanceResource, BufferUsage::VertexShaderRead);
+	if (gpuDriven) {
+		geometryPass.Read(drawCommandResource, BufferUsage::IndirectRead).Read(drawCountResource, BufferUsage::IndirectRead);
+	}
 
-	// execute a copy from the draw image into the swapchain
-	vk_util::CopyImageToImage(commandBuffer, drawImage.image, swapchainImages[swapchainImageIndex], drawExtent, swapchainExtent, renderScaleFilter);
+	// build the depth pyramid from the early draws, test the rest against it and draw what turned out to be visible
+	if (twoPhaseCulling) {
+		renderGraph.AddPass("depth pyramid", [&](const VkCommandBuffer& cmd) {
+			return DrawDepthPyramid(cmd, renderGraph.GetImageView(depthTarget));
+		}).Read(depthTarget, ImageUsage::ShaderRead).Write(depthPyramidTarget, ImageUsage::ComputeWrite, true);
 
-	// set swapchain image layout to Attachment Optimal so we can draw into it from imgui
-	vk_util::TransitionImage(commandBuffer, swapchainImages[swapchainImageIndex], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL);
+		renderGraph.AddPass("late cull", [&](const VkCommandBuffer& cmd) {
+			return DrawCull(cmd, CullPhase::Late);
+		}).Read(instanceResource, BufferUsage::ComputeRead).Read(depthPyramidTarget, ImageUsage::ShaderRead).Write(visibilityResource, BufferUsage::ComputeReadWrite)
+		  .Write(drawCommandResource, BufferUsage::ComputeWrite).Write(drawCountResource, BufferUsage::ComputeReadWrite);
 
-	// draw imgui into the swapchain image
-	ImGui::Render();
-	DrawImGui(commandBuffer, swapchainImageViews[swapchainImageIndex]);
+		renderGraph.AddPass("late geometry", [&](const VkCommandBuffer& cmd) {
+			return DrawGeometry(cmd, renderGraph.GetImageView(depthTarget), CullPhase::Late);
+		}).Write(drawTarget, ImageUsage::ColourAttachment).Write(depthTarget, ImageUsage::DepthAttachment).Read(instanceResource, BufferUsage::VertexShaderRead)
+		  .Read(drawCommandResource, BufferUsage::IndirectRead).Read(drawCountResource, BufferUsage::IndirectRead);
+	}
+
+	switch (renderSettings.compositionMode) {
+		case CompositionMode::Compute:
+			// upscale, sharpen, tonemap and convert to the swapchain format in one dispatch
+			renderGraph.AddPass("upscale", [&](const VkCommandBuffer& cmd) {
+				return DrawUpscale(cmd, swapchainImageViews[swapchainImageIndex]);
+			}).Read(drawTarget, ImageUsage::ComputeRead).Write(swapchainTarget, ImageUsage::ComputeWrite, true);
+			break;
+		case CompositionMode::Raster:
+			// render the draw image and imgui straight into the swapchain in one render pass
+			renderGraph.AddPass("composite", [&](const VkCommandBuffer& cmd) {
+				return DrawComposite(cmd, swapchainImageViews[swapchainImageIndex]);
+			}).Read(drawTarget, ImageUsage::ShaderRead).Write(swapchainTarget, ImageUsage::ColourAttachment, true);
+			break;
+		case CompositionMode::Blit:
+		default:
+			// execute a copy from the draw image into the swapchain
+			renderGraph.AddPass("blit", [&](const VkCommandBuffer& cmd) {
+				vk_util::CopyImageToImage(cmd, drawImage.image, swapchainImages[swapchainImageIndex], drawExtent, swapchainExtent, renderSettings.renderScaleFilter);
+				return SDL_APP_CONTINUE;
+			}).Read(drawTarget, ImageUsage::TransferSrc).Write(swapchainTarget, ImageUsage::TransferDst, true);
+			break;
+	}
 
-	// set swapchain image layout to Present so we can show it on the screen
-	vk_util::TransitionImage(commandBuffer, swapchainImages[swapchainImageIndex], VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+	// draw imgui into the swapchain image, raster composition already did
+	if (renderSettings.compositionMode != CompositionMode::Raster) {
+		renderGraph.AddPass("imgui", [&](const VkCommandBuffer& cmd) {
+			TraceScope scope(tracer, "Record ImGui");
+			DrawImGui(cmd, swapchainImageViews[swapchainImageIndex]);
+			return SDL_APP_CONTINUE;
+		}).Write(swapchainTarget, ImageUsage::ColourAttachment);
+	}
+
+	if (const SDL_AppResult res = renderGraph.Compile(); res != SDL_APP_CONTINUE) {
+		return res;
+	}
+	if (const SDL_AppResult res = renderGraph.Execute(commandBuffer, &gpuProfiler); res != SDL_APP_CONTINUE) {
+		return res;
+	}
+
+	if (GetCurrentFrame().timestampQueryPool != nullptr) {
+		vkCmdWriteTimestamp2(commandBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, GetCurrentFrame().timestampQueryPool, 1);
+		GetCurrentFrame().timestampsWritten = true;
+	}
 
 	//finalize the command buffer (we can no longer add commands, but it can now be executed)
 	VK_CHECK(vkEndCommandBuffer(commandBuffer), "Couldn't end command buffer");
+	const uint64_t recordEnd = SDL_GetTicksNS();
+	tracer.RecordCpu("Record Commands", recordStart, recordEnd);
 
 	const VkCommandBufferSubmitInfo commandBufferSubmitInfo = vk_init::CommandBufferSubmitInfo(commandBuffer);
 
 	const VkSemaphoreSubmitInfo waitInfo = vk_init::SemaphoreSubmitInfo(VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, GetCurrentFrame().swapchainSemaphore);
-	const VkSemaphoreSubmitInfo signalInfo = vk_init::SemaphoreSubmitInfo(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, readyForPresentSemaphores[swapchainImageIndex]);
+	//the timeline value only ever increases, even when a frame is resubmitted with the same frame number after a failed present
+	GetCurrentFrame().timelineValue = ++frameTimelineValue;
+	const std::array signalInfos = {
+		vk_init::SemaphoreSubmitInfo(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT, readyForPresentSemaphores[swapchainImageIndex]),
+		vk_init::SemaphoreSubmitInfo(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, frameTimeline, GetCurrentFrame().timelineValue),
+	};
 
-	const VkSubmitInfo2 submit = vk_init::SubmitInfo(&commandBufferSubmitInfo, &signalInfo, &waitInfo);
-	VK_CHECK(vkQueueSubmit2(graphicsQueue, 1, &submit, GetCurrentFrame().renderFence), "Couldn't submit command buffer");
+	const VkSubmitInfo2 submit = vk_init::SubmitInfo(&commandBufferSubmitInfo, signalInfos, std::span(&waitInfo, 1));
+	VK_CHECK(vkQueueSubmit2(graphicsQueue, 1, &submit, nullptr), "Couldn't submit command buffer");
+	const uint64_t submitEnd = SDL_GetTicksNS();
+	tracer.RecordCpu("Submit", recordEnd, submitEnd);
+
+	packet.results.rendered = true;
+	packet.results.geometryRecordTime = geometryRecordTime;
+	packet.results.recordingChunkCount = recordingChunkCount;
+	packet.results.drawImageExtent = VkExtent2D{drawImage.imageExtent.width, drawImage.imageExtent.height};
+	frameCounters.descriptorSetsAllocated += GetCurrentFrame().frameDescriptors.GetAllocatedSetCount();
+	packet.results.counters = frameCounters.Take();
 
 	const VkPresentInfoKHR presentInfo{
 		.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
@@ -1362,16 +3417,24 @@ SDL_AppResult VulkanEngine::Draw() {
 		.pImageIndices = &swapchainImageIndex,
 	};
 
-	if (const VkResult presentResult = vkQueuePresentKHR(graphicsQueue, &presentInfo);
-		presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR) {
-		resizeRequested = true;
-		return SDL_APP_CONTINUE;
+	const VkResult presentResult = vkQueuePresentKHR(graphicsQueue, &presentInfo);
+	tracer.RecordCpu("Present", submitEnd, SDL_GetTicksNS());
+	//the frame was submitted either way, so it still moves on to the next frame's resources below
+	if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR) {
+		swapchainOutOfDate = true;
 	} else if (presentResult != VK_SUCCESS) {
 		SDL_Log("Detected Vulkan error: %s: %s", "Couldn't present image", string_VkResult(presentResult));
 		SDL_TriggerBreakpoint();
 		return SDL_APP_FAILURE;
 	}
 
+	vk_util::TakeCallStats(packet.results.vulkanCalls);
+	memoryTracker.ReadHeapBudgets(packet.results.heapBudgets);
+	packet.results.defragmenting = meshDefragmentation != nullptr;
+
+	if (frameNumber == 0) {
+		SDL_Log("First frame presented %.2f ms after init started", static_cast<double>(SDL_GetTicksNS() - initStartTime) / 1'000'000.0);
+	}
 	frameNumber++;
 
 	return SDL_APP_CONTINUE;
@@ -1385,9 +3448,9 @@ SDL_AppResult VulkanEngine::HandleEvent(const SDL_Event* event) {
 			if (event->key.key != SDLK_ESCAPE && event->key.key != SDLK_Q) break;
 			return SDL_APP_SUCCESS; // end the program, reporting success to the OS.
 		case SDL_EVENT_WINDOW_RESIZED:
-			if (const SDL_AppResult res = ResizeSwapchain(); res != SDL_APP_CONTINUE) {
-				return res;
-			}
+		case SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED:
+			//handled once at the start of the next frame
+			resizeRequested = true;
 			break;
 		default:
 			break;
@@ -1399,24 +3462,39 @@ SDL_AppResult VulkanEngine::HandleEvent(const SDL_Event* event) {
 }
 
 void VulkanEngine::Cleanup(const SDL_AppResult result) {
+	StopRenderThread();
+
 	if (result == SDL_APP_SUCCESS) {
 		vkDeviceWaitIdle(device);
 
 		for (FrameData& frame : frames) {
 			vkDestroyCommandPool(device, frame.commandPool, nullptr);
+			for (const VkCommandPool recordingCommandPool : frame.recordingCommandPools) {
+				vkDestroyCommandPool(device, recordingCommandPool, nullptr);
+			}
 
-			vkDestroyFence(device, frame.renderFence, nullptr);
 			vkDestroySemaphore(device, frame.swapchainSemaphore, nullptr);
+			if (frame.timestampQueryPool != nullptr) {
+				vkDestroyQueryPool(device, frame.timestampQueryPool, nullptr);
+			}
 
 			frame.frameDeletionQueue.Flush();
+			frame.renderGraph.Destroy();
 		}
 
-		for (const std::shared_ptr<MeshAsset>& mesh : meshes) {
-			DestroyBuffer(mesh->meshBuffers.indexBuffer);
-			DestroyBuffer(mesh->meshBuffers.vertexBuffer);
-		}
+		vkDestroySemaphore(device, frameTimeline, nullptr);
+
+		//after the wait for idle every retired resource is safe to destroy
+		retiredResources.FlushAll();
+
+		EndMeshDefragmentation();
+		meshPool.Clear([&](const MeshAsset& mesh) {
+			DestroyBuffer(mesh.meshBuffers.indexBuffer);
+			DestroyBuffer(mesh.meshBuffers.vertexBuffer);
+		});
+		meshes.clear();
 
-		mainDeletionQueue.Flush();
+		initGraph.FlushDeleters();
 
 		DestroySwapchain();
 
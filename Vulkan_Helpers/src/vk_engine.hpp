@@ -3,9 +3,26 @@
 #include "mass_includer.hpp"
 
 // Engine
+#include "vk_call_shims.hpp"
+#include "vk_culling.hpp"
 #include "vk_custom_types.hpp"
 #include "vk_descriptors.hpp"
+#include "vk_dynamic_resolution.hpp"
+#include "vk_frame_counters.hpp"
+#include "vk_frame_pacing.hpp"
+#include "vk_gpu_profiler.hpp"
+#include "vk_images.hpp"
+#include "vk_imgui_snapshot.hpp"
+#include "vk_init_graph.hpp"
+#include "vk_job_benchmark.hpp"
 #include "vk_loader.hpp"
+#include "vk_memory.hpp"
+#include "vk_packet_ring.hpp"
+#include "vk_render_graph.hpp"
+#include "vk_resource_pool.hpp"
+#include "vk_scene_graph.hpp"
+#include "vk_trace.hpp"
+#include "vk_workgroups.hpp"
 
 class VulkanEngine {
 	const std::string name;
@@ -15,6 +32,7 @@ class VulkanEngine {
 	VkInstance instance = nullptr;
 	VkDebugUtilsMessengerEXT debugMessenger = nullptr;
 	VkPhysicalDevice physicalDevice = nullptr;
+	VkPhysicalDeviceProperties physicalDeviceProperties = {};
 	VkDevice device = nullptr;
 	VkSurfaceKHR surface = nullptr;
 
@@ -22,42 +40,92 @@ class VulkanEngine {
 	VkFormat swapchainImageFormat = VK_FORMAT_UNDEFINED;
 	std::vector<VkImage> swapchainImages;
 	std::vector<VkImageView> swapchainImageViews;
+	std::vector<ImageState> swapchainImageStates;
 	std::vector<VkSemaphore> readyForPresentSemaphores;
 	VkExtent2D swapchainExtent = {};
+	std::vector<VkPresentModeKHR> supportedPresentModes;
 
 	static constexpr uint64_t secondInNanoseconds = 1'000'000'000;
 
 	struct FrameData {
 		VkCommandPool commandPool = nullptr;
 		VkCommandBuffer mainCommandBuffer = nullptr;
+		// a pool and a secondary command buffer per job pool thread, so draws can be recorded in parallel
+		std::vector<VkCommandPool> recordingCommandPools;
+		std::vector<VkCommandBuffer> recordingCommandBuffers;
 
 		VkSemaphore swapchainSemaphore = nullptr;
-		VkFence renderFence = nullptr;
+		// value of frameTimeline once the GPU is done with this frame
+		uint64_t timelineValue = 0;
+
+		// start and end of the frame on the GPU, to measure how long the GPU idles between frames
+		VkQueryPool timestampQueryPool = nullptr;
+		bool timestampsWritten = false;
 
 		DeletionQueue frameDeletionQueue;
 		DescriptorAllocatorGrowable frameDescriptors;
 
 		AllocatedImage screenImage = {};
+
+		// per-instance data of the instanced draw, rewritten every frame, so every frame in flight has its own
+		AllocatedBuffer instanceDataBuffer = {};
+
+		RenderGraph renderGraph;
 	};
 
 	unsigned int frameNumber = 0;
-	std::array<FrameData, 2> frames = {};
+	// when Init started, the time to the first presented frame is measured from here
+	uint64_t initStartTime = 0;
+	// sized once at startup to the number of frames in flight, never resized after
+	std::vector<FrameData> frames;
 	FrameData& GetCurrentFrame() { return frames[frameNumber % frames.size()]; }
+	VkSemaphore frameTimeline = nullptr;
+	uint64_t frameTimelineValue = 0;
 	VkQueue graphicsQueue = nullptr;
 	uint32_t graphicsQueueFamilyIndex = 0;
+	uint32_t graphicsQueueTimestampValidBits = 0;
 
-	DeletionQueue mainDeletionQueue;
+	// the startup stages, each holds the deleters of what it created until shutdown
+	InitGraph initGraph;
+	// swapchains and images replaced while older frames may still use them
+	TimelineDeletionQueue retiredResources;
 
 	VmaAllocator vmaAllocator = nullptr;
+	bool memoryBudgetSupported = false;
+	// tags every allocation with its category, allocations are made by const functions and on both threads
+	mutable MemoryTracker memoryTracker;
 
 	//Draw Resources
 	AllocatedImage drawImage = {};
-	AllocatedImage depthImage = {};
+	// the most compact format the device supports for everything the draw image is used for, picked by SelectDrawImageFormat
+	VkFormat drawImageFormat = VK_FORMAT_UNDEFINED;
+	bool storageImageExtendedFormats = false;
+	ImagePool drawImagePool;
+	VkFormat depthImageFormat = VK_FORMAT_D32_SFLOAT;
 	VkExtent2D drawExtent = {};
-	float renderScale = 1.0f;
-	VkFilter renderScaleFilter = VK_FILTER_LINEAR;
+	DynamicResolutionController dynamicResolution;
 
 	bool resizeRequested = false;
+	bool defragmentationRequested = false;
+
+	FramePacingConfig framePacing;
+	FrameLimiter frameLimiter;
+	FramePacingStats framePacingStats;
+	uint64_t lastGpuFrameEnd = 0;
+
+	// times the render graph passes, on the render thread
+	GpuProfiler gpuProfiler;
+	// the timings of finished frames, on the simulation thread
+	GpuTimingStats gpuTimingStats;
+	bool calibratedTimestampsSupported = false;
+	bool pipelineStatisticsSupported = false;
+	// lets pipeline statistics queries stay active while secondary command buffers execute
+	bool inheritedQueriesSupported = false;
+	// added to by const functions and the recording jobs, taken at the end of every frame
+	mutable FrameCounterTally frameCounters;
+	// CPU and GPU scopes of every thread, started from the simulation thread
+	Tracer tracer;
+	int traceFrameCount = 10;
 
 	DescriptorAllocator globalDescriptorAllocator = {};
 
@@ -67,10 +135,167 @@ class VulkanEngine {
 	VkPipeline meshPipeline = nullptr;
 	VkPipelineLayout meshPipelineLayout = nullptr;
 
-	std::vector<std::shared_ptr<MeshAsset>> meshes;
+	//Compute Upscaling
+	struct UpscalePushConstants {
+		math::float2 inputSize;
+		math::float2 outputSize;
+		float sharpness;
+		uint32_t tonemapOperator;
+	};
+
+	VkPipeline upscalePipeline = nullptr;
+	VkPipelineLayout upscalePipelineLayout = nullptr;
+	VkDescriptorSetLayout upscaleDescriptorLayout = nullptr;
+	static constexpr WorkgroupSize upscaleWorkgroupSize = {8, 8};
+	bool storageImageWriteWithoutFormat = false;
+	// queried once, surface capabilities don't change when the swapchain is recreated
+	bool swapchainSupportsStorage = false;
+
+	//Composition of the draw image into the swapchain
+	enum class CompositionMode {
+		Blit, // transfer blit, then imgui in its own render pass
+		Compute, // compute upscaler writes the swapchain as a storage image
+		Raster, // fullscreen triangle, with imgui drawn in the same render pass
+	};
+
+	struct CompositePushConstants {
+		math::float2 uvScale;
+		uint32_t tonemapOperator;
+	};
+
+	VkPipeline compositePipeline = nullptr;
+	VkPipelineLayout compositePipelineLayout = nullptr;
+
+	ResourcePool<MeshAsset> meshPool;
+	// the vertex and index buffers share one usage, so any of them fits any block of the mesh memory pool
+	static constexpr VkBufferUsageFlags meshBufferUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+	// the mesh buffers only, the one memory that is defragmented, as only the mesh assets refer to what lives in it
+	VmaPool meshMemoryPool = nullptr;
+	// whether the mesh memory pool is in host visible device local memory, so meshes, and the instance buffer on the same
+	// terms, are written without a copy
+	bool directMeshUploads = false;
+	// moves mesh buffers a few at a time across frames, on the render thread
+	VmaDefragmentationContext meshDefragmentation = nullptr;
+	// a pass whose copies are done, it is ended once no frame reads the old buffers anymore
+	struct MeshDefragmentationPass {
+		VmaDefragmentationPassMoveInfo moveInfo;
+		std::vector<VkBuffer> oldBuffers;
+		uint64_t timelineValue;
+	};
+	std::optional<MeshDefragmentationPass> pendingDefragmentationPass;
+	static constexpr VkDeviceSize defragmentationBytesPerPass = 16 * 1024 * 1024;
+	static constexpr uint32_t defragmentationMovesPerPass = 64;
+	uint64_t meshDefragmentationEndFrame = 0;
+	static constexpr uint64_t autoDefragmentationInterval = 600;
+	// in the order of the imported file, which is what scene graph mesh indices refer to
+	std::vector<Handle<MeshAsset>> meshes;
+	// what the simulation thread needs of each mesh, copied at load time, since the render thread moves and frees the
+	// entries of meshPool while it defragments and collects
+	struct MeshInfo {
+		std::filesystem::path texturePath;
+		math::float4 boundingSphere;
+		uint32_t firstIndex;
+		uint32_t indexCount;
+	};
+	std::vector<MeshInfo> meshInfos;
 	static constexpr int selectedMeshIndex = 0;
 
+	//GPU-Driven Drawing
+	enum class CullPhase : uint32_t {
+		Frustum, // a single pass, only frustum culled
+		Early, // instances that were visible last frame
+		Late, // the other instances, occlusion tested against the depth of the early draws
+	};
+
+	struct CullPushConstants {
+		math::float4x4 viewProjection;
+		VkDeviceAddress instanceBufferAddress;
+		VkDeviceAddress drawCommandBufferAddress;
+		VkDeviceAddress drawCountBufferAddress;
+		VkDeviceAddress visibilityBufferAddress;
+		uint32_t instanceCount;
+		uint32_t frustumCulling;
+		CullPhase phase;
+		uint32_t depthPyramidLevels;
+		math::float2 depthPyramidSize;
+	};
+
+	// node hierarchy of the imported file, a mesh is placed by the world matrix of the first node that draws it
+	SceneGraph sceneGraph;
+	std::vector<SceneGraphBenchmarkResult> sceneGraphBenchmarkResults;
+
+	// a grid of instances of the selected mesh, all sharing its vertex and index buffers,
+	// built on the simulation thread and copied to the render thread in the packet of the frame it changed in
+	std::vector<GPUInstance> instances;
+	std::vector<GPUInstance> renderInstances;
+	AllocatedBuffer instanceBuffer = {};
+	// two lists with room for one command per instance, the early or only one first and the late one after it,
+	// the cull passes compact the visible instances to the front of a list and count them
+	AllocatedBuffer drawCommandBuffer = {};
+	AllocatedBuffer drawCountBuffer = {};
+	// per instance, whether it passed the occlusion test last frame
+	AllocatedBuffer visibilityBuffer = {};
+	int instanceGridSize = 16;
+	// distance from the origin to the furthest instance bounds
+	float instanceGridRadius = 0.0f;
+	bool instancesChanged = false;
+
+	enum class InstanceDrawMode {
+		GpuDriven, // culled and compacted into indirect draws by a compute pass
+		PerInstance, // culled on the CPU, one draw call per instance
+		Instanced, // culled on the CPU and streamed into a per-frame buffer, one instanced draw call for all of them
+	};
+
+	// reads GPUInstanceData instead of GPUInstance, and tints the texture with the instance colour
+	VkPipeline instancedMeshPipeline = nullptr;
+	// instances written to the current frame's instance data buffer
+	uint32_t streamedInstanceCount = 0;
+
+	VkPipeline cullPipeline = nullptr;
+	VkPipelineLayout cullPipelineLayout = nullptr;
+	static constexpr WorkgroupSize cullWorkgroupSize = {64, 1};
+	bool drawIndirectCountSupported = false;
+
+	//Occlusion Culling
+	struct DepthPyramidPushConstants {
+		math::float2 sourceSize;
+		math::float2 destinationSize;
+		uint32_t sourceIsDepth;
+	};
+
+	// min and max depth in r and g, every level covering the one above with half the resolution, down to 1x1.
+	// Lives in imagePool, so a resize releases the old one once the frames culling against it are done
+	Handle<AllocatedImage> depthPyramid = {};
+	std::vector<VkImageView> depthPyramidLevelViews;
+	static constexpr VkFormat depthPyramidFormat = VK_FORMAT_R32G32_SFLOAT;
+	VkPipeline depthPyramidPipeline = nullptr;
+	VkPipelineLayout depthPyramidPipelineLayout = nullptr;
+	VkDescriptorSetLayout depthPyramidDescriptorLayout = nullptr;
+	static constexpr WorkgroupSize depthPyramidWorkgroupSize = {8, 8};
+	VkPipeline occlusionCullPipeline = nullptr;
+	VkPipelineLayout occlusionCullPipelineLayout = nullptr;
+	VkDescriptorSetLayout occlusionCullDescriptorLayout = nullptr;
+
+	//CPU Culling
+	// culls the instances for the per-instance and instanced draws, the GPU-driven path culls them itself
+	JobPool jobPool;
+	BvhCuller cpuCuller;
+	bool cpuCulling = true;
+	double cpuCullTime = 0.0;
+	size_t visibleInstanceCount = 0;
+	std::vector<CullingBenchmarkResult> cullingBenchmarkResults;
+	std::vector<JobBenchmarkResult> jobBenchmarkResults;
+
+	//Parallel Recording
+	// splits the per-instance draws over the job pool, each thread records a secondary command buffer
+	// fewer draws than this per thread cost more to hand out than they save
+	static constexpr uint32_t minDrawsPerRecordingChunk = 512;
+	uint32_t recordingChunkCount = 0;
+	double geometryRecordTime = 0.0;
+
 	//Immediate Submit
+	// init stages on different threads upload at the same time, but there is only the one command buffer and the queue
+	mutable std::mutex immediateSubmitMutex;
 	VkFence immediateSubmitFence = nullptr;
 	VkCommandBuffer immediateSubmitCommandBuffer = nullptr;
 	VkCommandPool immediateSubmitCommandPool = nullptr;
@@ -88,12 +313,18 @@ class VulkanEngine {
 		VkPipeline pipeline{};
 		VkPipelineLayout layout{};
 		VkDescriptorSet descriptorSet{};
+		VkDescriptorSetLayout descriptorLayout{};
 		bool hasPushConstants = true;
 		ComputePushConstants data;
+		WorkgroupSize workgroupSize;
 	};
 
+	// only the simulation thread touches data after startup, the packets carry a copy of the selected one
 	std::vector<ComputeEffect> backgroundEffects;
-	int currentBackgroundEffectIndex = 0;
+
+	WorkgroupSizeCache workgroupSizeCache;
+	// where caches and exported measurements are written
+	std::filesystem::path userDataDirectory;
 
 	float cameraRadius = 10.0f;
 	float cameraHeight = 3.0f;
@@ -112,66 +343,217 @@ class VulkanEngine {
 	GPUSceneData sceneData;
 	VkDescriptorSetLayout gpuSceneDataDescriptorLayout = nullptr;
 
-	AllocatedImage whiteImage = {};
-	AllocatedImage blackImage = {};
-	AllocatedImage greyImage = {};
-	AllocatedImage errorCheckerboardImage = {};
-	AllocatedImage imageTexture = {};
-	int selectedTextureIndex = 3;
-	std::array<AllocatedImage*, 5> images = {&whiteImage, &blackImage, &greyImage, &errorCheckerboardImage, &imageTexture};
+	ResourcePool<AllocatedImage> imagePool;
+	Handle<AllocatedImage> whiteImage = {};
+	Handle<AllocatedImage> blackImage = {};
+	Handle<AllocatedImage> greyImage = {};
+	Handle<AllocatedImage> errorCheckerboardImage = {};
+	Handle<AllocatedImage> imageTexture = {};
+	std::array<Handle<AllocatedImage>, 5> images = {};
 
-	VkSampler defaultSamplerLinear = nullptr;
-	VkSampler defaultSamplerNearest = nullptr;
+	ResourcePool<VkSampler> samplerPool;
+	Handle<VkSampler> defaultSamplerLinear = {};
+	Handle<VkSampler> defaultSamplerNearest = {};
 
 	VkDescriptorSetLayout singleImageDescriptorLayout = nullptr;
 
 	VkDescriptorSet screenImageDescriptors = nullptr;
 	VkDescriptorSetLayout screenImageDescriptorLayout = nullptr;
 
+	//Simulation and Render Threads
+	// everything the UI can change about how a frame is drawn
+	struct RenderSettings {
+		float renderScale = 1.0f;
+		VkFilter renderScaleFilter = VK_FILTER_LINEAR;
+		// the swapchain only gets the usage flags the current mode needs, so changing it recreates the swapchain
+		CompositionMode compositionMode = CompositionMode::Compute;
+		float upscaleSharpness = 0.5f;
+		int tonemapOperator = 0;
+		int currentBackgroundEffectIndex = 0;
+		int selectedTextureIndex = 3;
+		InstanceDrawMode instanceDrawMode = InstanceDrawMode::GpuDriven;
+		bool frustumCulling = true;
+		bool occlusionCulling = true;
+		bool parallelRecording = true;
+		// defragments the mesh memory whenever its free space adds up to a whole block
+		bool autoDefragmentation = true;
+		// copied from framePacing and the selected background effect when a packet is published
+		VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+		ComputePushConstants backgroundEffectData = {};
+	};
+
+	// measured by the render thread while drawing a packet, read by the simulation thread when it reuses the slot
+	struct FrameResults {
+		bool rendered = false;
+		uint64_t cpuWaitTime = 0;
+		// from the first timed render graph pass to the last when they are timed, so vsync waits don't count as GPU cost
+		double gpuFrameTime = 0.0;
+		std::optional<uint64_t> gpuIdleTime;
+		double geometryRecordTime = 0.0;
+		uint32_t recordingChunkCount = 0;
+		VkExtent2D drawImageExtent = {};
+		std::vector<GpuScopeTiming> gpuScopeTimings;
+		FrameCounters counters;
+		// only filled in builds with VK_CALL_SHIMS
+		std::vector<VulkanCallStats> vulkanCalls;
+		std::vector<HeapBudget> heapBudgets;
+		bool defragmenting = false;
+	};
+
+	// everything the render thread needs to draw a frame, the render thread only writes its results
+	struct FramePacket {
+		bool stop = false;
+		VkExtent2D windowExtent = {};
+		bool resizeRequested = false;
+		bool defragmentationRequested = false;
+		RenderSettings settings;
+		GPUSceneData sceneData;
+		// only filled in the frame the instance grid changed
+		bool instancesRebuilt = false;
+		std::vector<GPUInstance> rebuiltInstances;
+		// culled instances for the per-instance draws, and their animated data for the instanced draw
+		std::vector<uint32_t> visibleInstances;
+		std::vector<GPUInstanceData> instanceData;
+		ImGuiSnapshot ui;
+		FrameResults results;
+	};
+
+	// the simulation thread fills one packet while the render thread draws the other, so it runs one frame ahead
+	static constexpr size_t framePacketCount = 2;
+	PacketRing<FramePacket> framePackets{framePacketCount};
+	std::jthread renderThread;
+	// the first failure on the render thread, the simulation thread returns it from its next frame
+	std::atomic<SDL_AppResult> renderResult = SDL_APP_CONTINUE;
+	FrameResults lastFrameResults;
+
+	// owned by the simulation thread, and by the render thread once a packet hands them over
+	RenderSettings settings;
+	RenderSettings renderSettings;
+	// the packet being drawn, only set on the render thread while it draws
+	FramePacket* renderPacket = nullptr;
+	// set when acquire or present report the swapchain is out of date, on the render thread
+	bool swapchainOutOfDate = false;
+
 private:
 	[[nodiscard]] SDL_AppResult InitVulkan();
+	/// Picks the draw image format, keeping the requested one if the device supports it.
+	void SelectDrawImageFormat();
+	/// @return Path of the compiled variant of a compute shader that accesses a draw image of the given format.
+	[[nodiscard]] std::filesystem::path DrawImageShaderPath(std::string_view shaderName, VkFormat format) const;
 	[[nodiscard]] SDL_AppResult InitCommands();
 	[[nodiscard]] SDL_AppResult InitSyncStructures();
 
 private:
-	[[nodiscard]] SDL_AppResult CreateSwapchain(uint32_t width, uint32_t height);
+	[[nodiscard]] SDL_AppResult CreateSwapchain(uint32_t width, uint32_t height, const VkSwapchainKHR& oldSwapchain = nullptr);
 	[[nodiscard]] SDL_AppResult InitSwapchain();
 	void DestroySwapchain() const;
-	[[nodiscard]] SDL_AppResult ResizeSwapchain();
+	/// Recreates the swapchain for the given window size, a minimized window leaves it out of date.
+	[[nodiscard]] SDL_AppResult ResizeSwapchain(VkExtent2D windowExtent);
+	/// Makes sure the draw image covers the given extent, reallocating it from a size-bucketed pool when it doesn't.
+	[[nodiscard]] SDL_AppResult ResizeDrawImage(VkExtent2D extent);
+	/// Matches the depth pyramid to the draw image, at the largest power of two size that fits in it.
+	[[nodiscard]] SDL_AppResult ResizeDepthPyramid();
 
 private:
 	[[nodiscard]] SDL_AppResult InitDescriptors();
 
 private:
-	[[nodiscard]] SDL_AppResult InitPipelines();
 	[[nodiscard]] SDL_AppResult InitBackgroundPipelines();
+	/// @param shaderHash Hash of the shader's code, which the cached workgroup size is only valid for.
+	[[nodiscard]] SDL_AppResult CreateBackgroundPipeline(ComputeEffect& effect, const VkShaderModule& shaderModule, uint64_t shaderHash);
+	[[nodiscard]] std::optional<WorkgroupSize> BenchmarkWorkgroupSize(const ComputeEffect& effect, const VkShaderModule& shaderModule);
 	[[nodiscard]] SDL_AppResult InitMeshPipeline();
+	[[nodiscard]] SDL_AppResult InitUpscalePipeline();
+	[[nodiscard]] SDL_AppResult InitCompositePipeline();
+	[[nodiscard]] SDL_AppResult InitCullPipeline();
+	[[nodiscard]] SDL_AppResult InitOcclusionCullPipelines();
+	[[nodiscard]] bool IsCompositionModeAvailable(CompositionMode mode) const;
 
 private:
 	[[nodiscard]] SDL_AppResult InitImgui();
 
 private:
-	[[nodiscard]] SDL_AppResult InitDefaultData();
+	[[nodiscard]] SDL_AppResult InitMeshes(std::vector<ParsedMesh>&& parsedMeshes);
+	/// Creates the default images and samplers, and the texture of the selected mesh from its decoded image.
+	[[nodiscard]] SDL_AppResult InitTextures(const SDL_Surface& imageData);
+	[[nodiscard]] SDL_AppResult InitInstances();
+	/// Recreates the instance grid and the culling hierarchy around it.
+	void BuildInstances();
+	/// Recreates the buffers the GPU-driven draw uses for the given instances, retiring the old buffers once no frame uses them.
+	[[nodiscard]] SDL_AppResult UploadInstances(const std::vector<GPUInstance>& newInstances);
+	/// Fills the packet's visible instances for drawing without the GPU-driven path.
+	void CullInstancesOnCpu(FramePacket& packet);
+	/// Fills the packet's instance data with the animated transform and colour of every visible instance.
+	void WriteInstanceData(FramePacket& packet) const;
+	/// Copies the packet's instance data into the current frame's instance data buffer.
+	[[nodiscard]] SDL_AppResult UploadInstanceData();
+	[[nodiscard]] bool IsInstanceDrawModeAvailable(InstanceDrawMode mode) const;
 
 private:
-	[[nodiscard]] std::optional<AllocatedBuffer> CreateBuffer(size_t allocSize, VkBufferUsageFlags bufferUsage, VmaMemoryUsage memoryUsage) const;
+	// lets VMA pick host visible device local memory, which resizable BAR and unified memory devices have, and device local
+	// memory filled by a transfer otherwise. Buffers that got host visible memory are mapped.
+	static constexpr VmaAllocationCreateFlags directUploadFlags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_ALLOW_TRANSFER_INSTEAD_BIT;
+	// the host visible device local heap of devices without resizable BAR
+	static constexpr VkDeviceSize barWindowSize = 256 * 1024 * 1024;
+	/// @param allocationFlags A VMA_ALLOCATION_CREATE_HOST_ACCESS_* flag for buffers the CPU writes, which keeps them mapped.
+	/// @param pool The pool to allocate from, or nullptr to let VMA pick the memory type.
+	[[nodiscard]] std::optional<AllocatedBuffer> CreateBuffer(size_t allocSize, VkBufferUsageFlags bufferUsage, MemoryCategory category, VmaAllocationCreateFlags allocationFlags = 0, const VmaPool& pool = nullptr) const;
 	void DestroyBuffer(const AllocatedBuffer& buffer) const;
+	[[nodiscard]] VkDeviceAddress GetBufferDeviceAddress(const AllocatedBuffer& buffer) const;
 
 private:
 	[[nodiscard]] SDL_AppResult DrawBackground(const VkCommandBuffer& commandBuffer);
 	void DrawImGui(const VkCommandBuffer& commandBuffer, const VkImageView& targetImageView) const;
-	[[nodiscard]] SDL_AppResult DrawGeometry(const VkCommandBuffer& commandBuffer);
+	void UpdateCamera();
+	[[nodiscard]] SDL_AppResult DrawCull(const VkCommandBuffer& commandBuffer, CullPhase phase);
+	[[nodiscard]] SDL_AppResult DrawGeometry(const VkCommandBuffer& commandBuffer, const VkImageView& depthImageView, CullPhase phase);
+	/// Records the visible per-instance draws into secondary command buffers on the job pool and executes them in order.
+	/// @param bindDrawState Binds everything the draws need, called on every secondary command buffer.
+	[[nodiscard]] SDL_AppResult RecordInstanceDrawsInParallel(const VkCommandBuffer& commandBuffer, const std::function<void(const VkCommandBuffer&)>& bindDrawState);
+	[[nodiscard]] SDL_AppResult DrawDepthPyramid(const VkCommandBuffer& commandBuffer, const VkImageView& depthImageView);
+	[[nodiscard]] SDL_AppResult DrawUpscale(const VkCommandBuffer& commandBuffer, const VkImageView& targetImageView);
+	[[nodiscard]] SDL_AppResult DrawComposite(const VkCommandBuffer& commandBuffer, const VkImageView& targetImageView);
+	void DrawFramePacingUi();
+	void DrawGpuProfilerUi();
+	void DrawTraceUi();
+	void DrawCountersUi();
+	void DrawVulkanCallsUi();
+	void DrawMemoryUi();
+	/// Reads after the profiler, as the GPU frame time is taken from the scope timings in results when there are any.
+	void ReadFrameTimestamps(FrameData& frame, FrameResults& results);
+
+private:
+	/// Feeds what the render thread measured for an earlier packet into the frame pacing stats and the dynamic resolution.
+	void ApplyFrameResults(const FrameResults& results);
+	/// Draws packets until it gets one that says to stop, runs on the render thread.
+	void RenderLoop();
+	/// Records, submits and presents the frame described by the packet.
+	[[nodiscard]] SDL_AppResult Render(FramePacket& packet);
+	/// Hands the render thread a packet that stops it and waits for it to finish.
+	void StopRenderThread();
+	/// Advances the mesh memory defragmentation by at most one pass, on the render thread. A pass moves buffers into
+	/// new memory and copies them right away, its old memory is freed once the frame timeline passes the last frame
+	/// that used it.
+	/// @param start Starts a defragmentation when none is running.
+	[[nodiscard]] SDL_AppResult DefragmentMeshMemory(uint64_t completedTimelineValue, bool start);
+	/// Ends the mesh memory defragmentation. Destroys the old buffers of a pending pass right away, so the GPU has to be
+	/// idle while one is pending.
+	void EndMeshDefragmentation();
+	/// @return Whether the free space in the mesh memory pool adds up to a whole block, which compacting could release.
+	[[nodiscard]] bool IsMeshMemoryFragmented() const;
 
 private:
-	[[nodiscard]] std::optional<AllocatedImage> CreateImage(VkExtent3D size, VkFormat format, VkImageUsageFlags usage, bool mipmapped = false) const;
-	[[nodiscard]] std::optional<AllocatedImage> CreateImage(const void* data, VkExtent3D imageSize, size_t pixelSize, VkFormat format, VkImageUsageFlags usage, bool mipmapped = false, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) const;
+	[[nodiscard]] std::optional<AllocatedImage> CreateImage(VkExtent3D size, VkFormat format, VkImageUsageFlags usage, MemoryCategory category, bool mipmapped = false) const;
+	[[nodiscard]] std::optional<AllocatedImage> CreateImage(const void* data, VkExtent3D imageSize, size_t pixelSize, VkFormat format, VkImageUsageFlags usage, bool mipmapped = false, ImageUsage finalUsage = ImageUsage::ShaderRead) const;
 	void DestroyImage(const AllocatedImage& allocatedImage) const;
 
 private:
 	SDL_AppResult CreateScreenImage(const void* pixels, size_t pixelSize, uint32_t width, uint32_t height);
 
 public:
-	VulkanEngine(std::string name, bool debugMode);
+	/// @param framesInFlight How many frames the CPU may record ahead of the GPU, clamped to [1, 4].
+	/// @param drawImageFormat Format to render into, VK_FORMAT_UNDEFINED picks the most compact one the device supports.
+	VulkanEngine(std::string name, bool debugMode, uint32_t framesInFlight = 2, VkFormat drawImageFormat = VK_FORMAT_UNDEFINED);
 
 	[[nodiscard]] std::filesystem::path GetAssetsDir() const;
 	/// @param imagePath Path to image file, relative from the directory where the application was run from.
@@ -179,8 +561,10 @@ public:
 	[[nodiscard]] SDL_Surface* LoadImage(const std::filesystem::path& imagePath, int desiredChannels) const;
 	[[nodiscard]] std::optional<GPUMeshBuffers> UploadMesh(std::span<Uint16> indices, std::span<MyVertex> vertices) const;
 
+	/// Runs the init stages as a graph on the job pool, so the ones that don't depend on each other overlap, and logs their timeline.
 	[[nodiscard]] SDL_AppResult Init(int width, int height);
-	[[nodiscard]] SDL_AppResult Draw();
+	/// Runs the UI, camera and culling for the next frame on the calling thread and hands it to the render thread.
+	[[nodiscard]] SDL_AppResult Simulate();
 	[[nodiscard]] SDL_AppResult HandleEvent(const SDL_Event* event);
 	void Cleanup(SDL_AppResult result);
 
@@ -0,0 +1,131 @@
+// Impl
+#include "vk_frame_counters.hpp"
+
+FrameCounters FrameCounterTally::Take() {
+	return FrameCounters{
+		.drawCalls = drawCalls.exchange(0, std::memory_order_relaxed),
+		.pipelineBinds = pipelineBinds.exchange(0, std::memory_order_relaxed),
+		.descriptorSetsAllocated = descriptorSetsAllocated.exchange(0, std::memory_order_relaxed),
+		.bytesUploaded = bytesUploaded.exchange(0, std::memory_order_relaxed),
+		.deletionQueueEntriesFlushed = deletionQueueEntriesFlushed.exchange(0, std::memory_order_relaxed),
+		.vmaAllocations = vmaAllocations.exchange(0, std::memory_order_relaxed),
+	};
+}
+
+namespace {
+	constexpr std::array counterNames = {"Draw calls", "Pipeline binds", "Descriptor sets allocated", "Bytes uploaded", "Deletion queue entries flushed", "VMA allocations"};
+	constexpr std::array counterKeys = {"drawCalls", "pipelineBinds", "descriptorSetsAllocated", "bytesUploaded", "deletionQueueEntriesFlushed", "vmaAllocations"};
+
+	std::array<uint64_t, counterNames.size()> CounterValues(const FrameCounters& counters) {
+		return {counters.drawCalls, counters.pipelineBinds, counters.descriptorSetsAllocated, counters.bytesUploaded, counters.deletionQueueEntriesFlushed, counters.vmaAllocations};
+	}
+
+	PipelineStatistics SumStatistics(const std::span<const GpuScopeTiming> timings) {
+		PipelineStatistics sum;
+		for (const GpuScopeTiming& timing : timings) {
+			if (!timing.statistics.has_value()) continue;
+
+			sum.vertexShaderInvocations += timing.statistics->vertexShaderInvocations;
+			sum.clippingPrimitives += timing.statistics->clippingPrimitives;
+			sum.fragmentShaderInvocations += timing.statistics->fragmentShaderInvocations;
+			sum.computeShaderInvocations += timing.statistics->computeShaderInvocations;
+		}
+		return sum;
+	}
+
+	void DrawStatisticsRow(const char* name, const PipelineStatistics& statistics) {
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::TextUnformatted(name);
+		ImGui::TableNextColumn();
+		ImGui::Text("%llu", static_cast<unsigned long long>(statistics.vertexShaderInvocations));
+		ImGui::TableNextColumn();
+		ImGui::Text("%llu", static_cast<unsigned long long>(statistics.clippingPrimitives));
+		ImGui::TableNextColumn();
+		ImGui::Text("%llu", static_cast<unsigned long long>(statistics.fragmentShaderInvocations));
+		ImGui::TableNextColumn();
+		ImGui::Text("%llu", static_cast<unsigned long long>(statistics.computeShaderInvocations));
+	}
+
+	void WriteStatisticsJson(std::ofstream& file, const PipelineStatistics& statistics) {
+		file << "{\"vertexShaderInvocations\":" << statistics.vertexShaderInvocations
+		     << ",\"clippingPrimitives\":" << statistics.clippingPrimitives
+		     << ",\"fragmentShaderInvocations\":" << statistics.fragmentShaderInvocations
+		     << ",\"computeShaderInvocations\":" << statistics.computeShaderInvocations << "}";
+	}
+}
+
+void vk_util::DrawFrameCountersTable(const FrameCounters& counters, const std::span<const GpuScopeTiming> timings) {
+	if (ImGui::BeginTable("Engine Counters", 2, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+		ImGui::TableSetupColumn("Counter");
+		ImGui::TableSetupColumn("Last frame");
+		ImGui::TableHeadersRow();
+
+		const std::array values = CounterValues(counters);
+		for (size_t i = 0; i < counterNames.size(); i++) {
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(counterNames[i]);
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", static_cast<unsigned long long>(values[i]));
+		}
+
+		ImGui::EndTable();
+	}
+
+	//frames that executed secondary command buffers without inherited queries have no statistics
+	if (std::ranges::none_of(timings, [](const GpuScopeTiming& timing) { return timing.statistics.has_value(); })) {
+		ImGui::TextUnformatted("No pipeline statistics for this frame");
+		return;
+	}
+
+	if (!ImGui::BeginTable("Pipeline Statistics", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) return;
+
+	ImGui::TableSetupColumn("Pass");
+	ImGui::TableSetupColumn("VS invocations");
+	ImGui::TableSetupColumn("Clipping primitives");
+	ImGui::TableSetupColumn("FS invocations");
+	ImGui::TableSetupColumn("CS invocations");
+	ImGui::TableHeadersRow();
+
+	for (const GpuScopeTiming& timing : timings) {
+		if (timing.statistics.has_value()) {
+			DrawStatisticsRow(timing.name, timing.statistics.value());
+		}
+	}
+	DrawStatisticsRow("Frame", SumStatistics(timings));
+
+	ImGui::EndTable();
+}
+
+bool vk_util::ExportFrameCountersJson(const std::filesystem::path& path, const FrameCounters& counters, const std::span<const GpuScopeTiming> timings) {
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open()) {
+		SDL_Log("Couldn't write frame counters: %s", path.string().c_str());
+		return false;
+	}
+
+	file << "{\n\"counters\":{";
+	const std::array values = CounterValues(counters);
+	for (size_t i = 0; i < counterKeys.size(); i++) {
+		file << (i == 0 ? "" : ",") << "\"" << counterKeys[i] << "\":" << values[i];
+	}
+	file << "},\n\"passes\":[";
+
+	bool firstPass = true;
+	for (const GpuScopeTiming& timing : timings) {
+		file << (firstPass ? "\n" : ",\n") << "{\"name\":\"" << timing.name << "\",\"milliseconds\":" << timing.milliseconds;
+		if (timing.statistics.has_value()) {
+			file << ",\"statistics\":";
+			WriteStatisticsJson(file, timing.statistics.value());
+		}
+		file << "}";
+		firstPass = false;
+	}
+	file << "\n],\n\"frameStatistics\":";
+	WriteStatisticsJson(file, SumStatistics(timings));
+	file << "\n}\n";
+
+	SDL_Log("Wrote frame counters to %s", path.string().c_str());
+	return true;
+}
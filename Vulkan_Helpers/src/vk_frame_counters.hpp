@@ -0,0 +1,39 @@
+#pragma once
+
+#include "mass_includer.hpp"
+
+// Engine
+#include "vk_gpu_profiler.hpp"
+
+/// Work the engine did for one frame, so the effect of culling and batching can be checked by counts.
+struct FrameCounters {
+	// API calls, an indirect draw counts once however many draws the GPU makes of it
+	uint64_t drawCalls = 0;
+	uint64_t pipelineBinds = 0;
+	uint64_t descriptorSetsAllocated = 0;
+	// copied into mapped memory, for staging as well as for buffers the GPU reads directly
+	uint64_t bytesUploaded = 0;
+	uint64_t deletionQueueEntriesFlushed = 0;
+	// buffers and images created through VMA
+	uint64_t vmaAllocations = 0;
+};
+
+/// Counters that the job pool threads recording in parallel can add to, taken once a frame by the render thread.
+struct FrameCounterTally {
+	std::atomic<uint64_t> drawCalls = 0;
+	std::atomic<uint64_t> pipelineBinds = 0;
+	std::atomic<uint64_t> descriptorSetsAllocated = 0;
+	std::atomic<uint64_t> bytesUploaded = 0;
+	std::atomic<uint64_t> deletionQueueEntriesFlushed = 0;
+	std::atomic<uint64_t> vmaAllocations = 0;
+
+	/// @return Everything counted since the last call, the tally starts over at 0.
+	[[nodiscard]] FrameCounters Take();
+};
+
+namespace vk_util {
+	/// Draws the engine counters, then the pipeline statistics of every scope and their sum over the frame.
+	void DrawFrameCountersTable(const FrameCounters& counters, std::span<const GpuScopeTiming> timings);
+	/// Writes the same values as DrawFrameCountersTable as JSON.
+	bool ExportFrameCountersJson(const std::filesystem::path& path, const FrameCounters& counters, std::span<const GpuScopeTiming> timings);
+}
@@ -0,0 +1,132 @@
+// Impl
+#include "vk_frame_pacing.hpp"
+
+const char* vk_util::PresentModeName(const VkPresentModeKHR presentMode) {
+	switch (presentMode) {
+		case VK_PRESENT_MODE_FIFO_KHR:
+			return "FIFO";
+		case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+			return "FIFO Relaxed";
+		case VK_PRESENT_MODE_MAILBOX_KHR:
+			return "Mailbox";
+		case VK_PRESENT_MODE_IMMEDIATE_KHR:
+			return "Immediate";
+		default:
+			return "Unknown";
+	}
+}
+
+uint64_t FrameLimiter::Wait(const uint32_t frameLimit) {
+	const uint64_t now = SDL_GetTicksNS();
+	if (frameLimit == 0) {
+		nextFrameStart = now;
+		return 0;
+	}
+
+	const uint64_t framePeriod = SDL_NS_PER_SECOND / frameLimit;
+
+	//when a frame ran over its budget the schedule restarts from now, instead of rushing the next frames to catch up
+	if (nextFrameStart <= now) {
+		nextFrameStart = now + framePeriod;
+		return 0;
+	}
+
+	const uint64_t waitTime = nextFrameStart - now;
+	SDL_DelayPrecise(waitTime);
+	nextFrameStart += framePeriod;
+	return waitTime;
+}
+
+void FramePacingStats::BeginFrame(const FramePacingConfig& config) {
+	const uint64_t now = SDL_GetTicksNS();
+	const uint64_t frameTime = lastFrameStart == 0 ? 0 : now - lastFrameStart;
+	lastFrameStart = now;
+
+	if (results.empty() || results[currentResult].config != config) {
+		const auto it = std::ranges::find_if(results, [&](const ConfigResult& result) { return result.config == config; });
+		if (it == results.end()) {
+			results.push_back(ConfigResult{.config = config});
+			currentResult = results.size() - 1;
+		} else {
+			currentResult = static_cast<size_t>(it - results.begin());
+		}
+		warmupFramesLeft = config.framesInFlight + 8;
+		return;
+	}
+
+	if (warmupFramesLeft > 0) {
+		warmupFramesLeft--;
+		return;
+	}
+
+	ConfigResult& result = results[currentResult];
+	result.frameCount++;
+	result.frameTimeSum += static_cast<double>(frameTime);
+}
+
+void FramePacingStats::RecordCpuWait(const uint64_t cpuWaitNanoseconds, const uint64_t limiterWaitNanoseconds) {
+	if (results.empty() || warmupFramesLeft > 0) return;
+
+	ConfigResult& result = results[currentResult];
+	result.cpuWaitSum += static_cast<double>(cpuWaitNanoseconds);
+	result.limiterWaitSum += static_cast<double>(limiterWaitNanoseconds);
+}
+
+void FramePacingStats::RecordGpuIdle(const uint64_t gpuIdleNanoseconds) {
+	if (results.empty() || warmupFramesLeft > 0) return;
+
+	ConfigResult& result = results[currentResult];
+	result.gpuIdleCount++;
+	result.gpuIdleSum += static_cast<double>(gpuIdleNanoseconds);
+}
+
+void FramePacingStats::DrawImGuiTable() const {
+	constexpr double nanosecondsToMilliseconds = 1.0 / 1'000'000.0;
+
+	if (!ImGui::BeginTable("Frame Pacing Results", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) return;
+
+	ImGui::TableSetupColumn("Frames");
+	ImGui::TableSetupColumn("Present Mode");
+	ImGui::TableSetupColumn("Limit");
+	ImGui::TableSetupColumn("Frame ms");
+	ImGui::TableSetupColumn("CPU Wait ms");
+	ImGui::TableSetupColumn("Limiter ms");
+	ImGui::TableSetupColumn("GPU Idle ms");
+	ImGui::TableHeadersRow();
+
+	for (size_t i = 0; i < results.size(); i++) {
+		const ConfigResult& result = results[i];
+		const double frameCount = static_cast<double>(std::max<uint64_t>(result.frameCount, 1));
+		const double gpuIdleCount = static_cast<double>(std::max<uint64_t>(result.gpuIdleCount, 1));
+
+		ImGui::TableNextRow();
+		if (i == currentResult) {
+			ImGui::TableSetBgColor(ImGuiTableBgTarget_RowBg0, ImGui::GetColorU32(ImGuiCol_TableHeaderBg));
+		}
+
+		ImGui::TableNextColumn();
+		ImGui::Text("%u", result.config.framesInFlight);
+		ImGui::TableNextColumn();
+		ImGui::TextUnformatted(vk_util::PresentModeName(result.config.presentMode));
+		ImGui::TableNextColumn();
+		if (result.config.frameLimit == 0) {
+			ImGui::TextUnformatted("Off");
+		} else {
+			ImGui::Text("%u", result.config.frameLimit);
+		}
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", result.frameTimeSum / frameCount * nanosecondsToMilliseconds);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", result.cpuWaitSum / frameCount * nanosecondsToMilliseconds);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", result.limiterWaitSum / frameCount * nanosecondsToMilliseconds);
+		ImGui::TableNextColumn();
+		if (result.gpuIdleCount == 0) {
+			ImGui::TextUnformatted("-");
+		} else {
+			ImGui::Text("%.3f", result.gpuIdleSum / gpuIdleCount * nanosecondsToMilliseconds);
+		}
+	}
+
+	ImGui::EndTable();
+}
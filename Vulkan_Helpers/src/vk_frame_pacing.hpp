@@ -0,0 +1,66 @@
+#pragma once
+
+#include "mass_includer.hpp"
+
+struct FramePacingConfig {
+	uint32_t framesInFlight = 2;
+	VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+	/// Frames per second, 0 means unlimited.
+	uint32_t frameLimit = 0;
+
+	bool operator==(const FramePacingConfig& other) const = default;
+};
+
+namespace vk_util {
+	inline constexpr uint32_t minFramesInFlight = 1;
+	inline constexpr uint32_t maxFramesInFlight = 4;
+
+	/// Present modes that can be switched between at runtime.
+	inline constexpr std::array selectablePresentModes = {
+		VK_PRESENT_MODE_FIFO_KHR,
+		VK_PRESENT_MODE_MAILBOX_KHR,
+		VK_PRESENT_MODE_IMMEDIATE_KHR,
+	};
+
+	[[nodiscard]] const char* PresentModeName(VkPresentModeKHR presentMode);
+}
+
+/// Delays the start of a frame so frames start at most frameLimit times per second.
+/// Starting later means input is sampled closer to when the frame is shown, at the cost of throughput.
+class FrameLimiter {
+	uint64_t nextFrameStart = 0;
+
+public:
+	/// @return Nanoseconds spent waiting.
+	uint64_t Wait(uint32_t frameLimit);
+};
+
+/// Averages CPU wait time, GPU idle time and frame time separately for every frame pacing configuration that was used.
+class FramePacingStats {
+	struct ConfigResult {
+		FramePacingConfig config;
+		uint64_t frameCount = 0;
+		double frameTimeSum = 0.0;
+		double cpuWaitSum = 0.0;
+		double limiterWaitSum = 0.0;
+		uint64_t gpuIdleCount = 0;
+		double gpuIdleSum = 0.0;
+	};
+
+	std::vector<ConfigResult> results;
+	size_t currentResult = 0;
+	// the first frames after switching include the swapchain rebuild and a drained queue, so they're skipped
+	uint32_t warmupFramesLeft = 0;
+	uint64_t lastFrameStart = 0;
+
+public:
+	/// Starts a frame with the given configuration.
+	void BeginFrame(const FramePacingConfig& config);
+	/// @param cpuWaitNanoseconds Time blocked on the GPU and on image acquisition.
+	/// @param limiterWaitNanoseconds Time deliberately spent waiting by the frame limiter.
+	void RecordCpuWait(uint64_t cpuWaitNanoseconds, uint64_t limiterWaitNanoseconds);
+	/// @param gpuIdleNanoseconds Time between the GPU finishing a frame and starting the next one.
+	void RecordGpuIdle(uint64_t gpuIdleNanoseconds);
+
+	void DrawImGuiTable() const;
+};
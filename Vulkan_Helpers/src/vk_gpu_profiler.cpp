@@ -0,0 +1,304 @@
+// Impl
+#include "vk_gpu_profiler.hpp"
+
+// Engine
+#include "vk_macros.hpp"
+
+SDL_AppResult GpuProfiler::Init(const VkDevice& device, const VkPhysicalDevice& physicalDevice, const uint32_t frameCount, const VkPhysicalDeviceLimits& limits,
+                                const uint32_t timestampValidBits, const bool calibratedTimestampsEnabled, const bool pipelineStatisticsEnabled) {
+	this->device = device;
+	if (timestampValidBits == 0) {
+		SDL_Log("Graphics queue doesn't support timestamps, the GPU profiler is disabled");
+		return SDL_APP_CONTINUE;
+	}
+
+	timestampPeriod = limits.timestampPeriod;
+	this->timestampValidBits = timestampValidBits;
+	timestampMask = timestampValidBits >= 64 ? ~0ull : (1ull << timestampValidBits) - 1;
+	timestamps.resize(maxScopesPerFrame * 2);
+
+	//the CPU side is bracketed with SDL_GetTicksNS, so only the device domain has to be calibrateable
+	if (calibratedTimestampsEnabled) {
+		uint32_t timeDomainCount = 0;
+		VK_CHECK(vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(physicalDevice, &timeDomainCount, nullptr), "Couldn't get calibrateable time domains");
+		std::vector<VkTimeDomainEXT> timeDomains(timeDomainCount);
+		VK_CHECK(vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(physicalDevice, &timeDomainCount, timeDomains.data()), "Couldn't get calibrateable time domains");
+		calibratedTimestamps = std::ranges::contains(timeDomains, VK_TIME_DOMAIN_DEVICE_EXT);
+	}
+	if (calibratedTimestamps) {
+		Calibrate();
+	} else {
+		SDL_Log("Calibrated timestamps aren't supported, GPU scopes in traces are lined up with the recording of their frame");
+	}
+
+	const VkQueryPoolCreateInfo queryPoolCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.queryType = VK_QUERY_TYPE_TIMESTAMP,
+		.queryCount = maxScopesPerFrame * 2,
+	};
+	const VkQueryPoolCreateInfo statisticsQueryPoolCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+		.queryCount = maxScopesPerFrame,
+		.pipelineStatistics = pipelineStatisticFlags,
+	};
+	pipelineStatisticsSupported = pipelineStatisticsEnabled;
+	if (pipelineStatisticsSupported) {
+		statistics.resize(maxScopesPerFrame * 5);
+	}
+
+	frames.resize(frameCount);
+	for (FrameQueries& frame : frames) {
+		frame.scopeNames.reserve(maxScopesPerFrame);
+		VK_CHECK(vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &frame.queryPool), "Couldn't create profiler query pool");
+		if (pipelineStatisticsSupported) {
+			VK_CHECK(vkCreateQueryPool(device, &statisticsQueryPoolCreateInfo, nullptr, &frame.statisticsQueryPool), "Couldn't create pipeline statistics query pool");
+		}
+	}
+
+	return SDL_APP_CONTINUE;
+}
+
+void GpuProfiler::Destroy() {
+	for (const FrameQueries& frame : frames) {
+		if (frame.queryPool != nullptr) {
+			vkDestroyQueryPool(device, frame.queryPool, nullptr);
+		}
+		if (frame.statisticsQueryPool != nullptr) {
+			vkDestroyQueryPool(device, frame.statisticsQueryPool, nullptr);
+		}
+	}
+	frames.clear();
+}
+
+void GpuProfiler::Calibrate() {
+	const VkCalibratedTimestampInfoEXT timestampInfo{
+		.sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT,
+		.timeDomain = VK_TIME_DOMAIN_DEVICE_EXT,
+	};
+
+	//the device timestamp is taken somewhere between the two CPU times, the middle is off by half the call at most
+	uint64_t ticks = 0;
+	uint64_t maxDeviation = 0;
+	const uint64_t before = SDL_GetTicksNS();
+	if (vkGetCalibratedTimestampsEXT(device, 1, &timestampInfo, &ticks, &maxDeviation) != VK_SUCCESS) return;
+	const uint64_t after = SDL_GetTicksNS();
+
+	calibrationTicks = ticks;
+	calibrationTime = before + (after - before) / 2;
+}
+
+uint64_t GpuProfiler::ToCpuTime(const uint64_t ticks, const uint64_t referenceTicks, const uint64_t referenceTime) const {
+	//the difference wraps around at the valid bits, the top valid bit is its sign since the timestamp can be before the reference
+	int64_t difference = static_cast<int64_t>((ticks - referenceTicks) & timestampMask);
+	if (timestampValidBits < 64 && (difference & (1ll << (timestampValidBits - 1))) != 0) {
+		difference -= static_cast<int64_t>(timestampMask) + 1;
+	}
+
+	const int64_t nanoseconds = static_cast<int64_t>(static_cast<double>(difference) * timestampPeriod);
+	return static_cast<uint64_t>(static_cast<int64_t>(referenceTime) + nanoseconds);
+}
+
+void GpuProfiler::ReadResults(const uint32_t frameIndex, std::vector<GpuScopeTiming>& timings) {
+	if (!IsEnabled()) return;
+
+	FrameQueries& frame = frames[frameIndex];
+	const uint32_t queryCount = static_cast<uint32_t>(frame.scopeNames.size()) * 2;
+	if (queryCount == 0) return;
+
+	//without the wait flag a frame that was never submitted reports not ready instead of blocking
+	if (vkGetQueryPoolResults(device, frame.queryPool, 0, queryCount, queryCount * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+		frame.scopeNames.clear();
+		return;
+	}
+
+	if (calibratedTimestamps && SDL_GetTicksNS() - calibrationTime > calibrationInterval) {
+		Calibrate();
+	}
+	//with the availability of every query, a scope that didn't finish its query is skipped instead of failing the rest
+	constexpr uint32_t statisticsStride = 5;
+	bool statisticsRead = false;
+	if (frame.pipelineStatistics) {
+		const uint32_t scopeCount = queryCount / 2;
+		const VkResult result = vkGetQueryPoolResults(device, frame.statisticsQueryPool, 0, scopeCount, scopeCount * statisticsStride * sizeof(uint64_t), statistics.data(),
+		                                              statisticsStride * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+		statisticsRead = result == VK_SUCCESS || result == VK_NOT_READY;
+	}
+
+	const uint64_t referenceTicks = calibratedTimestamps ? calibrationTicks : timestamps[0];
+	const uint64_t referenceTime = calibratedTimestamps ? calibrationTime : frame.beginFrameTime;
+
+	for (size_t i = 0; i < frame.scopeNames.size(); i++) {
+		const uint64_t ticks = (timestamps[i * 2 + 1] - timestamps[i * 2]) & timestampMask;
+		const uint64_t startTime = ToCpuTime(timestamps[i * 2], referenceTicks, referenceTime);
+		timings.push_back(GpuScopeTiming{
+			.name = frame.scopeNames[i],
+			.milliseconds = static_cast<double>(ticks) * timestampPeriod / 1'000'000.0,
+			.startTime = startTime,
+			.endTime = startTime + static_cast<uint64_t>(static_cast<double>(ticks) * timestampPeriod),
+		});
+
+		const uint64_t* scopeStatistics = statistics.data() + i * statisticsStride;
+		if (statisticsRead && scopeStatistics[4] != 0) {
+			timings.back().statistics = PipelineStatistics{
+				.vertexShaderInvocations = scopeStatistics[0],
+				.clippingPrimitives = scopeStatistics[1],
+				.fragmentShaderInvocations = scopeStatistics[2],
+				.computeShaderInvocations = scopeStatistics[3],
+			};
+		}
+	}
+	frame.scopeNames.clear();
+}
+
+void GpuProfiler::BeginFrame(const VkCommandBuffer& commandBuffer, const uint32_t frameIndex, const bool pipelineStatistics) {
+	if (!IsEnabled()) return;
+
+	currentFrame = frameIndex;
+	FrameQueries& frame = frames[currentFrame];
+	frame.scopeNames.clear();
+	frame.beginFrameTime = SDL_GetTicksNS();
+	frame.pipelineStatistics = pipelineStatistics && pipelineStatisticsSupported;
+	vkCmdResetQueryPool(commandBuffer, frame.queryPool, 0, maxScopesPerFrame * 2);
+	if (frame.pipelineStatistics) {
+		vkCmdResetQueryPool(commandBuffer, frame.statisticsQueryPool, 0, maxScopesPerFrame);
+	}
+}
+
+std::optional<uint32_t> GpuProfiler::BeginScope(const VkCommandBuffer& commandBuffer, const char* name) {
+	if (!IsEnabled()) return std::nullopt;
+
+	FrameQueries& frame = frames[currentFrame];
+	if (frame.scopeNames.size() == maxScopesPerFrame) return std::nullopt;
+
+	//all commands, so the scope starts once the work before it has finished instead of overlapping with it
+	const uint32_t scope = static_cast<uint32_t>(frame.scopeNames.size());
+	frame.scopeNames.push_back(name);
+	vkCmdWriteTimestamp2(commandBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, frame.queryPool, scope * 2);
+	//scopes don't nest, so only one statistics query is active at a time as the spec requires
+	if (frame.pipelineStatistics) {
+		vkCmdBeginQuery(commandBuffer, frame.statisticsQueryPool, scope, 0);
+	}
+	return scope;
+}
+
+void GpuProfiler::EndScope(const VkCommandBuffer& commandBuffer, const std::optional<uint32_t> scope) {
+	if (!scope.has_value()) return;
+
+	const FrameQueries& frame = frames[currentFrame];
+	if (frame.pipelineStatistics) {
+		vkCmdEndQuery(commandBuffer, frame.statisticsQueryPool, scope.value());
+	}
+	vkCmdWriteTimestamp2(commandBuffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, frame.queryPool, scope.value() * 2 + 1);
+}
+
+size_t GpuTimingStats::FindOrAddScope(const char* name) {
+	for (size_t i = 0; i < scopes.size(); i++) {
+		if (scopes[i].name == name) return i;
+	}
+	scopes.push_back(ScopeStats{.name = name});
+	scopes.back().samples.reserve(rollingSampleCount);
+	return scopes.size() - 1;
+}
+
+void GpuTimingStats::Record(const std::span<const GpuScopeTiming> timings) {
+	if (timings.empty()) return;
+
+	FrameRecord record{.frame = recordedFrames++};
+	for (const GpuScopeTiming& timing : timings) {
+		const size_t scope = FindOrAddScope(timing.name);
+		if (record.milliseconds.size() <= scope) {
+			record.milliseconds.resize(scope + 1, -1.0);
+		}
+		record.milliseconds[scope] = std::max(record.milliseconds[scope], 0.0) + timing.milliseconds;
+	}
+
+	for (size_t i = 0; i < record.milliseconds.size(); i++) {
+		if (record.milliseconds[i] < 0.0) continue;
+
+		ScopeStats& stats = scopes[i];
+		if (stats.samples.size() < rollingSampleCount) {
+			stats.samples.push_back(record.milliseconds[i]);
+		} else {
+			stats.samples[stats.nextSample] = record.milliseconds[i];
+		}
+		stats.nextSample = (stats.nextSample + 1) % rollingSampleCount;
+		stats.lastMilliseconds = record.milliseconds[i];
+	}
+
+	history.push_back(std::move(record));
+	if (history.size() > maxHistoryFrames) {
+		history.pop_front();
+	}
+}
+
+void GpuTimingStats::Clear() {
+	scopes.clear();
+	history.clear();
+	recordedFrames = 0;
+}
+
+void GpuTimingStats::DrawImGuiTable() const {
+	if (!ImGui::BeginTable("GPU Timings", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) return;
+
+	ImGui::TableSetupColumn("Scope");
+	ImGui::TableSetupColumn("Last ms");
+	ImGui::TableSetupColumn("Min ms");
+	ImGui::TableSetupColumn("Avg ms");
+	ImGui::TableSetupColumn("P99 ms");
+	ImGui::TableHeadersRow();
+
+	std::vector<double> sorted;
+	for (const ScopeStats& stats : scopes) {
+		if (stats.samples.empty()) continue;
+
+		sorted.assign(stats.samples.begin(), stats.samples.end());
+		std::ranges::sort(sorted);
+		const double average = std::accumulate(sorted.begin(), sorted.end(), 0.0) / static_cast<double>(sorted.size());
+		//the sample that 99% of the samples are at or below
+		const size_t p99Index = (sorted.size() * 99 + 99) / 100 - 1;
+
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::TextUnformatted(stats.name.c_str());
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", stats.lastMilliseconds);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", sorted.front());
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", average);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", sorted[p99Index]);
+	}
+
+	ImGui::EndTable();
+}
+
+bool GpuTimingStats::ExportCsv(const std::filesystem::path& path) const {
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open()) {
+		SDL_Log("Couldn't write GPU timings: %s", path.string().c_str());
+		return false;
+	}
+
+	file << "frame";
+	for (const ScopeStats& stats : scopes) {
+		file << "," << stats.name;
+	}
+	file << "\n";
+
+	//scopes a frame didn't have are left empty
+	for (const FrameRecord& record : history) {
+		file << record.frame;
+		for (size_t i = 0; i < scopes.size(); i++) {
+			file << ",";
+			if (i < record.milliseconds.size() && record.milliseconds[i] >= 0.0) {
+				file << record.milliseconds[i];
+			}
+		}
+		file << "\n";
+	}
+
+	SDL_Log("Wrote %zu frames of GPU timings to %s", history.size(), path.string().c_str());
+	return true;
+}
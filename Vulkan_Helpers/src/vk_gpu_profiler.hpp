@@ -0,0 +1,131 @@
+#pragma once
+
+#include "mass_includer.hpp"
+
+/// What the shader stages did within one scope, from a pipeline statistics query.
+struct PipelineStatistics {
+	uint64_t vertexShaderInvocations = 0;
+	uint64_t clippingPrimitives = 0;
+	uint64_t fragmentShaderInvocations = 0;
+	uint64_t computeShaderInvocations = 0;
+};
+
+/// GPU time of one scope in a finished frame.
+struct GpuScopeTiming {
+	// a string literal, so it stays valid while the timing is handed between threads
+	const char* name;
+	double milliseconds;
+	// SDL_GetTicksNS clock, so the scope lines up with CPU scopes in traces
+	uint64_t startTime;
+	uint64_t endTime;
+	// only for frames that collected pipeline statistics
+	std::optional<PipelineStatistics> statistics;
+};
+
+/// Times named scopes on the GPU with timestamp queries.
+/// Every frame in flight has its own query pool, which is only read once the GPU is done with that frame,
+/// so reading the results never waits for the GPU.
+/// GPU ticks are converted to the CPU clock with VK_EXT_calibrated_timestamps when the device supports it, otherwise
+/// the first timestamp of a frame is lined up with the time the frame began recording, which places it too early.
+class GpuProfiler {
+	struct FrameQueries {
+		VkQueryPool queryPool = nullptr;
+		// scope i counts into query i, only while pipelineStatistics is set
+		VkQueryPool statisticsQueryPool = nullptr;
+		bool pipelineStatistics = false;
+		// scope i writes queries 2i and 2i + 1
+		std::vector<const char*> scopeNames;
+		// when BeginFrame was recorded, the reference point without calibrated timestamps
+		uint64_t beginFrameTime = 0;
+	};
+
+	VkDevice device = nullptr;
+	std::vector<FrameQueries> frames;
+	uint32_t currentFrame = 0;
+	// nanoseconds per tick
+	double timestampPeriod = 0.0;
+	uint32_t timestampValidBits = 0;
+	uint64_t timestampMask = 0;
+	std::vector<uint64_t> timestamps;
+	bool pipelineStatisticsSupported = false;
+	// the four statistics and the availability of every query
+	std::vector<uint64_t> statistics;
+
+	bool calibratedTimestamps = false;
+	// a device timestamp and the CPU time it was taken at
+	uint64_t calibrationTicks = 0;
+	uint64_t calibrationTime = 0;
+
+	/// Samples the device clock and the CPU clock together, the clocks drift apart so this is repeated every so often.
+	void Calibrate();
+	/// Converts a device timestamp to the CPU clock relative to a timestamp taken at a known CPU time.
+	[[nodiscard]] uint64_t ToCpuTime(uint64_t ticks, uint64_t referenceTicks, uint64_t referenceTime) const;
+
+public:
+	static constexpr uint32_t maxScopesPerFrame = 32;
+	static constexpr uint64_t calibrationInterval = 1'000'000'000;
+	// results are written in the order of the bits, which is the order of PipelineStatistics
+	static constexpr VkQueryPipelineStatisticFlags pipelineStatisticFlags = VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+	                                                                      VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+	                                                                      VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+	                                                                      VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+	/// @param timestampValidBits Of the queue the scopes are recorded on, without timestamps the profiler stays disabled.
+	/// @param calibratedTimestampsEnabled Whether VK_EXT_calibrated_timestamps was enabled on the device.
+	/// @param pipelineStatisticsEnabled Whether the pipelineStatisticsQuery feature was enabled on the device.
+	[[nodiscard]] SDL_AppResult Init(const VkDevice& device, const VkPhysicalDevice& physicalDevice, uint32_t frameCount, const VkPhysicalDeviceLimits& limits,
+	                                 uint32_t timestampValidBits, bool calibratedTimestampsEnabled, bool pipelineStatisticsEnabled);
+	void Destroy();
+
+	[[nodiscard]] bool IsEnabled() const { return !frames.empty(); }
+	[[nodiscard]] bool SupportsPipelineStatistics() const { return pipelineStatisticsSupported; }
+	/// Whether the scopes of the frame being recorded collect pipeline statistics.
+	[[nodiscard]] bool IsCollectingPipelineStatistics() const { return IsEnabled() && frames[currentFrame].pipelineStatistics; }
+
+	/// Adds the scopes the frame recorded the last time it was used to timings. The GPU must be done with that frame.
+	void ReadResults(uint32_t frameIndex, std::vector<GpuScopeTiming>& timings);
+	/// Resets the frame's queries, the scopes recorded until the next BeginFrame belong to this frame.
+	/// @param pipelineStatistics Whether the scopes collect pipeline statistics as well. Secondary command buffers can only
+	/// be executed within them when the device supports inherited queries.
+	void BeginFrame(const VkCommandBuffer& commandBuffer, uint32_t frameIndex, bool pipelineStatistics);
+
+	/// @return The scope to pass to EndScope, nothing once the frame has no queries left.
+	[[nodiscard]] std::optional<uint32_t> BeginScope(const VkCommandBuffer& commandBuffer, const char* name);
+	void EndScope(const VkCommandBuffer& commandBuffer, std::optional<uint32_t> scope);
+};
+
+/// Rolling min, average and 99th percentile of the scope timings, plus a per-frame history for exporting.
+/// Kept apart from GpuProfiler, so the timings can be shown on another thread than the one recording them.
+class GpuTimingStats {
+	struct ScopeStats {
+		std::string name;
+		// the latest samples, the oldest is overwritten first
+		std::vector<double> samples;
+		size_t nextSample = 0;
+		double lastMilliseconds = 0.0;
+	};
+
+	struct FrameRecord {
+		uint64_t frame;
+		// by scope index, negative for scopes the frame didn't have
+		std::vector<double> milliseconds;
+	};
+
+	std::vector<ScopeStats> scopes;
+	std::deque<FrameRecord> history;
+	uint64_t recordedFrames = 0;
+
+	[[nodiscard]] size_t FindOrAddScope(const char* name);
+
+public:
+	static constexpr size_t rollingSampleCount = 256;
+	static constexpr size_t maxHistoryFrames = 10'000;
+
+	/// Adds the timings of one frame. Scopes with the same name in a frame are added together.
+	void Record(std::span<const GpuScopeTiming> timings);
+	void Clear();
+
+	void DrawImGuiTable() const;
+	/// Writes a row per recorded frame and a column per scope, in milliseconds.
+	bool ExportCsv(const std::filesystem::path& path) const;
+};
@@ -11,30 +11,189 @@ VkImageSubresourceRange vk_util::ImageSubresourceRange(const VkImageAspectFlags
 	};
 }
 
-void vk_util::TransitionImage(const VkCommandBuffer& commandBuffer, const VkImage& image, const VkImageLayout currentLayout, const VkImageLayout newLayout) {
-	const VkImageAspectFlags aspectMask = newLayout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL
-		                                      ? VK_IMAGE_ASPECT_DEPTH_BIT
-		                                      : VK_IMAGE_ASPECT_COLOR_BIT;
+VkImageAspectFlags vk_util::AspectMaskForFormat(const VkFormat format) {
+	switch (format) {
+		case VK_FORMAT_D16_UNORM:
+		case VK_FORMAT_D32_SFLOAT:
+		case VK_FORMAT_X8_D24_UNORM_PACK32:
+			return VK_IMAGE_ASPECT_DEPTH_BIT;
+		case VK_FORMAT_D16_UNORM_S8_UINT:
+		case VK_FORMAT_D24_UNORM_S8_UINT:
+		case VK_FORMAT_D32_SFLOAT_S8_UINT:
+			return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+		default:
+			return VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+}
+
+ImageState vk_util::StateForUsage(const ImageUsage usage) {
+	switch (usage) {
+		case ImageUsage::ComputeRead:
+			return ImageState{VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT};
+		case ImageUsage::ComputeWrite:
+			return ImageState{VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT};
+		case ImageUsage::ComputeReadWrite:
+			return ImageState{VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT};
+		case ImageUsage::ColourAttachment:
+			return ImageState{VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT};
+		case ImageUsage::DepthAttachment:
+			return ImageState{VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT};
+		case ImageUsage::TransferSrc:
+			return ImageState{VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT};
+		case ImageUsage::TransferDst:
+			return ImageState{VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT};
+		case ImageUsage::ShaderRead:
+			return ImageState{VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT};
+		case ImageUsage::Present:
+			//the semaphore signalled after the submit makes the image available to the presentation engine
+			return ImageState{VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE};
+		case ImageUsage::Undefined:
+		default:
+			return ImageState{};
+	}
+}
+
+BufferState vk_util::StateForUsage(const BufferUsage usage) {
+	switch (usage) {
+		case BufferUsage::IndirectRead:
+			return BufferState{VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT};
+		case BufferUsage::IndexRead:
+			return BufferState{VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_INDEX_READ_BIT};
+		case BufferUsage::VertexShaderRead:
+			//buffer device address loads count as storage reads
+			return BufferState{VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT};
+		case BufferUsage::UniformRead:
+			return BufferState{VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_UNIFORM_READ_BIT};
+		case BufferUsage::ComputeRead:
+			return BufferState{VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT};
+		case BufferUsage::ComputeWrite:
+			return BufferState{VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT};
+		case BufferUsage::ComputeReadWrite:
+			return BufferState{VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT};
+		case BufferUsage::TransferSrc:
+			return BufferState{VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT};
+		case BufferUsage::TransferDst:
+			return BufferState{VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT};
+		case BufferUsage::Undefined:
+		default:
+			return BufferState{};
+	}
+}
+
+namespace {
+	constexpr VkAccessFlags2 writeAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT
+		| VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT
+		| VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT
+		| VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+		| VK_ACCESS_2_TRANSFER_WRITE_BIT
+		| VK_ACCESS_2_HOST_WRITE_BIT
+		| VK_ACCESS_2_MEMORY_WRITE_BIT;
+}
+
+void BarrierBuilder::Transition(const VkImage& image, ImageState& state, const ImageUsage nextUsage, const VkImageAspectFlags aspectMask, const bool discardContents) {
+	const ImageState next = vk_util::StateForUsage(nextUsage);
+
+	const bool previousWrites = (state.accessMask & writeAccessMask) != 0;
+	const bool nextWrites = (next.accessMask & writeAccessMask) != 0;
+
+	//a read after a read in the same layout needs no barrier, but a later write has to wait for both reads
+	if (state.layout == next.layout && !previousWrites && !nextWrites && state.stageMask != VK_PIPELINE_STAGE_2_NONE) {
+		state.stageMask |= next.stageMask;
+		state.accessMask |= next.accessMask;
+		return;
+	}
+
+	//the image was already queued for a transition in this batch, so only its destination has to change
+	for (VkImageMemoryBarrier2& queued : imageBarriers) {
+		if (queued.image != image) continue;
+
+		queued.newLayout = next.layout;
+		queued.dstStageMask = next.stageMask;
+		queued.dstAccessMask = next.accessMask;
+		state = next;
+		return;
+	}
 
-	VkImageMemoryBarrier2 imageBarrier{
+	//discarding only matters when the layout changes, otherwise keeping it is cheaper
+	const VkImageLayout oldLayout = discardContents && state.layout != next.layout ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout;
+
+	imageBarriers.push_back(VkImageMemoryBarrier2{
 		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-		.srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
-		.srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT,
-		.dstStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
-		.dstAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT | VK_ACCESS_2_MEMORY_READ_BIT,
-		.oldLayout = currentLayout,
-		.newLayout = newLayout,
+		.srcStageMask = state.stageMask,
+		//only writes have to be made available, earlier reads just need the execution dependency
+		.srcAccessMask = state.accessMask & writeAccessMask,
+		.dstStageMask = next.stageMask,
+		.dstAccessMask = next.accessMask,
+		.oldLayout = oldLayout,
+		.newLayout = next.layout,
 		.image = image,
-		.subresourceRange = ImageSubresourceRange(aspectMask),
-	};
+		.subresourceRange = vk_util::ImageSubresourceRange(aspectMask),
+	});
+
+	state = next;
+}
+
+void BarrierBuilder::Transition(AllocatedImage& image, const ImageUsage nextUsage, const bool discardContents) {
+	Transition(image.image, image.state, nextUsage, vk_util::AspectMaskForFormat(image.imageFormat), discardContents);
+}
+
+void BarrierBuilder::Transition(const VkBuffer& buffer, BufferState& state, const BufferUsage nextUsage) {
+	const BufferState next = vk_util::StateForUsage(nextUsage);
+
+	const bool previousWrites = (state.accessMask & writeAccessMask) != 0;
+	const bool nextWrites = (next.accessMask & writeAccessMask) != 0;
+
+	//reads after reads need no barrier, but a later write has to wait for all of them
+	if (!previousWrites && !nextWrites) {
+		state.stageMask |= next.stageMask;
+		state.accessMask |= next.accessMask;
+		return;
+	}
+
+	for (VkBufferMemoryBarrier2& queued : bufferBarriers) {
+		if (queued.buffer != buffer) continue;
+
+		queued.dstStageMask = next.stageMask;
+		queued.dstAccessMask = next.accessMask;
+		state = next;
+		return;
+	}
+
+	bufferBarriers.push_back(VkBufferMemoryBarrier2{
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+		.srcStageMask = state.stageMask,
+		.srcAccessMask = state.accessMask & writeAccessMask,
+		.dstStageMask = next.stageMask,
+		.dstAccessMask = next.accessMask,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.buffer = buffer,
+		.offset = 0,
+		.size = VK_WHOLE_SIZE,
+	});
 
-	const VkDependencyInfo depInfo{
+	state = next;
+}
+
+void BarrierBuilder::Transition(AllocatedBuffer& buffer, const BufferUsage nextUsage) {
+	Transition(buffer.internalBuffer, buffer.state, nextUsage);
+}
+
+void BarrierBuilder::Flush(const VkCommandBuffer& commandBuffer) {
+	if (imageBarriers.empty() && bufferBarriers.empty()) return;
+
+	const VkDependencyInfo dependencyInfo{
 		.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-		.imageMemoryBarrierCount = 1,
-		.pImageMemoryBarriers = &imageBarrier,
+		.bufferMemoryBarrierCount = static_cast<uint32_t>(bufferBarriers.size()),
+		.pBufferMemoryBarriers = bufferBarriers.data(),
+		.imageMemoryBarrierCount = static_cast<uint32_t>(imageBarriers.size()),
+		.pImageMemoryBarriers = imageBarriers.data(),
 	};
 
-	vkCmdPipelineBarrier2(commandBuffer, &depInfo);
+	vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+
+	imageBarriers.clear();
+	bufferBarriers.clear();
 }
 
 void vk_util::CopyImageToImage(const VkCommandBuffer& commandBuffer, const VkImage& source, const VkImage& destination, const VkExtent2D srcSize, const VkExtent2D dstSize, const VkFilter filter) {
@@ -75,3 +234,71 @@ void vk_util::CopyImageToImage(const VkCommandBuffer& commandBuffer, const VkIma
 
 	vkCmdBlitImage2(commandBuffer, &blitInfo);
 }
+
+bool vk_util::SupportsFormatFeatures(const VkPhysicalDevice& physicalDevice, const VkFormat format, const VkFormatFeatureFlags features) {
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+	return (formatProperties.optimalTilingFeatures & features) == features;
+}
+
+const char* vk_util::StorageFormatQualifier(const VkFormat format) {
+	switch (format) {
+		case VK_FORMAT_R16G16B16A16_SFLOAT:
+			return "rgba16f";
+		case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+			return "r11f_g11f_b10f";
+		case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+			return "rgb10_a2";
+		default:
+			return nullptr;
+	}
+}
+
+uint32_t vk_util::FormatSize(const VkFormat format) {
+	switch (format) {
+		case VK_FORMAT_R16G16B16A16_SFLOAT:
+			return 8;
+		case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+		case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+			return 4;
+		default:
+			return 0;
+	}
+}
+
+VkExtent3D ImagePool::BucketExtent(const VkExtent2D size) {
+	return VkExtent3D{
+		.width = std::max((size.width + bucketSize - 1) / bucketSize, 1u) * bucketSize,
+		.height = std::max((size.height + bucketSize - 1) / bucketSize, 1u) * bucketSize,
+		.depth = 1,
+	};
+}
+
+std::optional<AllocatedImage> ImagePool::Take(const VkExtent3D extent, const VkFormat format) {
+	const auto it = std::ranges::find_if(freeImages, [&](const AllocatedImage& image) {
+		return image.imageFormat == format && image.imageExtent.width == extent.width && image.imageExtent.height == extent.height;
+	});
+	if (it == freeImages.end()) {
+		return std::nullopt;
+	}
+
+	const AllocatedImage image = *it;
+	freeImages.erase(it);
+	return image;
+}
+
+std::optional<AllocatedImage> ImagePool::Return(const AllocatedImage& image) {
+	freeImages.push_back(image);
+	if (freeImages.size() <= capacity) {
+		return std::nullopt;
+	}
+
+	//the oldest image is the least likely to be asked for again
+	const AllocatedImage evicted = freeImages.front();
+	freeImages.erase(freeImages.begin());
+	return evicted;
+}
+
+std::vector<AllocatedImage> ImagePool::Drain() {
+	return std::exchange(freeImages, {});
+}
@@ -2,8 +2,60 @@
 
 #include "mass_includer.hpp"
 
+// Engine
+#include "vk_custom_types.hpp"
+
 namespace vk_util {
 	[[nodiscard]] VkImageSubresourceRange ImageSubresourceRange(VkImageAspectFlags aspectMask);
-	void TransitionImage(const VkCommandBuffer& commandBuffer, const VkImage& image, VkImageLayout currentLayout, VkImageLayout newLayout);
+	[[nodiscard]] VkImageAspectFlags AspectMaskForFormat(VkFormat format);
+	/// The state an image is left in after being used the given way.
+	[[nodiscard]] ImageState StateForUsage(ImageUsage usage);
+	/// The state a buffer is left in after being used the given way.
+	[[nodiscard]] BufferState StateForUsage(BufferUsage usage);
 	void CopyImageToImage(const VkCommandBuffer& commandBuffer, const VkImage& source, const VkImage& destination, VkExtent2D srcSize, VkExtent2D dstSize, VkFilter filter = VK_FILTER_LINEAR);
+
+	/// @return Whether images with optimal tiling in the given format support all the given features.
+	[[nodiscard]] bool SupportsFormatFeatures(const VkPhysicalDevice& physicalDevice, VkFormat format, VkFormatFeatureFlags features);
+	/// GLSL storage image format qualifier of a draw image format, which is also the suffix of the shader variants compiled for it.
+	/// @return nullptr if the format can't be a draw image.
+	[[nodiscard]] const char* StorageFormatQualifier(VkFormat format);
+	/// Bytes per pixel of the formats a draw image can have.
+	[[nodiscard]] uint32_t FormatSize(VkFormat format);
 }
+
+/// Collects image and buffer transitions and records them together in a single vkCmdPipelineBarrier2.
+/// The stage and access masks are derived from the tracked state of each resource and its next use,
+/// and transitions that don't need a barrier (e.g. a read after a read in the same layout) are dropped.
+class BarrierBuilder {
+	std::vector<VkImageMemoryBarrier2> imageBarriers;
+	std::vector<VkBufferMemoryBarrier2> bufferBarriers;
+
+public:
+	/// @param discardContents The image will be fully overwritten, so its current contents don't have to be preserved.
+	void Transition(const VkImage& image, ImageState& state, ImageUsage nextUsage, VkImageAspectFlags aspectMask, bool discardContents = false);
+	void Transition(AllocatedImage& image, ImageUsage nextUsage, bool discardContents = false);
+	void Transition(const VkBuffer& buffer, BufferState& state, BufferUsage nextUsage);
+	void Transition(AllocatedBuffer& buffer, BufferUsage nextUsage);
+
+	/// Records all queued barriers. Does nothing if none are queued.
+	void Flush(const VkCommandBuffer& commandBuffer);
+};
+
+/// Keeps replaced draw-sized images around, so resizing back and forth doesn't reallocate every time.
+/// Sizes are rounded up to buckets, so small resizes keep using the same image.
+class ImagePool {
+	std::vector<AllocatedImage> freeImages;
+	size_t capacity = 2;
+
+public:
+	static constexpr uint32_t bucketSize = 256;
+
+	[[nodiscard]] static VkExtent3D BucketExtent(VkExtent2D size);
+
+	/// @return A free image with exactly the given extent and format, if there is one.
+	[[nodiscard]] std::optional<AllocatedImage> Take(VkExtent3D extent, VkFormat format);
+	/// @return The image evicted to make room, which the caller has to destroy.
+	[[nodiscard]] std::optional<AllocatedImage> Return(const AllocatedImage& image);
+	/// Removes all free images, which the caller has to destroy.
+	[[nodiscard]] std::vector<AllocatedImage> Drain();
+};
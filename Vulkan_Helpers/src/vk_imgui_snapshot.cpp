@@ -0,0 +1,31 @@
+// Impl
+#include "vk_imgui_snapshot.hpp"
+
+ImGuiSnapshot::~ImGuiSnapshot() {
+	Clear();
+}
+
+void ImGuiSnapshot::Clear() {
+	for (ImDrawList* drawList : drawData.CmdLists) {
+		IM_DELETE(drawList);
+	}
+	drawData.Clear();
+}
+
+void ImGuiSnapshot::Capture(const ImDrawData& source) {
+	Clear();
+
+	drawData.Valid = source.Valid;
+	drawData.DisplayPos = source.DisplayPos;
+	drawData.DisplaySize = source.DisplaySize;
+	drawData.FramebufferScale = source.FramebufferScale;
+	//the backend finds its per-viewport buffers through the viewport, which lives as long as the context
+	drawData.OwnerViewport = source.OwnerViewport;
+	for (const ImDrawList* drawList : source.CmdLists) {
+		drawData.AddDrawList(drawList->CloneOutput());
+	}
+#if IMGUI_VERSION_NUM >= 19200
+	//texture updates are done by the thread that owns the context, the snapshot only draws with them
+	drawData.Textures = nullptr;
+#endif
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "mass_includer.hpp"
+
+/// A copy of imgui's draw data that stays valid while imgui builds the next frame, so it can be rendered on another thread.
+/// The draw lists are cloned into it, and freed once it captures the next frame.
+class ImGuiSnapshot {
+	ImDrawData drawData;
+
+	void Clear();
+
+public:
+	ImGuiSnapshot() = default;
+	~ImGuiSnapshot();
+
+	ImGuiSnapshot(const ImGuiSnapshot&) = delete;
+	ImGuiSnapshot& operator=(const ImGuiSnapshot&) = delete;
+
+	/// Replaces the snapshot with a copy of the given draw data, taken after ImGui::Render.
+	void Capture(const ImDrawData& source);
+
+	[[nodiscard]] ImDrawData* GetDrawData() { return &drawData; }
+};
@@ -0,0 +1,145 @@
+// Impl
+#include "vk_init_graph.hpp"
+
+namespace {
+	// the deletion queue of the stage the current thread is running, stages can run inside each other while waiting for jobs
+	thread_local DeletionQueue* runningStageDeletionQueue = nullptr;
+}
+
+InitStage InitGraph::Add(const char* name, std::function<SDL_AppResult()>&& run, const std::initializer_list<InitStage> dependencies, const bool onMainThread) {
+	const uint32_t index = static_cast<uint32_t>(stages.size());
+	Stage& stage = stages.emplace_back();
+	stage.name = name;
+	stage.run = std::move(run);
+	stage.onMainThread = onMainThread;
+
+	for (const InitStage dependency : dependencies) {
+		SDL_assert(dependency.index < index);
+		stages[dependency.index].dependents.push_back(index);
+		stage.dependencyCount++;
+	}
+
+	return InitStage{index};
+}
+
+InitStage InitGraph::AddStage(const char* name, std::function<SDL_AppResult()>&& run, const std::initializer_list<InitStage> dependencies) {
+	return Add(name, std::move(run), dependencies, false);
+}
+
+InitStage InitGraph::AddMainThreadStage(const char* name, std::function<SDL_AppResult()>&& run, const std::initializer_list<InitStage> dependencies) {
+	return Add(name, std::move(run), dependencies, true);
+}
+
+void InitGraph::Execute(Stage& stage) {
+	//a skipped stage still completes, so the stages after it are released and skipped as well
+	if (result.load(std::memory_order_acquire) != SDL_APP_CONTINUE) return;
+
+	DeletionQueue* const outerDeletionQueue = runningStageDeletionQueue;
+	runningStageDeletionQueue = &stage.deletionQueue;
+	stage.startTime = SDL_GetTicksNS();
+	const SDL_AppResult stageResult = stage.run();
+	stage.endTime = SDL_GetTicksNS();
+	runningStageDeletionQueue = outerDeletionQueue;
+	stage.ran = true;
+
+	if (stageResult != SDL_APP_CONTINUE) {
+		SDL_Log("Init stage %s failed", stage.name);
+		SDL_AppResult expected = SDL_APP_CONTINUE;
+		result.compare_exchange_strong(expected, stageResult, std::memory_order_acq_rel);
+	}
+}
+
+void InitGraph::Launch(JobPool& pool, JobCounter& counter, Stage& stage) {
+	pool.Run([this, &pool, &counter, &stage] {
+		Execute(stage);
+		Complete(pool, counter, stage);
+	}, counter);
+}
+
+void InitGraph::Complete(JobPool& pool, JobCounter& counter, const Stage& stage) {
+	for (const uint32_t dependentIndex : stage.dependents) {
+		Stage& dependent = stages[dependentIndex];
+		if (dependent.pendingDependencies.fetch_sub(1, std::memory_order_acq_rel) != 1) continue;
+
+		if (dependent.onMainThread) {
+			dependent.pendingDependencies.notify_all();
+		} else {
+			Launch(pool, counter, dependent);
+		}
+	}
+}
+
+SDL_AppResult InitGraph::Run(JobPool& pool) {
+	runStartTime = SDL_GetTicksNS();
+	result.store(SDL_APP_CONTINUE, std::memory_order_relaxed);
+	for (Stage& stage : stages) {
+		stage.pendingDependencies.store(stage.dependencyCount, std::memory_order_relaxed);
+		stage.ran = false;
+	}
+
+	JobCounter counter;
+	for (Stage& stage : stages) {
+		if (!stage.onMainThread && stage.dependencyCount == 0) {
+			Launch(pool, counter, stage);
+		}
+	}
+
+	//main thread stages only depend on earlier stages, so taking them in order never waits for one that comes later
+	for (Stage& stage : stages) {
+		if (!stage.onMainThread) continue;
+
+		for (uint32_t pending = stage.pendingDependencies.load(std::memory_order_acquire); pending > 0; pending = stage.pendingDependencies.load(std::memory_order_acquire)) {
+			stage.pendingDependencies.wait(pending, std::memory_order_acquire);
+		}
+		Execute(stage);
+		Complete(pool, counter, stage);
+	}
+
+	pool.Wait(counter);
+	runEndTime = SDL_GetTicksNS();
+
+	return result.load(std::memory_order_acquire);
+}
+
+void InitGraph::LogTimeline() const {
+	constexpr double nanosecondsToMilliseconds = 1.0 / 1'000'000.0;
+	constexpr size_t barWidth = 40;
+
+	const uint64_t runTime = std::max<uint64_t>(runEndTime - runStartTime, 1);
+	uint64_t stageTimeSum = 0;
+
+	for (const Stage& stage : stages) {
+		if (!stage.ran) {
+			SDL_Log("Init %-20s skipped", stage.name);
+			continue;
+		}
+
+		const uint64_t start = stage.startTime - runStartTime;
+		const uint64_t end = stage.endTime - runStartTime;
+		stageTimeSum += end - start;
+
+		//a bar over the whole run, so the overlapping stages line up
+		std::string bar(barWidth, ' ');
+		const size_t barStart = std::min<size_t>(start * barWidth / runTime, barWidth - 1);
+		const size_t barEnd = std::clamp<size_t>(end * barWidth / runTime, barStart + 1, barWidth);
+		std::fill(bar.begin() + static_cast<ptrdiff_t>(barStart), bar.begin() + static_cast<ptrdiff_t>(barEnd), '#');
+
+		SDL_Log("Init %-20s |%s| %8.2f -> %8.2f ms (%.2f ms, %s)", stage.name, bar.c_str(),
+		        static_cast<double>(start) * nanosecondsToMilliseconds, static_cast<double>(end) * nanosecondsToMilliseconds,
+		        static_cast<double>(end - start) * nanosecondsToMilliseconds, stage.onMainThread ? "main thread" : "job pool");
+	}
+
+	SDL_Log("Init took %.2f ms, the stages one after another would take %.2f ms",
+	        static_cast<double>(runTime) * nanosecondsToMilliseconds, static_cast<double>(stageTimeSum) * nanosecondsToMilliseconds);
+}
+
+void InitGraph::PushDeleter(std::function<void()>&& function) {
+	SDL_assert(runningStageDeletionQueue != nullptr);
+	runningStageDeletionQueue->PushFunction(std::move(function));
+}
+
+void InitGraph::FlushDeleters() {
+	for (Stage& stage : std::ranges::reverse_view(stages)) {
+		stage.deletionQueue.Flush();
+	}
+}
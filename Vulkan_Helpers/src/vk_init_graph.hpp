@@ -0,0 +1,63 @@
+#pragma once
+
+#include "mass_includer.hpp"
+
+// Engine
+#include "vk_custom_types.hpp"
+#include "vk_job_pool.hpp"
+
+struct InitStage {
+	uint32_t index = ~0u;
+};
+
+/// Startup work split into named stages with explicit dependencies, so stages that don't depend on each other overlap.
+/// A stage can only depend on stages added before it, which makes the order they were added a valid one by construction.
+/// Stages run on the job pool as soon as their dependencies have finished, except main thread stages (for the windowing
+/// system), which the calling thread runs in the order they were added. After the first failure the remaining stages are skipped.
+/// Every stage has a deletion queue of its own, so teardown doesn't depend on the order the stages happened to finish in.
+class InitGraph {
+	struct Stage {
+		const char* name;
+		std::function<SDL_AppResult()> run;
+		bool onMainThread = false;
+		uint32_t dependencyCount = 0;
+		std::vector<uint32_t> dependents;
+		// dependencies that haven't finished yet, the stage starts once it reaches 0
+		std::atomic<uint32_t> pendingDependencies = 0;
+
+		bool ran = false;
+		uint64_t startTime = 0;
+		uint64_t endTime = 0;
+
+		DeletionQueue deletionQueue;
+	};
+
+	// a deque so the stages stay in place while more are added, they can't be moved because of the atomic
+	std::deque<Stage> stages;
+	std::atomic<SDL_AppResult> result = SDL_APP_CONTINUE;
+	uint64_t runStartTime = 0;
+	uint64_t runEndTime = 0;
+
+	InitStage Add(const char* name, std::function<SDL_AppResult()>&& run, std::initializer_list<InitStage> dependencies, bool onMainThread);
+	void Execute(Stage& stage);
+	void Launch(JobPool& pool, JobCounter& counter, Stage& stage);
+	/// Releases the stages that depend on the given one, starting those that have nothing left to wait for.
+	void Complete(JobPool& pool, JobCounter& counter, const Stage& stage);
+
+public:
+	InitStage AddStage(const char* name, std::function<SDL_AppResult()>&& run, std::initializer_list<InitStage> dependencies = {});
+	InitStage AddMainThreadStage(const char* name, std::function<SDL_AppResult()>&& run, std::initializer_list<InitStage> dependencies = {});
+
+	/// Runs every stage and returns once all of them have finished or were skipped.
+	/// @return The result of the first stage that failed, or SDL_APP_CONTINUE.
+	[[nodiscard]] SDL_AppResult Run(JobPool& pool);
+
+	/// Logs when every stage of the last run started and ended, relative to the start of the run.
+	void LogTimeline() const;
+
+	/// Queues a deleter on the stage running on the calling thread.
+	void PushDeleter(std::function<void()>&& function);
+	/// Runs the deleters of every stage, the last added stage first. A stage only depends on stages added before it,
+	/// so what it was created from is still there while its deleters run.
+	void FlushDeleters();
+};
@@ -9,11 +9,11 @@ VkCommandPoolCreateInfo vk_init::CommandPoolCreateInfo(const uint32_t queueFamil
 	};
 }
 
-VkCommandBufferAllocateInfo vk_init::CommandBufferAllocateInfo(const VkCommandPool& commandPool, const uint32_t count) {
+VkCommandBufferAllocateInfo vk_init::CommandBufferAllocateInfo(const VkCommandPool& commandPool, const uint32_t count, const VkCommandBufferLevel level) {
 	return VkCommandBufferAllocateInfo{
 		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
 		.commandPool = commandPool,
-		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.level = level,
 		.commandBufferCount = count,
 	};
 }
@@ -60,6 +60,18 @@ VkSubmitInfo2 vk_init::SubmitInfo(const VkCommandBufferSubmitInfo* commandBuffer
 	};
 }
 
+VkSubmitInfo2 vk_init::SubmitInfo(const VkCommandBufferSubmitInfo* commandBuffer, const std::span<const VkSemaphoreSubmitInfo> signalSemaphoreInfos, const std::span<const VkSemaphoreSubmitInfo> waitSemaphoreInfos) {
+	return VkSubmitInfo2{
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+		.waitSemaphoreInfoCount = static_cast<uint32_t>(waitSemaphoreInfos.size()),
+		.pWaitSemaphoreInfos = waitSemaphoreInfos.data(),
+		.commandBufferInfoCount = 1,
+		.pCommandBufferInfos = commandBuffer,
+		.signalSemaphoreInfoCount = static_cast<uint32_t>(signalSemaphoreInfos.size()),
+		.pSignalSemaphoreInfos = signalSemaphoreInfos.data()
+	};
+}
+
 VkPresentInfoKHR vk_init::PresentInfo() {
 	return VkPresentInfoKHR{
 		.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
@@ -82,12 +94,12 @@ VkRenderingAttachmentInfo vk_init::AttachmentInfo(const VkImageView& view, const
 	};
 }
 
-VkRenderingAttachmentInfo vk_init::DepthAttachmentInfo(const VkImageView& view, const VkImageLayout layout) {
+VkRenderingAttachmentInfo vk_init::DepthAttachmentInfo(const VkImageView& view, const VkImageLayout layout, const VkAttachmentLoadOp loadOp) {
 	return VkRenderingAttachmentInfo{
 		.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
 		.imageView = view,
 		.imageLayout = layout,
-		.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+		.loadOp = loadOp,
 		.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
 		.clearValue = VkClearValue{.depthStencil = VkClearDepthStencilValue{.depth = 0.0f}}
 	};
@@ -115,11 +127,11 @@ VkImageSubresourceRange vk_init::ImageSubresourceRange(const VkImageAspectFlags
 	};
 }
 
-VkSemaphoreSubmitInfo vk_init::SemaphoreSubmitInfo(const VkPipelineStageFlags2 stageMask, const VkSemaphore& semaphore) {
+VkSemaphoreSubmitInfo vk_init::SemaphoreSubmitInfo(const VkPipelineStageFlags2 stageMask, const VkSemaphore& semaphore, const uint64_t value) {
 	return VkSemaphoreSubmitInfo{
 		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
 		.semaphore = semaphore,
-		.value = 1,
+		.value = value,
 		.stageMask = stageMask,
 		.deviceIndex = 0,
 	};
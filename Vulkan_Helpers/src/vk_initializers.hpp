@@ -4,7 +4,7 @@
 
 namespace vk_init {
 	[[nodiscard]] VkCommandPoolCreateInfo CommandPoolCreateInfo(uint32_t queueFamilyIndex, VkCommandPoolCreateFlags flags = 0);
-	[[nodiscard]] VkCommandBufferAllocateInfo CommandBufferAllocateInfo(const VkCommandPool& commandPool, uint32_t count = 1);
+	[[nodiscard]] VkCommandBufferAllocateInfo CommandBufferAllocateInfo(const VkCommandPool& commandPool, uint32_t count = 1, VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 
 	[[nodiscard]] VkCommandBufferBeginInfo CommandBufferBeginInfo(VkCommandBufferUsageFlags flags = 0);
 	[[nodiscard]] VkCommandBufferSubmitInfo CommandBufferSubmitInfo(const VkCommandBuffer& commandBuffer);
@@ -14,17 +14,18 @@ namespace vk_init {
 	[[nodiscard]] VkSemaphoreCreateInfo SemaphoreCreateInfo(VkSemaphoreCreateFlags flags = 0);
 
 	[[nodiscard]] VkSubmitInfo2 SubmitInfo(const VkCommandBufferSubmitInfo* commandBuffer, const VkSemaphoreSubmitInfo* signalSemaphoreInfo, const VkSemaphoreSubmitInfo* waitSemaphoreInfo);
+	[[nodiscard]] VkSubmitInfo2 SubmitInfo(const VkCommandBufferSubmitInfo* commandBuffer, std::span<const VkSemaphoreSubmitInfo> signalSemaphoreInfos, std::span<const VkSemaphoreSubmitInfo> waitSemaphoreInfos);
 	[[nodiscard]] VkPresentInfoKHR PresentInfo();
 
 	[[nodiscard]] VkRenderingAttachmentInfo AttachmentInfo(const VkImageView& view, const VkClearValue* clear, VkImageLayout layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 
-	[[nodiscard]] VkRenderingAttachmentInfo DepthAttachmentInfo(const VkImageView& view, VkImageLayout layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+	[[nodiscard]] VkRenderingAttachmentInfo DepthAttachmentInfo(const VkImageView& view, VkImageLayout layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR);
 
 	[[nodiscard]] VkRenderingInfo RenderingInfo(VkExtent2D renderExtent, const VkRenderingAttachmentInfo* colourAttachment, const VkRenderingAttachmentInfo* depthAttachment);
 
 	[[nodiscard]] VkImageSubresourceRange ImageSubresourceRange(VkImageAspectFlags aspectMask);
 
-	[[nodiscard]] VkSemaphoreSubmitInfo SemaphoreSubmitInfo(VkPipelineStageFlags2 stageMask, const VkSemaphore& semaphore);
+	[[nodiscard]] VkSemaphoreSubmitInfo SemaphoreSubmitInfo(VkPipelineStageFlags2 stageMask, const VkSemaphore& semaphore, uint64_t value = 1);
 	[[nodiscard]] VkDescriptorSetLayoutBinding DescriptorSetLayoutBinding(VkDescriptorType type, VkShaderStageFlags stageFlags, uint32_t binding);
 	[[nodiscard]] VkDescriptorSetLayoutCreateInfo DescriptorSetLayoutCreateInfo(const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingCount);
 	[[nodiscard]] VkWriteDescriptorSet WriteDescriptorImage(VkDescriptorType type, const VkDescriptorSet& dstSet, const VkDescriptorImageInfo* imageInfo, uint32_t binding);
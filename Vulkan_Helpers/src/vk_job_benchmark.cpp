@@ -0,0 +1,148 @@
+// Impl
+#include "vk_job_benchmark.hpp"
+
+// Engine
+#include "vk_culling.hpp"
+#include "vk_scene_graph.hpp"
+
+namespace {
+	/// Sorts values with recursive fork/join, the upper half is offered to other threads while this one sorts the lower.
+	void ParallelSort(JobPool& jobPool, const std::span<float> values) {
+		constexpr size_t serialSortSize = 16 * 1024;
+		if (values.size() <= serialSortSize) {
+			std::ranges::sort(values);
+			return;
+		}
+
+		const size_t middle = values.size() / 2;
+		JobCounter counter;
+		jobPool.Run([&jobPool, values, middle] { ParallelSort(jobPool, values.subspan(middle)); }, counter);
+		ParallelSort(jobPool, values.first(middle));
+		jobPool.Wait(counter);
+		std::inplace_merge(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(middle), values.end());
+	}
+}
+
+std::vector<JobBenchmarkResult> vk_util::RunJobBenchmark(const math::float4x4& viewProjection, const float sceneRadius) {
+	constexpr uint32_t objectCount = 200'000;
+	constexpr uint32_t nodeCount = 200'000;
+	constexpr uint32_t sortCount = 1'000'000;
+	constexpr uint32_t runs = 8;
+	constexpr double nanosecondsToMilliseconds = 1.0 / 1'000'000.0;
+
+	//a fixed seed, so every thread count gets the same work
+	std::mt19937 random(1234);
+
+	// > Workloads, built once and shared by every thread count
+	std::uniform_real_distribution<float> positionDistribution(-sceneRadius, sceneRadius);
+	std::uniform_real_distribution<float> halfSizeDistribution(sceneRadius * 0.001f, sceneRadius * 0.01f);
+	std::vector<math::float3> mins(objectCount);
+	std::vector<math::float3> maxs(objectCount);
+	for (uint32_t i = 0; i < objectCount; i++) {
+		const math::float3 centre(positionDistribution(random), positionDistribution(random), positionDistribution(random));
+		const float halfSize = halfSizeDistribution(random);
+		mins[i] = math::float3(centre.x - halfSize, centre.y - halfSize, centre.z - halfSize);
+		maxs[i] = math::float3(centre.x + halfSize, centre.y + halfSize, centre.z + halfSize);
+	}
+	BvhCuller culler;
+	culler.Build(mins, maxs);
+	std::vector<uint32_t> visible;
+
+	//a wide, shallow hierarchy, like many objects with a few levels of attachments each
+	std::uniform_real_distribution<float> offsetDistribution(-1.0f, 1.0f);
+	SceneGraph sceneGraph;
+	const uint32_t root = sceneGraph.AddNode(SceneGraph::noParent, "root", math::float3(0.0f, 0.0f, 0.0f), math::float4(0.0f, 0.0f, 0.0f, 1.0f), math::float3(1.0f, 1.0f, 1.0f));
+	while (sceneGraph.GetNodeCount() < nodeCount) {
+		uint32_t parent = root;
+		for (uint32_t depth = 0; depth < 4 && sceneGraph.GetNodeCount() < nodeCount; depth++) {
+			parent = sceneGraph.AddNode(parent, {}, math::float3(offsetDistribution(random), offsetDistribution(random), offsetDistribution(random)), math::float4(0.0f, 0.0f, 0.0f, 1.0f), math::float3(1.0f, 1.0f, 1.0f));
+		}
+	}
+
+	std::vector<float> unsortedValues(sortCount);
+	std::ranges::generate(unsortedValues, [&] { return positionDistribution(random); });
+	std::vector<float> values(sortCount);
+
+	struct Workload {
+		const char* name;
+		std::function<void(JobPool&)> run;
+	};
+	const std::array workloads = {
+		Workload{"BVH cull", [&](JobPool& jobPool) { culler.Cull(viewProjection, jobPool, visible); }},
+		Workload{"Scene graph update", [&](JobPool& jobPool) {
+			sceneGraph.MarkAllDirty();
+			sceneGraph.UpdateWorldMatrices(jobPool);
+		}},
+		Workload{"Fork/join sort", [&](JobPool& jobPool) {
+			std::ranges::copy(unsortedValues, values.begin());
+			ParallelSort(jobPool, values);
+		}},
+	};
+
+	std::vector<uint32_t> threadCounts;
+	const uint32_t hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	for (uint32_t threadCount = 1; threadCount < hardwareThreads; threadCount *= 2) {
+		threadCounts.push_back(threadCount);
+	}
+	threadCounts.push_back(hardwareThreads);
+
+	// > Timing
+	std::vector<JobBenchmarkResult> results;
+	std::vector<double> singleThreadTimes(workloads.size(), 0.0);
+	for (const uint32_t threadCount : threadCounts) {
+		JobPool jobPool(threadCount - 1);
+		for (size_t w = 0; w < workloads.size(); w++) {
+			//the first run wakes the workers and grows the buffers, which later frames don't pay for
+			workloads[w].run(jobPool);
+
+			const uint64_t start = SDL_GetTicksNS();
+			for (uint32_t run = 0; run < runs; run++) {
+				workloads[w].run(jobPool);
+			}
+			const double time = static_cast<double>(SDL_GetTicksNS() - start) * nanosecondsToMilliseconds / runs;
+			if (threadCount == 1) {
+				singleThreadTimes[w] = time;
+			}
+
+			const JobBenchmarkResult result{
+				.workload = workloads[w].name,
+				.threadCount = threadCount,
+				.time = time,
+				.speedup = singleThreadTimes[w] / std::max(time, 1e-6),
+			};
+			SDL_Log("%s on %u threads: %.3f ms, %.2fx speedup", result.workload, threadCount, result.time, result.speedup);
+			results.push_back(result);
+		}
+	}
+
+	//grouped by workload, so the speedups of one workload are next to each other
+	std::ranges::stable_sort(results, {}, [](const JobBenchmarkResult& result) { return std::string_view(result.workload); });
+	return results;
+}
+
+void vk_util::DrawJobBenchmarkTable(const std::span<const JobBenchmarkResult> results) {
+	if (!ImGui::BeginTable("Job Benchmark Results", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) return;
+
+	ImGui::TableSetupColumn("Workload");
+	ImGui::TableSetupColumn("Threads");
+	ImGui::TableSetupColumn("ms");
+	ImGui::TableSetupColumn("Speedup");
+	ImGui::TableSetupColumn("Efficiency");
+	ImGui::TableHeadersRow();
+
+	for (const JobBenchmarkResult& result : results) {
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::TextUnformatted(result.workload);
+		ImGui::TableNextColumn();
+		ImGui::Text("%u", result.threadCount);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", result.time);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.2fx", result.speedup);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.0f%%", result.speedup / result.threadCount * 100.0);
+	}
+
+	ImGui::EndTable();
+}
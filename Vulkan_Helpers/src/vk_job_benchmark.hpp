@@ -0,0 +1,22 @@
+#pragma once
+
+#include "mass_includer.hpp"
+
+// Engine
+#include "vk_job_pool.hpp"
+
+struct JobBenchmarkResult {
+	const char* workload = "";
+	uint32_t threadCount = 0;
+	double time = 0.0;
+	// time on one thread divided by time on threadCount threads
+	double speedup = 0.0;
+};
+
+namespace vk_util {
+	/// Runs engine workloads on job pools of 1, 2, 4 and so on up to all hardware threads: culling a BVH of boxes,
+	/// a full scene graph update and a fork/join sort. Times are in milliseconds, averaged over several runs.
+	/// @param sceneRadius Size of the cube the culled boxes are placed in, so the camera sees part of them.
+	[[nodiscard]] std::vector<JobBenchmarkResult> RunJobBenchmark(const math::float4x4& viewProjection, float sceneRadius);
+	void DrawJobBenchmarkTable(std::span<const JobBenchmarkResult> results);
+}
@@ -0,0 +1,154 @@
+// Impl
+#include "vk_job_pool.hpp"
+
+namespace {
+	// the pool whose worker the current thread is, if any, and the queue of that worker
+	thread_local const JobPool* workerPool = nullptr;
+	thread_local uint32_t workerQueueIndex = 0;
+}
+
+JobPool::JobPool(const uint32_t workerCount) {
+	queues.reserve(workerCount + 1);
+	for (uint32_t i = 0; i < workerCount + 1; i++) {
+		queues.push_back(std::make_unique<WorkerQueue>());
+	}
+
+	workers.reserve(workerCount);
+	for (uint32_t i = 0; i < workerCount; i++) {
+		workers.emplace_back([this, i] { WorkerLoop(i + 1); });
+	}
+}
+
+JobPool::~JobPool() {
+	stopping.store(true, std::memory_order_release);
+	//wakes the sleeping workers, which check stopping before looking for jobs
+	queuedJobCount.fetch_add(1, std::memory_order_release);
+	queuedJobCount.notify_all();
+	workers.clear();
+}
+
+void JobPool::WorkerLoop(const uint32_t queueIndex) {
+	workerPool = this;
+	workerQueueIndex = queueIndex;
+
+	while (!stopping.load(std::memory_order_acquire)) {
+		if (std::optional<Job> job = FindJob(queueIndex); job.has_value()) {
+			Execute(job.value());
+			continue;
+		}
+		queuedJobCount.wait(0, std::memory_order_acquire);
+	}
+}
+
+uint32_t JobPool::GetQueueIndex() const {
+	return workerPool == this ? workerQueueIndex : 0;
+}
+
+std::optional<JobPool::Job> JobPool::FindJob(const uint32_t queueIndex) {
+	if (queuedJobCount.load(std::memory_order_acquire) == 0) return std::nullopt;
+
+	{
+		WorkerQueue& queue = *queues[queueIndex];
+		std::scoped_lock lock(queue.mutex);
+		if (!queue.jobs.empty()) {
+			Job job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+			queuedJobCount.fetch_sub(1, std::memory_order_relaxed);
+			return job;
+		}
+	}
+
+	//start with the next queue, so thieves spread over the victims instead of all going for the first one
+	const size_t queueCount = queues.size();
+	for (size_t offset = 1; offset < queueCount; offset++) {
+		WorkerQueue& victim = *queues[(queueIndex + offset) % queueCount];
+		std::scoped_lock lock(victim.mutex);
+		if (!victim.jobs.empty()) {
+			Job job = std::move(victim.jobs.front());
+			victim.jobs.pop_front();
+			queuedJobCount.fetch_sub(1, std::memory_order_relaxed);
+			return job;
+		}
+	}
+
+	return std::nullopt;
+}
+
+JobCounter::~JobCounter() {
+	while (notifying.load(std::memory_order_acquire) != 0) {
+		std::this_thread::yield();
+	}
+}
+
+void JobPool::Execute(Job& job) {
+	job.function();
+	//announced before the count drops, so a waiter that sees it reach 0 also sees this job still notifying
+	JobCounter& counter = *job.counter;
+	counter.notifying.fetch_add(1, std::memory_order_relaxed);
+	if (counter.pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+		counter.pending.notify_all();
+	}
+	counter.notifying.fetch_sub(1, std::memory_order_release);
+}
+
+void JobPool::Run(std::function<void()> function, JobCounter& counter) {
+	counter.pending.fetch_add(1, std::memory_order_relaxed);
+
+	if (workers.empty()) {
+		Job job{.function = std::move(function), .counter = &counter};
+		Execute(job);
+		return;
+	}
+
+	//counted before it is queued, so the count never drops below the jobs a thief can find
+	queuedJobCount.fetch_add(1, std::memory_order_release);
+	{
+		WorkerQueue& queue = *queues[GetQueueIndex()];
+		std::scoped_lock lock(queue.mutex);
+		queue.jobs.push_back(Job{.function = std::move(function), .counter = &counter});
+	}
+	queuedJobCount.notify_one();
+}
+
+void JobPool::Wait(JobCounter& counter) {
+	const uint32_t queueIndex = GetQueueIndex();
+	uint32_t spins = 0;
+	for (uint32_t pending = counter.pending.load(std::memory_order_acquire); pending > 0; pending = counter.pending.load(std::memory_order_acquire)) {
+		if (std::optional<Job> job = FindJob(queueIndex); job.has_value()) {
+			Execute(job.value());
+			spins = 0;
+			continue;
+		}
+		//nothing left to take, so the remaining jobs are running on other threads, which may still split off more
+		if (spins < waitSpinCount) {
+			spins++;
+			std::this_thread::yield();
+			continue;
+		}
+		counter.pending.wait(pending, std::memory_order_acquire);
+	}
+}
+
+void JobPool::SplitRange(const uint32_t begin, uint32_t end, const std::function<void(uint32_t)>& function, JobCounter& counter) {
+	//the upper halves go to the back of the queue, so this thread keeps the small ranges and thieves take the large ones
+	while (end - begin > 1) {
+		const uint32_t middle = begin + (end - begin) / 2;
+		Run([this, middle, end, &function, &counter] { SplitRange(middle, end, function, counter); }, counter);
+		end = middle;
+	}
+	function(begin);
+}
+
+void JobPool::ParallelFor(const uint32_t count, const std::function<void(uint32_t)>& function) {
+	if (count == 0) return;
+	if (workers.empty() || count == 1) {
+		for (uint32_t i = 0; i < count; i++) {
+			function(i);
+		}
+		return;
+	}
+
+	JobCounter counter;
+	SplitRange(0, count, function, counter);
+	Wait(counter);
+}
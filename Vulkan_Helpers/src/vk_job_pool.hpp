@@ -0,0 +1,74 @@
+#pragma once
+
+#include "mass_includer.hpp"
+
+class JobPool;
+
+/// Counts the unfinished jobs started with it, so a thread can wait for a group of jobs, like a join.
+/// Must outlive the jobs it counts.
+class JobCounter {
+	friend class JobPool;
+	std::atomic<uint32_t> pending = 0;
+	// jobs between counting themselves done and notifying the waiters, which still touch the counter
+	std::atomic<uint32_t> notifying = 0;
+
+public:
+	JobCounter() = default;
+	/// Waits for a job that finished the count to be done notifying, since its waiter may already have returned.
+	~JobCounter();
+
+	[[nodiscard]] bool IsDone() const { return pending.load(std::memory_order_acquire) == 0; }
+};
+
+/// A work-stealing job system with a fixed set of worker threads.
+/// Every thread has its own queue: it pushes and pops its newest jobs at the back, while idle threads steal the oldest
+/// from the front, which are usually the largest since work is split from the top down. A thread waiting for a counter
+/// runs jobs in the meantime instead of blocking, so jobs can start and wait for jobs of their own.
+/// The calling thread works along, so a pool without workers still runs everything, just on one thread.
+class JobPool {
+	struct Job {
+		std::function<void()> function;
+		JobCounter* counter = nullptr;
+	};
+
+	struct WorkerQueue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	// queue 0 belongs to the threads outside the pool, the others to the workers in order
+	std::vector<std::unique_ptr<WorkerQueue>> queues;
+	// times a waiting thread looks for jobs again before it sleeps until the counter changes
+	static constexpr uint32_t waitSpinCount = 64;
+
+	// jobs in all queues together, idle workers sleep while it is 0
+	std::atomic<uint32_t> queuedJobCount = 0;
+	std::atomic<bool> stopping = false;
+	std::vector<std::jthread> workers;
+
+	void WorkerLoop(uint32_t queueIndex);
+	[[nodiscard]] uint32_t GetQueueIndex() const;
+	/// Pops the newest job of the given queue, or steals the oldest job of another one.
+	[[nodiscard]] std::optional<Job> FindJob(uint32_t queueIndex);
+	static void Execute(Job& job);
+	/// Calls function for every index in [begin, end), handing halves of the range to other threads.
+	void SplitRange(uint32_t begin, uint32_t end, const std::function<void(uint32_t)>& function, JobCounter& counter);
+
+public:
+	/// @param workerCount Threads besides the calling one, by default one less than the hardware threads.
+	explicit JobPool(uint32_t workerCount = std::max(std::thread::hardware_concurrency(), 1u) - 1);
+	~JobPool();
+
+	JobPool(const JobPool&) = delete;
+	JobPool& operator=(const JobPool&) = delete;
+
+	[[nodiscard]] uint32_t GetThreadCount() const { return static_cast<uint32_t>(workers.size()) + 1; }
+
+	/// Queues function on the calling thread's queue, counter counts it until it has returned.
+	void Run(std::function<void()> function, JobCounter& counter);
+	/// Runs jobs until every job counted by counter has finished.
+	void Wait(JobCounter& counter);
+
+	/// Calls function(i) for every i below count, spread over all threads, and returns once all calls have returned.
+	void ParallelFor(uint32_t count, const std::function<void(uint32_t)>& function);
+};
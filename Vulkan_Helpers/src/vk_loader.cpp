@@ -4,7 +4,7 @@
 // Engine
 #include "vk_engine.hpp"
 
-std::optional<std::vector<std::shared_ptr<MeshAsset>>> ImportMesh(VulkanEngine* engine, const std::filesystem::path& fullPath) {
+std::optional<std::vector<ParsedMesh>> ParseMesh(const std::filesystem::path& fullPath, SceneGraph* sceneGraph) {
 	SDL_assert(is_regular_file(fullPath));
 	Assimp::Importer importer;
 
@@ -18,7 +18,7 @@ std::optional<std::vector<std::shared_ptr<MeshAsset>>> ImportMesh(VulkanEngine*
 	}
 
 	SDL_assert(scene->HasMeshes());
-	std::vector<std::shared_ptr<MeshAsset>> meshes(scene->mNumMeshes);
+	std::vector<ParsedMesh> meshes(scene->mNumMeshes);
 
 	for (unsigned int h = 0; h < scene->mNumMeshes; h++) {
 		const aiMesh* mesh = scene->mMeshes[h];
@@ -59,6 +59,21 @@ std::optional<std::vector<std::shared_ptr<MeshAsset>>> ImportMesh(VulkanEngine*
 				.colour = math::float4(col.r, col.g, col.b, col.a),
 			};
 		}
+		// > Bounding sphere, around the centre of the bounding box
+		math::float3 minimum = vertices.empty() ? math::float3(0.0f, 0.0f, 0.0f) : vertices[0].pos;
+		math::float3 maximum = minimum;
+		for (const MyVertex& vertex : vertices) {
+			minimum = math::float3(std::min(minimum.x, vertex.pos.x), std::min(minimum.y, vertex.pos.y), std::min(minimum.z, vertex.pos.z));
+			maximum = math::float3(std::max(maximum.x, vertex.pos.x), std::max(maximum.y, vertex.pos.y), std::max(maximum.z, vertex.pos.z));
+		}
+		const math::float3 centre = (minimum + maximum) * 0.5f;
+		float radiusSquared = 0.0f;
+		for (const MyVertex& vertex : vertices) {
+			const math::float3 offset = vertex.pos - centre;
+			radiusSquared = std::max(radiusSquared, offset.x * offset.x + offset.y * offset.y + offset.z * offset.z);
+		}
+		newMesh.boundingSphere = math::float4(centre.x, centre.y, centre.z, std::sqrt(radiusSquared));
+
 		// > Indices
 		std::vector<Uint16> indices(mesh->mNumFaces * 3);
 		SDL_Log("Assimp: Mesh %s has %d faces", fullPath.c_str(), mesh->mNumFaces);
@@ -88,14 +103,34 @@ std::optional<std::vector<std::shared_ptr<MeshAsset>>> ImportMesh(VulkanEngine*
 
 		newMesh.surfaces.push_back(newSurface);
 
-		std::optional<GPUMeshBuffers> uploadResult = engine->UploadMesh(indices, vertices);
+		meshes[h] = ParsedMesh{
+			.asset = std::move(newMesh),
+			.indices = std::move(indices),
+			.vertices = std::move(vertices),
+		};
+	}
+
+	// > Node hierarchy, which places the meshes in the scene
+	if (sceneGraph != nullptr && scene->mRootNode != nullptr) {
+		sceneGraph->Import(scene->mRootNode);
+	}
+
+	return meshes;
+}
+
+std::optional<std::vector<MeshAsset>> UploadMeshes(const VulkanEngine* engine, std::vector<ParsedMesh>&& parsedMeshes) {
+	std::vector<MeshAsset> meshes;
+	meshes.reserve(parsedMeshes.size());
+
+	for (ParsedMesh& parsedMesh : parsedMeshes) {
+		std::optional<GPUMeshBuffers> uploadResult = engine->UploadMesh(parsedMesh.indices, parsedMesh.vertices);
 		if (!uploadResult.has_value()) {
-			SDL_Log("Failed to upload mesh %s", newMesh.name.c_str());
+			SDL_Log("Failed to upload mesh %s", parsedMesh.asset.name.c_str());
 			return std::nullopt;
 		}
-		newMesh.meshBuffers = uploadResult.value();
+		parsedMesh.asset.meshBuffers = uploadResult.value();
 
-		meshes[h] = std::make_shared<MeshAsset>(std::move(newMesh));
+		meshes.push_back(std::move(parsedMesh.asset));
 	}
 
 	return meshes;
@@ -4,6 +4,8 @@
 
 // Engine
 #include "vk_custom_types.hpp"
+#include "vk_resource_pool.hpp"
+#include "vk_scene_graph.hpp"
 
 class VulkanEngine;
 
@@ -18,6 +20,20 @@ struct MeshAsset {
 
 	std::vector<GeoSurface> surfaces;
 	GPUMeshBuffers meshBuffers;
+	math::float4 boundingSphere; //object space centre in xyz, radius in w
 };
 
-[[nodiscard]] std::optional<std::vector<std::shared_ptr<MeshAsset>>> ImportMesh(VulkanEngine* engine, const std::filesystem::path& fullPath);
+/// A mesh read from a file, with its geometry still on the CPU.
+struct ParsedMesh {
+	MeshAsset asset;
+	std::vector<Uint16> indices;
+	std::vector<MyVertex> vertices;
+};
+
+/// Reads the meshes of a file without touching the GPU, so it can run before the device exists.
+/// @param sceneGraph If set, the node hierarchy of the file is appended to it, with mesh indices into the returned meshes.
+[[nodiscard]] std::optional<std::vector<ParsedMesh>> ParseMesh(const std::filesystem::path& fullPath, SceneGraph* sceneGraph = nullptr);
+
+/// Uploads the geometry of parsed meshes.
+/// @return The meshes by value, so the caller can move them into its ResourcePool.
+[[nodiscard]] std::optional<std::vector<MeshAsset>> UploadMeshes(const VulkanEngine* engine, std::vector<ParsedMesh>&& parsedMeshes);
@@ -0,0 +1,142 @@
+// Impl
+#include "vk_memory.hpp"
+
+const char* MemoryCategoryName(const MemoryCategory category) {
+	switch (category) {
+		case MemoryCategory::Textures: return "Textures";
+		case MemoryCategory::Meshes: return "Meshes";
+		case MemoryCategory::RenderTargets: return "Render Targets";
+		case MemoryCategory::Staging: return "Staging";
+		case MemoryCategory::Buffers: return "Buffers";
+		default: return "Unknown";
+	}
+}
+
+void MemoryTracker::Init(const VmaAllocator& allocator) {
+	this->allocator = allocator;
+}
+
+void MemoryTracker::Track(const VmaAllocation& allocation, const MemoryCategory category) {
+	//the category is stored as the user data itself, so there is nothing to free with the allocation
+	vmaSetAllocationUserData(allocator, allocation, reinterpret_cast<void*>(static_cast<uintptr_t>(category)));
+	vmaSetAllocationName(allocator, allocation, MemoryCategoryName(category));
+
+	VmaAllocationInfo allocationInfo;
+	vmaGetAllocationInfo(allocator, allocation, &allocationInfo);
+	CategoryTotals& totals = categories[static_cast<size_t>(category)];
+	totals.bytes.fetch_add(allocationInfo.size, std::memory_order_relaxed);
+	totals.allocationCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MemoryTracker::Untrack(const VmaAllocation& allocation) {
+	if (allocation == nullptr) return;
+
+	VmaAllocationInfo allocationInfo;
+	vmaGetAllocationInfo(allocator, allocation, &allocationInfo);
+	const uintptr_t category = reinterpret_cast<uintptr_t>(allocationInfo.pUserData) & categoryMask;
+	if (category >= categories.size()) return;
+
+	CategoryTotals& totals = categories[category];
+	totals.bytes.fetch_sub(allocationInfo.size, std::memory_order_relaxed);
+	totals.allocationCount.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void MemoryTracker::SetOwner(const VmaAllocation& allocation, const uint32_t owner) const {
+	VmaAllocationInfo allocationInfo;
+	vmaGetAllocationInfo(allocator, allocation, &allocationInfo);
+	const uintptr_t category = reinterpret_cast<uintptr_t>(allocationInfo.pUserData) & categoryMask;
+	vmaSetAllocationUserData(allocator, allocation, reinterpret_cast<void*>(static_cast<uintptr_t>(owner) << ownerShift | category));
+}
+
+uint32_t MemoryTracker::GetOwner(const VmaAllocationInfo& allocationInfo) {
+	return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(allocationInfo.pUserData) >> ownerShift);
+}
+
+void MemoryTracker::ReadHeapBudgets(std::vector<HeapBudget>& budgets) const {
+	const VkPhysicalDeviceMemoryProperties* memoryProperties;
+	vmaGetMemoryProperties(allocator, &memoryProperties);
+
+	std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> vmaBudgets{};
+	vmaGetHeapBudgets(allocator, vmaBudgets.data());
+
+	budgets.clear();
+	for (uint32_t heap = 0; heap < memoryProperties->memoryHeapCount; heap++) {
+		budgets.push_back(HeapBudget{
+			.deviceLocal = (memoryProperties->memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0,
+			.usage = vmaBudgets[heap].usage,
+			.budget = vmaBudgets[heap].budget,
+			.blockBytes = vmaBudgets[heap].statistics.blockBytes,
+			.allocationBytes = vmaBudgets[heap].statistics.allocationBytes,
+		});
+	}
+}
+
+void MemoryTracker::DrawImGuiTables(const std::span<const HeapBudget> budgets) const {
+	constexpr double bytesToMegabytes = 1.0 / (1024.0 * 1024.0);
+
+	if (ImGui::BeginTable("Heap Budgets", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+		ImGui::TableSetupColumn("Heap");
+		ImGui::TableSetupColumn("Usage MB");
+		ImGui::TableSetupColumn("Budget MB");
+		ImGui::TableSetupColumn("VMA blocks MB");
+		ImGui::TableSetupColumn("VMA allocations MB");
+		ImGui::TableHeadersRow();
+
+		for (size_t heap = 0; heap < budgets.size(); heap++) {
+			const HeapBudget& budget = budgets[heap];
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::Text("%zu%s", heap, budget.deviceLocal ? " (device local)" : "");
+			ImGui::TableNextColumn();
+			//over budget the driver starts moving memory out of the heap, which shows as stutter
+			if (budget.usage > budget.budget) {
+				ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "%.1f", static_cast<double>(budget.usage) * bytesToMegabytes);
+			} else {
+				ImGui::Text("%.1f", static_cast<double>(budget.usage) * bytesToMegabytes);
+			}
+			ImGui::TableNextColumn();
+			ImGui::Text("%.1f", static_cast<double>(budget.budget) * bytesToMegabytes);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.1f", static_cast<double>(budget.blockBytes) * bytesToMegabytes);
+			ImGui::TableNextColumn();
+			ImGui::Text("%.1f", static_cast<double>(budget.allocationBytes) * bytesToMegabytes);
+		}
+
+		ImGui::EndTable();
+	}
+
+	if (ImGui::BeginTable("Memory Categories", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+		ImGui::TableSetupColumn("Category");
+		ImGui::TableSetupColumn("Allocations");
+		ImGui::TableSetupColumn("MB");
+		ImGui::TableHeadersRow();
+
+		for (size_t i = 0; i < categories.size(); i++) {
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn();
+			ImGui::TextUnformatted(MemoryCategoryName(static_cast<MemoryCategory>(i)));
+			ImGui::TableNextColumn();
+			ImGui::Text("%llu", static_cast<unsigned long long>(categories[i].allocationCount.load(std::memory_order_relaxed)));
+			ImGui::TableNextColumn();
+			ImGui::Text("%.2f", static_cast<double>(categories[i].bytes.load(std::memory_order_relaxed)) * bytesToMegabytes);
+		}
+
+		ImGui::EndTable();
+	}
+}
+
+bool MemoryTracker::ExportJson(const std::filesystem::path& path) const {
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open()) {
+		SDL_Log("Couldn't write memory statistics: %s", path.string().c_str());
+		return false;
+	}
+
+	char* statsString = nullptr;
+	vmaBuildStatsString(allocator, &statsString, VK_TRUE);
+	file << statsString;
+	vmaFreeStatsString(allocator, statsString);
+
+	SDL_Log("Wrote memory statistics to %s", path.string().c_str());
+	return true;
+}
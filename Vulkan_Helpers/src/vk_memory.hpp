@@ -0,0 +1,65 @@
+#pragma once
+
+#include "mass_includer.hpp"
+
+enum class MemoryCategory : uint32_t {
+	Textures,
+	Meshes,
+	RenderTargets,
+	Staging,
+	// other GPU data, like the instance and draw command buffers
+	Buffers,
+	Count,
+};
+
+[[nodiscard]] const char* MemoryCategoryName(MemoryCategory category);
+
+/// Usage against budget of one memory heap, as VK_EXT_memory_budget reports it.
+struct HeapBudget {
+	bool deviceLocal;
+	// by every process, including this one
+	VkDeviceSize usage;
+	VkDeviceSize budget;
+	// blocks VMA allocated, and the part of them handed out to allocations
+	VkDeviceSize blockBytes;
+	VkDeviceSize allocationBytes;
+};
+
+/// Bytes and allocations per category. Every allocation is tagged with its category through VMA's user data,
+/// so the category is found again when the allocation is freed, and shows up as its name in VMA's JSON dump.
+/// The user data also has room for a 32-bit owner, to find what an allocation belongs to from the allocation alone.
+class MemoryTracker {
+	// the category takes the low half of the user data, the owner the high half
+	static constexpr uint32_t ownerShift = 32;
+	static constexpr uintptr_t categoryMask = 0xFFFFFFFF;
+	static_assert(sizeof(uintptr_t) >= sizeof(uint64_t), "the user data holds both the category and the owner");
+
+	struct CategoryTotals {
+		std::atomic<uint64_t> bytes = 0;
+		std::atomic<uint64_t> allocationCount = 0;
+	};
+
+	VmaAllocator allocator = nullptr;
+	// allocations are made and freed on several threads
+	std::array<CategoryTotals, static_cast<size_t>(MemoryCategory::Count)> categories;
+
+public:
+	void Init(const VmaAllocator& allocator);
+
+	/// Must be called once for every allocation, right after it was made.
+	void Track(const VmaAllocation& allocation, MemoryCategory category);
+	/// Must be called for every tracked allocation, before it is freed.
+	void Untrack(const VmaAllocation& allocation);
+
+	/// Stores what the tracked allocation belongs to, like a resource pool handle. 0 means it has no owner.
+	void SetOwner(const VmaAllocation& allocation, uint32_t owner) const;
+	/// @return The owner of the allocation whose info was read, 0 if it has none.
+	[[nodiscard]] static uint32_t GetOwner(const VmaAllocationInfo& allocationInfo);
+
+	/// Reads the budget of every heap. Needs VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT to be more than an estimate.
+	void ReadHeapBudgets(std::vector<HeapBudget>& budgets) const;
+
+	void DrawImGuiTables(std::span<const HeapBudget> budgets) const;
+	/// Writes vmaBuildStatsString with the detailed map, which lists every allocation with its category.
+	bool ExportJson(const std::filesystem::path& path) const;
+};
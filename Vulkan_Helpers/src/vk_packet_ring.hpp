@@ -0,0 +1,70 @@
+#pragma once
+
+#include "mass_includer.hpp"
+
+/// A fixed ring of packets handed from one producer thread to one consumer thread without locks.
+/// The producer fills the next free slot and publishes it, the consumer reads the oldest published one and releases it,
+/// after which the producer may reuse the slot. The slots are allocated once, so packets keep their memory between uses.
+/// A side only blocks when the ring is full or empty, by waiting on the other side's counter.
+template<typename T>
+class PacketRing {
+	std::vector<T> slots;
+	// counted since the start, the difference is how many packets are in the ring,
+	// each on its own cache line since both are written by a different thread
+	alignas(64) std::atomic<uint64_t> publishedCount = 0;
+	alignas(64) std::atomic<uint64_t> releasedCount = 0;
+
+public:
+	explicit PacketRing(const size_t capacity) : slots(capacity) {}
+
+	PacketRing(const PacketRing&) = delete;
+	PacketRing& operator=(const PacketRing&) = delete;
+
+	[[nodiscard]] size_t GetCapacity() const { return slots.size(); }
+
+	/// Producer only. Blocks until a slot is free.
+	/// @return The slot to fill, still holding what was last written to it.
+	[[nodiscard]] T& BeginWrite() {
+		const uint64_t published = publishedCount.load(std::memory_order_relaxed);
+		uint64_t released = releasedCount.load(std::memory_order_acquire);
+		while (published - released == slots.size()) {
+			releasedCount.wait(released, std::memory_order_acquire);
+			released = releasedCount.load(std::memory_order_acquire);
+		}
+		return slots[published % slots.size()];
+	}
+
+	/// Producer only. Hands the slot from the last BeginWrite to the consumer.
+	void Publish() {
+		publishedCount.fetch_add(1, std::memory_order_release);
+		publishedCount.notify_one();
+	}
+
+	/// Producer only. Blocks until the consumer has released every published packet.
+	void WaitUntilEmpty() const {
+		const uint64_t published = publishedCount.load(std::memory_order_relaxed);
+		uint64_t released = releasedCount.load(std::memory_order_acquire);
+		while (released != published) {
+			releasedCount.wait(released, std::memory_order_acquire);
+			released = releasedCount.load(std::memory_order_acquire);
+		}
+	}
+
+	/// Consumer only. Blocks until a packet is published.
+	/// @return The oldest published packet, which stays valid until Release.
+	[[nodiscard]] T& BeginRead() {
+		const uint64_t released = releasedCount.load(std::memory_order_relaxed);
+		uint64_t published = publishedCount.load(std::memory_order_acquire);
+		while (published == released) {
+			publishedCount.wait(published, std::memory_order_acquire);
+			published = publishedCount.load(std::memory_order_acquire);
+		}
+		return slots[released % slots.size()];
+	}
+
+	/// Consumer only. Hands the packet from the last BeginRead back to the producer.
+	void Release() {
+		releasedCount.fetch_add(1, std::memory_order_release);
+		releasedCount.notify_one();
+	}
+};
@@ -5,7 +5,7 @@
 #include "vk_initializers.hpp"
 #include "vk_macros.hpp"
 
-std::optional<VkShaderModule> vk_util::LoadShaderModule(const char* filePath, const VkDevice& device) {
+std::optional<VkShaderModule> vk_util::LoadShaderModule(const char* filePath, const VkDevice& device, uint64_t* codeHash) {
 	size_t fileSize;
 	void* contents = SDL_LoadFile(filePath, &fileSize);
 	if (contents == nullptr) {
@@ -13,6 +13,15 @@ std::optional<VkShaderModule> vk_util::LoadShaderModule(const char* filePath, co
 		return std::nullopt;
 	}
 
+	//FNV-1a, only used to notice that the code changed
+	if (codeHash != nullptr) {
+		uint64_t hash = 0xcbf29ce484222325ull;
+		for (const uint8_t byte : std::span(static_cast<const uint8_t*>(contents), fileSize)) {
+			hash = (hash ^ byte) * 0x100000001b3ull;
+		}
+		*codeHash = hash;
+	}
+
 	// create a new shader module, using the buffer we loaded
 	const VkShaderModuleCreateInfo createInfo = {
 		.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
@@ -31,6 +40,42 @@ std::optional<VkShaderModule> vk_util::LoadShaderModule(const char* filePath, co
 	return shaderModule;
 }
 
+std::optional<VkPipeline> vk_util::CreateComputePipeline(const VkDevice& device, const VkShaderModule& shaderModule, const VkPipelineLayout& layout, const WorkgroupSize workgroupSize) {
+	const std::array specializationEntries = {
+		VkSpecializationMapEntry{
+			.constantID = 0,
+			.offset = offsetof(WorkgroupSize, x),
+			.size = sizeof(uint32_t),
+		},
+		VkSpecializationMapEntry{
+			.constantID = 1,
+			.offset = offsetof(WorkgroupSize, y),
+			.size = sizeof(uint32_t),
+		},
+	};
+
+	const VkSpecializationInfo specializationInfo{
+		.mapEntryCount = specializationEntries.size(),
+		.pMapEntries = specializationEntries.data(),
+		.dataSize = sizeof(WorkgroupSize),
+		.pData = &workgroupSize,
+	};
+
+	VkPipelineShaderStageCreateInfo stageCreateInfo = vk_init::PipelineShaderStageCreateInfo(VK_SHADER_STAGE_COMPUTE_BIT, shaderModule);
+	stageCreateInfo.pSpecializationInfo = &specializationInfo;
+
+	const VkComputePipelineCreateInfo computePipelineCreateInfo{
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.stage = stageCreateInfo,
+		.layout = layout,
+	};
+
+	VkPipeline newPipeline;
+	VK_CHECK_EMPTY_OPTIONAL(vkCreateComputePipelines(device, nullptr, 1, &computePipelineCreateInfo, nullptr, &newPipeline), "Couldn't create compute pipeline");
+
+	return newPipeline;
+}
+
 PipelineBuilder::PipelineBuilder() {
 	Clear();
 }
@@ -2,8 +2,14 @@
 
 #include "mass_includer.hpp"
 
+// Engine
+#include "vk_custom_types.hpp"
+
 namespace vk_util {
-	[[nodiscard]] std::optional<VkShaderModule> LoadShaderModule(const char* filePath, const VkDevice& device);
+	/// @param codeHash Set to a hash of the SPIR-V, for caches that must not outlive a recompiled shader.
+	[[nodiscard]] std::optional<VkShaderModule> LoadShaderModule(const char* filePath, const VkDevice& device, uint64_t* codeHash = nullptr);
+	/// Creates a compute pipeline with its workgroup size set through specialization constants 0 (x) and 1 (y).
+	[[nodiscard]] std::optional<VkPipeline> CreateComputePipeline(const VkDevice& device, const VkShaderModule& shaderModule, const VkPipelineLayout& layout, WorkgroupSize workgroupSize);
 };
 
 class PipelineBuilder {
@@ -0,0 +1,372 @@
+// Impl
+#include "vk_render_graph.hpp"
+
+// Engine
+#include "vk_images.hpp"
+#include "vk_initializers.hpp"
+#include "vk_macros.hpp"
+
+namespace {
+	bool SameDescription(const TransientImageDescription& a, const TransientImageDescription& b) {
+		return a.extent.width == b.extent.width && a.extent.height == b.extent.height && a.extent.depth == b.extent.depth
+			&& a.format == b.format && a.usage == b.usage;
+	}
+
+	bool LifetimesOverlap(const uint32_t firstA, const uint32_t lastA, const uint32_t firstB, const uint32_t lastB) {
+		return firstA <= lastB && firstB <= lastA;
+	}
+}
+
+std::vector<TransientMemoryBlock> PlaceTransients(const std::span<const TransientLifetime> transients) {
+	std::vector<uint32_t> placementOrder(transients.size());
+	for (uint32_t t = 0; t < placementOrder.size(); t++) placementOrder[t] = t;
+	std::ranges::sort(placementOrder, [&](const uint32_t a, const uint32_t b) { return transients[a].requirements.size > transients[b].requirements.size; });
+
+	std::vector<TransientMemoryBlock> blocks;
+	for (const uint32_t t : placementOrder) {
+		const TransientLifetime& transient = transients[t];
+		std::optional<uint32_t> chosenBlock;
+		for (uint32_t b = 0; b < blocks.size() && !chosenBlock.has_value(); b++) {
+			if ((blocks[b].requirements.memoryTypeBits & transient.requirements.memoryTypeBits) == 0) continue;
+
+			bool overlaps = false;
+			for (const uint32_t occupant : blocks[b].occupants) {
+				overlaps |= LifetimesOverlap(transient.firstPass, transient.lastPass, transients[occupant].firstPass, transients[occupant].lastPass);
+			}
+			if (!overlaps) chosenBlock = b;
+		}
+
+		if (chosenBlock.has_value()) {
+			VkMemoryRequirements& blockRequirements = blocks[chosenBlock.value()].requirements;
+			blockRequirements.size = std::max(blockRequirements.size, transient.requirements.size);
+			blockRequirements.alignment = std::max(blockRequirements.alignment, transient.requirements.alignment);
+			blockRequirements.memoryTypeBits &= transient.requirements.memoryTypeBits;
+		} else {
+			chosenBlock = static_cast<uint32_t>(blocks.size());
+			blocks.push_back(TransientMemoryBlock{transient.requirements, {}});
+		}
+		blocks[chosenBlock.value()].occupants.push_back(t);
+	}
+
+	return blocks;
+}
+
+RenderGraphPass::RenderGraphPass(const char* name, std::function<SDL_AppResult(const VkCommandBuffer& commandBuffer)>&& execute)
+	: name(name),
+	  execute(std::move(execute)) {
+}
+
+RenderGraphPass& RenderGraphPass::Read(const RenderGraphImage image, const ImageUsage usage) {
+	imageAccesses.push_back(ImageAccess{image, usage, false, false});
+	return *this;
+}
+
+RenderGraphPass& RenderGraphPass::Write(const RenderGraphImage image, const ImageUsage usage, const bool discardContents) {
+	imageAccesses.push_back(ImageAccess{image, usage, true, discardContents});
+	return *this;
+}
+
+RenderGraphPass& RenderGraphPass::Read(const RenderGraphBuffer buffer, const BufferUsage usage) {
+	bufferAccesses.push_back(BufferAccess{buffer, usage, false});
+	return *this;
+}
+
+RenderGraphPass& RenderGraphPass::Write(const RenderGraphBuffer buffer, const BufferUsage usage) {
+	bufferAccesses.push_back(BufferAccess{buffer, usage, true});
+	return *this;
+}
+
+RenderGraphPass& RenderGraphPass::SideEffects() {
+	hasSideEffects = true;
+	return *this;
+}
+
+void RenderGraph::Init(const VkDevice& device, const VmaAllocator& allocator, MemoryTracker& memoryTracker) {
+	this->device = device;
+	this->allocator = allocator;
+	this->memoryTracker = &memoryTracker;
+}
+
+void RenderGraph::Destroy() {
+	Reset();
+	DestroyTransients();
+}
+
+void RenderGraph::Reset() {
+	passes.clear();
+	images.clear();
+	buffers.clear();
+}
+
+RenderGraphImage RenderGraph::ImportImage(const char* name, AllocatedImage& image) {
+	return ImportImage(name, image.image, image.imageView, image.state, image.imageFormat, image.imageExtent);
+}
+
+RenderGraphImage RenderGraph::ImportImage(const char* name, const VkImage& image, const VkImageView& imageView, ImageState& state, const VkFormat format, const VkExtent3D extent) {
+	images.push_back(ImageResource{
+		.name = name,
+		.image = image,
+		.imageView = imageView,
+		.format = format,
+		.extent = extent,
+		.importedState = &state,
+	});
+	return RenderGraphImage{static_cast<uint32_t>(images.size() - 1)};
+}
+
+RenderGraphImage RenderGraph::CreateImage(const char* name, const TransientImageDescription& description) {
+	images.push_back(ImageResource{
+		.name = name,
+		.format = description.format,
+		.extent = description.extent,
+		.transient = true,
+		.description = description,
+	});
+	return RenderGraphImage{static_cast<uint32_t>(images.size() - 1)};
+}
+
+RenderGraphBuffer RenderGraph::ImportBuffer(const char* name, AllocatedBuffer& buffer) {
+	buffers.push_back(BufferResource{
+		.name = name,
+		.buffer = buffer.internalBuffer,
+		.state = &buffer.state,
+	});
+	return RenderGraphBuffer{static_cast<uint32_t>(buffers.size() - 1)};
+}
+
+void RenderGraph::MarkOutput(const RenderGraphImage image, const ImageUsage finalUsage) {
+	images[image.index].isOutput = true;
+	images[image.index].outputUsage = finalUsage;
+}
+
+void RenderGraph::MarkOutput(const RenderGraphBuffer buffer) {
+	buffers[buffer.index].isOutput = true;
+}
+
+RenderGraphPass& RenderGraph::AddPass(const char* name, std::function<SDL_AppResult(const VkCommandBuffer& commandBuffer)>&& execute) {
+	return passes.emplace_back(name, std::move(execute));
+}
+
+VkImageView RenderGraph::GetImageView(const RenderGraphImage image) const {
+	return images[image.index].imageView;
+}
+
+VkImage RenderGraph::GetImage(const RenderGraphImage image) const {
+	return images[image.index].image;
+}
+
+ImageState& RenderGraph::StateOf(ImageResource& resource) {
+	return resource.transient ? resource.transientState : *resource.importedState;
+}
+
+void RenderGraph::Cull() {
+	std::vector<bool> imageNeeded(images.size());
+	std::vector<bool> bufferNeeded(buffers.size());
+	for (size_t i = 0; i < images.size(); i++) imageNeeded[i] = images[i].isOutput;
+	for (size_t i = 0; i < buffers.size(); i++) bufferNeeded[i] = buffers[i].isOutput;
+
+	//walk back from the outputs, a pass is only needed when a later needed pass or an output uses what it writes
+	for (RenderGraphPass& pass : std::ranges::reverse_view(passes)) {
+		bool needed = pass.hasSideEffects;
+		for (const RenderGraphPass::ImageAccess& access : pass.imageAccesses) {
+			needed |= access.writes && imageNeeded[access.image.index];
+		}
+		for (const RenderGraphPass::BufferAccess& access : pass.bufferAccesses) {
+			needed |= access.writes && bufferNeeded[access.buffer.index];
+		}
+
+		pass.culled = !needed;
+		if (pass.culled) continue;
+
+		//whatever was in an image before it is overwritten isn't needed by this pass
+		for (const RenderGraphPass::ImageAccess& access : pass.imageAccesses) {
+			if (access.discardContents) imageNeeded[access.image.index] = false;
+		}
+		for (const RenderGraphPass::ImageAccess& access : pass.imageAccesses) {
+			if (!access.discardContents) imageNeeded[access.image.index] = true;
+		}
+		for (const RenderGraphPass::BufferAccess& access : pass.bufferAccesses) {
+			bufferNeeded[access.buffer.index] = true;
+		}
+	}
+}
+
+SDL_AppResult RenderGraph::AllocateTransients() {
+	//lifetimes of the transient images, over the passes that survived culling
+	std::vector<uint32_t> transientIndices;
+	for (uint32_t p = 0; p < passes.size(); p++) {
+		if (passes[p].culled) continue;
+		for (const RenderGraphPass::ImageAccess& access : passes[p].imageAccesses) {
+			ImageResource& resource = images[access.image.index];
+			if (!resource.transient) continue;
+			resource.firstPass = std::min(resource.firstPass, p);
+			resource.lastPass = std::max(resource.lastPass, p);
+		}
+	}
+	for (uint32_t i = 0; i < images.size(); i++) {
+		if (images[i].transient && images[i].firstPass != ~0u) {
+			transientIndices.push_back(i);
+		}
+	}
+
+	//same transients with the same lifetimes as last time, so the memory layout still works
+	bool reusable = transientIndices.size() == transientAllocations.size();
+	for (size_t t = 0; reusable && t < transientIndices.size(); t++) {
+		const ImageResource& resource = images[transientIndices[t]];
+		const TransientAllocation& allocation = transientAllocations[t];
+		reusable = SameDescription(resource.description, allocation.description) && resource.firstPass == allocation.firstPass && resource.lastPass == allocation.lastPass;
+	}
+
+	if (!reusable) {
+		DestroyTransients();
+
+		std::vector<TransientLifetime> lifetimes(transientIndices.size());
+
+		for (size_t t = 0; t < transientIndices.size(); t++) {
+			const ImageResource& resource = images[transientIndices[t]];
+			const VkImageCreateInfo imageCreateInfo = vk_init::ImageCreateInfo(resource.description.format, resource.description.usage, resource.description.extent);
+			const VkDeviceImageMemoryRequirements imageRequirementsInfo{
+				.sType = VK_STRUCTURE_TYPE_DEVICE_IMAGE_MEMORY_REQUIREMENTS,
+				.pCreateInfo = &imageCreateInfo,
+			};
+			VkMemoryRequirements2 memoryRequirements{.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2};
+			vkGetDeviceImageMemoryRequirements(device, &imageRequirementsInfo, &memoryRequirements);
+			lifetimes[t] = TransientLifetime{
+				.firstPass = resource.firstPass,
+				.lastPass = resource.lastPass,
+				.requirements = memoryRequirements.memoryRequirements,
+			};
+
+			transientAllocations.push_back(TransientAllocation{
+				.description = resource.description,
+				.firstPass = resource.firstPass,
+				.lastPass = resource.lastPass,
+			});
+		}
+
+		const std::vector<TransientMemoryBlock> blocks = PlaceTransients(lifetimes);
+		for (uint32_t b = 0; b < blocks.size(); b++) {
+			for (const uint32_t t : blocks[b].occupants) {
+				transientAllocations[t].memoryBlock = b;
+			}
+		}
+
+		//the automatic usages need a buffer or image to pick a memory type for, raw memory only goes by the flags
+		constexpr VmaAllocationCreateInfo blockAllocationInfo = {
+			.requiredFlags = VkMemoryPropertyFlags{VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT},
+		};
+		for (const TransientMemoryBlock& block : blocks) {
+			VmaAllocation blockAllocation;
+			VK_CHECK(vmaAllocateMemory(allocator, &block.requirements, &blockAllocationInfo, &blockAllocation, nullptr), "Couldn't allocate transient image memory");
+			memoryTracker->Track(blockAllocation, MemoryCategory::RenderTargets);
+			memoryBlocks.push_back(blockAllocation);
+		}
+
+		for (TransientAllocation& allocation : transientAllocations) {
+			const VkImageCreateInfo imageCreateInfo = vk_init::ImageCreateInfo(allocation.description.format, allocation.description.usage, allocation.description.extent);
+			VK_CHECK(vmaCreateAliasingImage(allocator, memoryBlocks[allocation.memoryBlock], &imageCreateInfo, &allocation.image), "Couldn't create transient image");
+
+			const VkImageViewCreateInfo viewCreateInfo = vk_init::ImageViewCreateInfo(allocation.description.format, allocation.image, vk_util::AspectMaskForFormat(allocation.description.format));
+			VK_CHECK(vkCreateImageView(device, &viewCreateInfo, nullptr, &allocation.imageView), "Couldn't create transient image view");
+		}
+	}
+
+	for (size_t t = 0; t < transientIndices.size(); t++) {
+		ImageResource& resource = images[transientIndices[t]];
+		resource.image = transientAllocations[t].image;
+		resource.imageView = transientAllocations[t].imageView;
+	}
+
+	return SDL_APP_CONTINUE;
+}
+
+void RenderGraph::DestroyTransients() {
+	for (const TransientAllocation& allocation : transientAllocations) {
+		if (allocation.imageView != nullptr) vkDestroyImageView(device, allocation.imageView, nullptr);
+		if (allocation.image != nullptr) vkDestroyImage(device, allocation.image, nullptr);
+	}
+	transientAllocations.clear();
+
+	for (const VmaAllocation& memoryBlock : memoryBlocks) {
+		memoryTracker->Untrack(memoryBlock);
+		vmaFreeMemory(allocator, memoryBlock);
+	}
+	memoryBlocks.clear();
+}
+
+SDL_AppResult RenderGraph::Compile() {
+	Cull();
+	return AllocateTransients();
+}
+
+SDL_AppResult RenderGraph::Execute(const VkCommandBuffer& commandBuffer, GpuProfiler* profiler) {
+	BarrierBuilder barriers;
+
+	//what last happened to each block of transient memory, so the next image placed there waits for it
+	std::vector<ImageState> memoryBlockStates(memoryBlocks.size());
+
+	for (uint32_t p = 0; p < passes.size(); p++) {
+		RenderGraphPass& pass = passes[p];
+		if (pass.culled) continue;
+
+		for (const RenderGraphPass::ImageAccess& access : pass.imageAccesses) {
+			ImageResource& resource = images[access.image.index];
+			bool discardContents = access.discardContents;
+
+			std::optional<uint32_t> memoryBlock;
+			if (resource.transient) {
+				for (size_t t = 0; t < transientAllocations.size(); t++) {
+					if (transientAllocations[t].image == resource.image) memoryBlock = transientAllocations[t].memoryBlock;
+				}
+			}
+
+			if (memoryBlock.has_value() && resource.firstPass == p) {
+				//a transient starts out undefined, after whatever used its memory before it
+				const ImageState& previousOccupant = memoryBlockStates[memoryBlock.value()];
+				resource.transientState = ImageState{
+					.layout = VK_IMAGE_LAYOUT_UNDEFINED,
+					.stageMask = previousOccupant.stageMask,
+					.accessMask = previousOccupant.accessMask,
+				};
+				discardContents = true;
+			}
+
+			barriers.Transition(resource.image, StateOf(resource), access.usage, vk_util::AspectMaskForFormat(resource.format), discardContents);
+
+			if (memoryBlock.has_value()) {
+				memoryBlockStates[memoryBlock.value()] = resource.transientState;
+			}
+		}
+		for (const RenderGraphPass::BufferAccess& access : pass.bufferAccesses) {
+			BufferResource& resource = buffers[access.buffer.index];
+			barriers.Transition(resource.buffer, *resource.state, access.usage);
+		}
+		barriers.Flush(commandBuffer);
+
+		//after the barriers, so waiting on earlier passes doesn't count towards this one
+		const std::optional<uint32_t> scope = profiler != nullptr ? profiler->BeginScope(commandBuffer, pass.name) : std::nullopt;
+		if (const SDL_AppResult res = pass.execute(commandBuffer); res != SDL_APP_CONTINUE) {
+			SDL_Log("Render graph pass failed: %s", pass.name);
+			return res;
+		}
+		if (profiler != nullptr) {
+			profiler->EndScope(commandBuffer, scope);
+		}
+	}
+
+	for (ImageResource& resource : images) {
+		if (!resource.isOutput || resource.outputUsage == ImageUsage::Undefined) continue;
+		barriers.Transition(resource.image, StateOf(resource), resource.outputUsage, vk_util::AspectMaskForFormat(resource.format));
+	}
+	barriers.Flush(commandBuffer);
+
+	return SDL_APP_CONTINUE;
+}
+
+size_t RenderGraph::GetCulledPassCount() const {
+	return std::ranges::count_if(passes, [](const RenderGraphPass& pass) { return pass.culled; });
+}
+
+size_t RenderGraph::GetTransientMemoryBlockCount() const {
+	return memoryBlocks.size();
+}
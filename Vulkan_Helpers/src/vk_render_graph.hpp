@@ -0,0 +1,163 @@
+#pragma once
+
+#include "mass_includer.hpp"
+
+// Engine
+#include "vk_custom_types.hpp"
+#include "vk_gpu_profiler.hpp"
+#include "vk_memory.hpp"
+
+struct RenderGraphImage {
+	uint32_t index = ~0u;
+};
+
+struct RenderGraphBuffer {
+	uint32_t index = ~0u;
+};
+
+struct TransientImageDescription {
+	VkExtent3D extent;
+	VkFormat format;
+	VkImageUsageFlags usage;
+};
+
+/// A transient image to place in memory, alive from its first to its last pass.
+struct TransientLifetime {
+	uint32_t firstPass;
+	uint32_t lastPass;
+	VkMemoryRequirements requirements;
+};
+
+struct TransientMemoryBlock {
+	// covers every occupant
+	VkMemoryRequirements requirements;
+	// indices into the placed transients
+	std::vector<uint32_t> occupants;
+};
+
+/// Places the transients into memory blocks, the biggest first, each into the first block whose occupants are never
+/// alive at the same time as it, so transients with disjoint lifetimes alias the same memory.
+[[nodiscard]] std::vector<TransientMemoryBlock> PlaceTransients(std::span<const TransientLifetime> transients);
+
+class RenderGraphPass {
+	friend class RenderGraph;
+
+	struct ImageAccess {
+		RenderGraphImage image;
+		ImageUsage usage;
+		bool writes;
+		bool discardContents;
+	};
+
+	struct BufferAccess {
+		RenderGraphBuffer buffer;
+		BufferUsage usage;
+		bool writes;
+	};
+
+	const char* name;
+	std::function<SDL_AppResult(const VkCommandBuffer& commandBuffer)> execute;
+	std::vector<ImageAccess> imageAccesses;
+	std::vector<BufferAccess> bufferAccesses;
+	bool hasSideEffects = false;
+	bool culled = false;
+
+public:
+	RenderGraphPass(const char* name, std::function<SDL_AppResult(const VkCommandBuffer& commandBuffer)>&& execute);
+
+	RenderGraphPass& Read(RenderGraphImage image, ImageUsage usage);
+	/// @param discardContents The pass overwrites the whole image, so earlier writes to it aren't needed.
+	RenderGraphPass& Write(RenderGraphImage image, ImageUsage usage, bool discardContents = false);
+	RenderGraphPass& Read(RenderGraphBuffer buffer, BufferUsage usage);
+	RenderGraphPass& Write(RenderGraphBuffer buffer, BufferUsage usage);
+	/// Keeps the pass even when nothing reads what it writes (e.g. readbacks to the CPU).
+	RenderGraphPass& SideEffects();
+};
+
+/// Per-frame graph of passes and the images and buffers they read and write.
+/// Passes run in the order they were added, which is a valid order by construction since a pass can only depend on earlier ones.
+/// Passes whose writes are never read and don't reach an output are culled, barriers between passes are generated from the declared usages,
+/// and transient images whose lifetimes don't overlap share memory.
+class RenderGraph {
+	struct ImageResource {
+		const char* name;
+		VkImage image = nullptr;
+		VkImageView imageView = nullptr;
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		VkExtent3D extent = {};
+		ImageState* importedState = nullptr;
+
+		bool transient = false;
+		TransientImageDescription description = {};
+		ImageState transientState = {};
+		uint32_t firstPass = ~0u;
+		uint32_t lastPass = 0;
+
+		bool isOutput = false;
+		ImageUsage outputUsage = ImageUsage::Undefined;
+	};
+
+	struct BufferResource {
+		const char* name;
+		VkBuffer buffer = nullptr;
+		BufferState* state = nullptr;
+		bool isOutput = false;
+	};
+
+	struct TransientAllocation {
+		TransientImageDescription description;
+		uint32_t firstPass;
+		uint32_t lastPass;
+		uint32_t memoryBlock;
+		VkImage image;
+		VkImageView imageView;
+	};
+
+	VkDevice device = nullptr;
+	VmaAllocator allocator = nullptr;
+	MemoryTracker* memoryTracker = nullptr;
+
+	std::deque<RenderGraphPass> passes;
+	std::vector<ImageResource> images;
+	std::vector<BufferResource> buffers;
+
+	// physical transient images, kept between frames as long as the transients and their lifetimes stay the same
+	std::vector<TransientAllocation> transientAllocations;
+	std::vector<VmaAllocation> memoryBlocks;
+
+	[[nodiscard]] ImageState& StateOf(ImageResource& resource);
+	void Cull();
+	[[nodiscard]] SDL_AppResult AllocateTransients();
+	void DestroyTransients();
+
+public:
+	void Init(const VkDevice& device, const VmaAllocator& allocator, MemoryTracker& memoryTracker);
+	void Destroy();
+
+	/// Clears the passes and resources of the previous frame. Transient memory is kept for reuse.
+	void Reset();
+
+	[[nodiscard]] RenderGraphImage ImportImage(const char* name, AllocatedImage& image);
+	[[nodiscard]] RenderGraphImage ImportImage(const char* name, const VkImage& image, const VkImageView& imageView, ImageState& state, VkFormat format, VkExtent3D extent);
+	[[nodiscard]] RenderGraphImage CreateImage(const char* name, const TransientImageDescription& description);
+	[[nodiscard]] RenderGraphBuffer ImportBuffer(const char* name, AllocatedBuffer& buffer);
+
+	/// Marks the image as a result of the frame. It is transitioned to the given usage after the last pass.
+	void MarkOutput(RenderGraphImage image, ImageUsage finalUsage);
+	void MarkOutput(RenderGraphBuffer buffer);
+
+	RenderGraphPass& AddPass(const char* name, std::function<SDL_AppResult(const VkCommandBuffer& commandBuffer)>&& execute);
+
+	/// Only valid once the graph is compiled, for transient images.
+	[[nodiscard]] VkImageView GetImageView(RenderGraphImage image) const;
+	[[nodiscard]] VkImage GetImage(RenderGraphImage image) const;
+
+	/// Culls unused passes and places the transient images in memory.
+	[[nodiscard]] SDL_AppResult Compile();
+	/// Records all passes that survived culling, with the barriers between them.
+	/// @param profiler If set, every pass is timed as a scope named after it.
+	[[nodiscard]] SDL_AppResult Execute(const VkCommandBuffer& commandBuffer, GpuProfiler* profiler = nullptr);
+
+	[[nodiscard]] size_t GetCulledPassCount() const;
+	[[nodiscard]] size_t GetTransientMemoryBlockCount() const;
+};
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "mass_includer.hpp"
+
+/// 32-bit handle to a resource in a ResourcePool. The low bits index a slot, the high bits hold the generation the slot had
+/// when the handle was made. Once the resource is released the slot's generation moves on, so the handle stops resolving
+/// instead of resolving to whatever reuses the slot.
+template <typename T>
+struct Handle {
+	static constexpr uint32_t indexBits = 20;
+	static constexpr uint32_t indexMask = (1u << indexBits) - 1;
+	static constexpr uint32_t maxGeneration = (1u << (32 - indexBits)) - 1;
+
+	// generations start at 1, so the default handle never resolves
+	uint32_t value = 0;
+
+	[[nodiscard]] uint32_t Index() const { return value & indexMask; }
+	[[nodiscard]] uint32_t Generation() const { return value >> indexBits; }
+	[[nodiscard]] bool IsNull() const { return value == 0; }
+
+	bool operator==(const Handle& other) const = default;
+};
+
+/// Dense storage for resources of one type, addressed by generational handles.
+/// The resources are packed into one array without gaps, so going over all of them is a linear walk, and a slot table
+/// maps a handle to its position in that array in O(1). Released resources are kept until the frame timeline shows
+/// the GPU is done with them.
+template <typename T>
+class ResourcePool {
+	struct Slot {
+		uint32_t densePosition = 0;
+		uint32_t generation = 1;
+	};
+
+	std::vector<T> resources;
+	// slot of every resource in the dense array
+	std::vector<uint32_t> resourceSlots;
+	std::vector<Slot> slots;
+	std::vector<uint32_t> freeSlots;
+	// released resources with the timeline value after which the GPU no longer uses them, in increasing order
+	std::deque<std::pair<uint64_t, T>> releasedResources;
+
+public:
+	[[nodiscard]] Handle<T> Add(T resource) {
+		uint32_t slotIndex;
+		if (!freeSlots.empty()) {
+			slotIndex = freeSlots.back();
+			freeSlots.pop_back();
+		} else {
+			slotIndex = static_cast<uint32_t>(slots.size());
+			SDL_assert(slotIndex <= Handle<T>::indexMask);
+			slots.emplace_back();
+		}
+
+		Slot& slot = slots[slotIndex];
+		slot.densePosition = static_cast<uint32_t>(resources.size());
+		resources.push_back(std::move(resource));
+		resourceSlots.push_back(slotIndex);
+		return Handle<T>{slot.generation << Handle<T>::indexBits | slotIndex};
+	}
+
+	/// @return nullptr for a null handle or one whose resource was released.
+	[[nodiscard]] T* Get(const Handle<T> handle) {
+		if (handle.Index() >= slots.size()) return nullptr;
+		const Slot& slot = slots[handle.Index()];
+		return slot.generation == handle.Generation() ? &resources[slot.densePosition] : nullptr;
+	}
+
+	[[nodiscard]] const T* Get(const Handle<T> handle) const {
+		return const_cast<ResourcePool*>(this)->Get(handle);
+	}
+
+	/// Invalidates the handle right away, the resource itself is handed to the destroy function passed to Collect
+	/// once the frame timeline reaches timelineValue.
+	void Release(const Handle<T> handle, const uint64_t timelineValue) {
+		if (Get(handle) == nullptr) {
+			SDL_Log("Released a stale resource handle");
+			return;
+		}
+
+		Slot& slot = slots[handle.Index()];
+		const uint32_t position = slot.densePosition;
+		//kept sorted, as a resource may be released further ahead than ones released after it
+		const auto releasedPosition = std::ranges::upper_bound(releasedResources, timelineValue, std::ranges::less{}, [](const auto& released) { return released.first; });
+		releasedResources.emplace(releasedPosition, timelineValue, std::move(resources[position]));
+
+		//the last resource fills the gap, so the array stays dense
+		const uint32_t lastPosition = static_cast<uint32_t>(resources.size() - 1);
+		if (position != lastPosition) {
+			resources[position] = std::move(resources[lastPosition]);
+			resourceSlots[position] = resourceSlots[lastPosition];
+			slots[resourceSlots[position]].densePosition = position;
+		}
+		resources.pop_back();
+		resourceSlots.pop_back();
+
+		//a slot that used up its generations is retired for good, rather than risk an old handle resolving again
+		slot.generation++;
+		if (slot.generation <= Handle<T>::maxGeneration) {
+			freeSlots.push_back(handle.Index());
+		}
+	}
+
+	/// Destroys the released resources the GPU is done with.
+	template <typename Destroy>
+	void Collect(const uint64_t completedTimelineValue, Destroy&& destroy) {
+		while (!releasedResources.empty() && releasedResources.front().first <= completedTimelineValue) {
+			destroy(releasedResources.front().second);
+			releasedResources.pop_front();
+		}
+	}
+
+	/// Destroys every resource, live or released, for when the GPU is idle. Invalidates all handles.
+	template <typename Destroy>
+	void Clear(Destroy&& destroy) {
+		for (T& resource : resources) {
+			destroy(resource);
+		}
+		for (auto& [timelineValue, resource] : releasedResources) {
+			destroy(resource);
+		}
+		for (Slot& slot : slots) {
+			slot.generation++;
+		}
+		resources.clear();
+		resourceSlots.clear();
+		releasedResources.clear();
+		freeSlots.clear();
+		for (uint32_t i = 0; i < slots.size(); i++) {
+			if (slots[i].generation <= Handle<T>::maxGeneration) {
+				freeSlots.push_back(i);
+			}
+		}
+	}
+
+	/// All live resources, in no particular order.
+	[[nodiscard]] std::span<T> GetAll() { return resources; }
+	[[nodiscard]] std::span<const T> GetAll() const { return resources; }
+	[[nodiscard]] size_t GetSize() const { return resources.size(); }
+};
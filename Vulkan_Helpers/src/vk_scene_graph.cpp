@@ -0,0 +1,314 @@
+// Impl
+#include "vk_scene_graph.hpp"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define SCENE_GRAPH_SSE 1
+#else
+#define SCENE_GRAPH_SSE 0
+#endif
+
+math::float4x4 vk_util::IdentityMatrix() {
+	math::float4x4 matrix;
+	for (int row = 0; row < 4; row++) {
+		for (int column = 0; column < 4; column++) {
+			matrix[row][column] = row == column ? 1.0f : 0.0f;
+		}
+	}
+	return matrix;
+}
+
+//matrix[i] is what the shaders see as column i, see TranslationScaleMatrix
+math::float4x4 vk_util::MultiplyMatrices(const math::float4x4& a, const math::float4x4& b) {
+	math::float4x4 result;
+#if SCENE_GRAPH_SSE
+	const __m128 a0 = _mm_loadu_ps(&a[0][0]);
+	const __m128 a1 = _mm_loadu_ps(&a[1][0]);
+	const __m128 a2 = _mm_loadu_ps(&a[2][0]);
+	const __m128 a3 = _mm_loadu_ps(&a[3][0]);
+	for (int column = 0; column < 4; column++) {
+		__m128 sum = _mm_mul_ps(a0, _mm_set1_ps(b[column][0]));
+		sum = _mm_add_ps(sum, _mm_mul_ps(a1, _mm_set1_ps(b[column][1])));
+		sum = _mm_add_ps(sum, _mm_mul_ps(a2, _mm_set1_ps(b[column][2])));
+		sum = _mm_add_ps(sum, _mm_mul_ps(a3, _mm_set1_ps(b[column][3])));
+		_mm_storeu_ps(&result[column][0], sum);
+	}
+#else
+	for (int column = 0; column < 4; column++) {
+		for (int row = 0; row < 4; row++) {
+			result[column][row] = a[0][row] * b[column][0] + a[1][row] * b[column][1] + a[2][row] * b[column][2] + a[3][row] * b[column][3];
+		}
+	}
+#endif
+	return result;
+}
+
+math::float4x4 vk_util::TrsMatrix(const math::float3& translation, const math::float4& rotation, const math::float3& scale) {
+	const float x = rotation.x;
+	const float y = rotation.y;
+	const float z = rotation.z;
+	const float w = rotation.w;
+
+	math::float4x4 matrix;
+	matrix[0][0] = (1.0f - 2.0f * (y * y + z * z)) * scale.x;
+	matrix[0][1] = 2.0f * (x * y + w * z) * scale.x;
+	matrix[0][2] = 2.0f * (x * z - w * y) * scale.x;
+	matrix[0][3] = 0.0f;
+	matrix[1][0] = 2.0f * (x * y - w * z) * scale.y;
+	matrix[1][1] = (1.0f - 2.0f * (x * x + z * z)) * scale.y;
+	matrix[1][2] = 2.0f * (y * z + w * x) * scale.y;
+	matrix[1][3] = 0.0f;
+	matrix[2][0] = 2.0f * (x * z + w * y) * scale.z;
+	matrix[2][1] = 2.0f * (y * z - w * x) * scale.z;
+	matrix[2][2] = (1.0f - 2.0f * (x * x + y * y)) * scale.z;
+	matrix[2][3] = 0.0f;
+	matrix[3][0] = translation.x;
+	matrix[3][1] = translation.y;
+	matrix[3][2] = translation.z;
+	matrix[3][3] = 1.0f;
+	return matrix;
+}
+
+math::float3 vk_util::TransformPoint(const math::float4x4& matrix, const math::float3& point) {
+	return math::float3(
+		matrix[0][0] * point.x + matrix[1][0] * point.y + matrix[2][0] * point.z + matrix[3][0],
+		matrix[0][1] * point.x + matrix[1][1] * point.y + matrix[2][1] * point.z + matrix[3][1],
+		matrix[0][2] * point.x + matrix[1][2] * point.y + matrix[2][2] * point.z + matrix[3][2]);
+}
+
+float vk_util::MaxScale(const math::float4x4& matrix) {
+	float maxLengthSquared = 0.0f;
+	for (int column = 0; column < 3; column++) {
+		maxLengthSquared = std::max(maxLengthSquared, matrix[column][0] * matrix[column][0] + matrix[column][1] * matrix[column][1] + matrix[column][2] * matrix[column][2]);
+	}
+	return std::sqrt(maxLengthSquared);
+}
+
+void SceneGraph::Clear() {
+	parents.clear();
+	subtreeEnds.clear();
+	translations.clear();
+	rotations.clear();
+	scales.clear();
+	worldMatrices.clear();
+	names.clear();
+	meshOffsets.assign(1, 0);
+	meshIndices.clear();
+	dirtyNodes.clear();
+	dirty.clear();
+	lastUpdatedCount = 0;
+}
+
+void SceneGraph::Import(const aiNode* root, const uint32_t parent) {
+	aiVector3D scale;
+	aiQuaternion rotation;
+	aiVector3D translation;
+	root->mTransformation.Decompose(scale, rotation, translation);
+
+	const uint32_t node = AddNode(parent, root->mName.C_Str(),
+		math::float3(translation.x, translation.y, translation.z),
+		math::float4(rotation.x, rotation.y, rotation.z, rotation.w),
+		math::float3(scale.x, scale.y, scale.z),
+		std::span<const uint32_t>(root->mMeshes, root->mNumMeshes));
+
+	//children are added right after their parent's subtree so far, which keeps the order depth-first
+	for (unsigned int i = 0; i < root->mNumChildren; i++) {
+		Import(root->mChildren[i], node);
+	}
+}
+
+uint32_t SceneGraph::AddNode(const uint32_t parent, std::string name, const math::float3& translation, const math::float4& rotation, const math::float3& scale, const std::span<const uint32_t> meshes) {
+	const uint32_t node = GetNodeCount();
+	SDL_assert(parent == noParent || (parent < node && subtreeEnds[parent] == node));
+
+	parents.push_back(parent);
+	subtreeEnds.push_back(node + 1);
+	translations.push_back(translation);
+	rotations.push_back(rotation);
+	scales.push_back(scale);
+	worldMatrices.push_back(vk_util::IdentityMatrix());
+	names.push_back(std::move(name));
+	meshIndices.insert(meshIndices.end(), meshes.begin(), meshes.end());
+	meshOffsets.push_back(static_cast<uint32_t>(meshIndices.size()));
+	dirty.push_back(0);
+
+	//every ancestor's subtree now ends after the new node
+	for (uint32_t ancestor = parent; ancestor != noParent; ancestor = parents[ancestor]) {
+		subtreeEnds[ancestor] = node + 1;
+	}
+
+	MarkDirty(node);
+	return node;
+}
+
+void SceneGraph::MarkDirty(const uint32_t node) {
+	if (dirty[node] != 0) return;
+	dirty[node] = 1;
+	dirtyNodes.push_back(node);
+}
+
+void SceneGraph::SetLocalTransform(const uint32_t node, const math::float3& translation, const math::float4& rotation, const math::float3& scale) {
+	translations[node] = translation;
+	rotations[node] = rotation;
+	scales[node] = scale;
+	MarkDirty(node);
+}
+
+void SceneGraph::SetRotation(const uint32_t node, const math::float4& rotation) {
+	rotations[node] = rotation;
+	MarkDirty(node);
+}
+
+void SceneGraph::MarkAllDirty() {
+	//the roots cover everything below them
+	for (uint32_t node = 0; node < GetNodeCount(); node = subtreeEnds[node]) {
+		MarkDirty(node);
+	}
+}
+
+std::span<const uint32_t> SceneGraph::GetMeshes(const uint32_t node) const {
+	return std::span(meshIndices).subspan(meshOffsets[node], meshOffsets[node + 1] - meshOffsets[node]);
+}
+
+std::optional<uint32_t> SceneGraph::FindMeshNode(const uint32_t meshIndex) const {
+	for (uint32_t node = 0; node < GetNodeCount(); node++) {
+		if (std::ranges::find(GetMeshes(node), meshIndex) != GetMeshes(node).end()) {
+			return node;
+		}
+	}
+	return std::nullopt;
+}
+
+void SceneGraph::UpdateRange(const uint32_t first, const uint32_t end) {
+	//a parent is either earlier in the range or outside of it and already up to date
+	for (uint32_t node = first; node < end; node++) {
+		const math::float4x4 local = vk_util::TrsMatrix(translations[node], rotations[node], scales[node]);
+		worldMatrices[node] = parents[node] == noParent ? local : vk_util::MultiplyMatrices(worldMatrices[parents[node]], local);
+	}
+}
+
+void SceneGraph::UpdateWorldMatrices(JobPool& jobPool) {
+	lastUpdatedCount = 0;
+	updateRanges.clear();
+	if (dirtyNodes.empty()) return;
+
+	//a changed node inside a subtree that is updated anyway adds nothing
+	std::ranges::sort(dirtyNodes);
+	for (const uint32_t node : dirtyNodes) {
+		dirty[node] = 0;
+		if (!updateRanges.empty() && node < updateRanges.back().second) continue;
+		updateRanges.emplace_back(node, subtreeEnds[node]);
+	}
+	dirtyNodes.clear();
+
+	//split the largest subtrees into their children until there are a few jobs per thread,
+	//the root of a split subtree is updated here so its children can start from it
+	const size_t targetRangeCount = static_cast<size_t>(jobPool.GetThreadCount()) * 4;
+	while (jobPool.GetThreadCount() > 1 && updateRanges.size() < targetRangeCount) {
+		const auto largest = std::ranges::max_element(updateRanges, {}, [](const std::pair<uint32_t, uint32_t>& range) { return range.second - range.first; });
+		const auto [first, end] = *largest;
+		if (end - first <= minJobNodes) break;
+
+		UpdateRange(first, first + 1);
+		lastUpdatedCount++;
+		std::vector<std::pair<uint32_t, uint32_t>> children;
+		for (uint32_t child = first + 1; child < end; child = subtreeEnds[child]) {
+			children.emplace_back(child, subtreeEnds[child]);
+		}
+		updateRanges.erase(largest);
+		updateRanges.insert(updateRanges.end(), children.begin(), children.end());
+	}
+
+	jobPool.ParallelFor(static_cast<uint32_t>(updateRanges.size()), [&](const uint32_t i) {
+		UpdateRange(updateRanges[i].first, updateRanges[i].second);
+	});
+	for (const auto& [first, end] : updateRanges) {
+		lastUpdatedCount += end - first;
+	}
+}
+
+std::vector<SceneGraphBenchmarkResult> vk_util::RunSceneGraphBenchmark(JobPool& jobPool) {
+	constexpr uint32_t fanOut = 8;
+	constexpr uint32_t maxDepth = 7;
+	//about what a few characters walking around would change per frame in a large scene
+	constexpr float changedFraction = 0.01f;
+	constexpr double nanosecondsToMilliseconds = 1.0 / 1'000'000.0;
+
+	//a fixed seed, so every run changes the same nodes
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> angleDistribution(-3.14159265f, 3.14159265f);
+	std::uniform_real_distribution<float> offsetDistribution(-1.0f, 1.0f);
+	const auto randomRotation = [&] {
+		const float halfAngle = angleDistribution(random) * 0.5f;
+		return math::float4(0.0f, std::sin(halfAngle), 0.0f, std::cos(halfAngle));
+	};
+
+	std::vector<SceneGraphBenchmarkResult> results;
+	for (const uint32_t nodeCount : sceneGraphBenchmarkNodeCounts) {
+		SceneGraph sceneGraph;
+		//depth first, so the tree fills up from its first branches until the node budget runs out
+		const std::function<void(uint32_t, uint32_t)> addChildren = [&](const uint32_t parent, const uint32_t depth) {
+			for (uint32_t i = 0; i < fanOut && sceneGraph.GetNodeCount() < nodeCount; i++) {
+				const uint32_t node = sceneGraph.AddNode(parent, {}, math::float3(offsetDistribution(random), offsetDistribution(random), offsetDistribution(random)), randomRotation(), math::float3(1.0f, 1.0f, 1.0f));
+				if (depth + 1 < maxDepth) {
+					addChildren(node, depth + 1);
+				}
+			}
+		};
+		const uint32_t root = sceneGraph.AddNode(SceneGraph::noParent, "root", math::float3(0.0f, 0.0f, 0.0f), math::float4(0.0f, 0.0f, 0.0f, 1.0f), math::float3(1.0f, 1.0f, 1.0f));
+		while (sceneGraph.GetNodeCount() < nodeCount) {
+			addChildren(root, 0);
+		}
+		sceneGraph.UpdateWorldMatrices(jobPool);
+
+		SceneGraphBenchmarkResult result{.nodeCount = sceneGraph.GetNodeCount()};
+
+		sceneGraph.MarkAllDirty();
+		uint64_t start = SDL_GetTicksNS();
+		sceneGraph.UpdateWorldMatrices(jobPool);
+		result.fullUpdateTime = static_cast<double>(SDL_GetTicksNS() - start) * nanosecondsToMilliseconds;
+
+		std::uniform_int_distribution<uint32_t> nodeDistribution(1, result.nodeCount - 1);
+		result.changedCount = std::max(static_cast<uint32_t>(static_cast<float>(result.nodeCount) * changedFraction), 1u);
+		for (uint32_t i = 0; i < result.changedCount; i++) {
+			sceneGraph.SetRotation(nodeDistribution(random), randomRotation());
+		}
+		start = SDL_GetTicksNS();
+		sceneGraph.UpdateWorldMatrices(jobPool);
+		result.partialUpdateTime = static_cast<double>(SDL_GetTicksNS() - start) * nanosecondsToMilliseconds;
+		result.partialUpdatedCount = sceneGraph.GetLastUpdatedCount();
+
+		SDL_Log("Scene graph with %u nodes on %u threads: full update %.3f ms, %u changed nodes updated %u nodes in %.3f ms",
+			result.nodeCount, jobPool.GetThreadCount(), result.fullUpdateTime, result.changedCount, result.partialUpdatedCount, result.partialUpdateTime);
+		results.push_back(result);
+	}
+
+	return results;
+}
+
+void vk_util::DrawSceneGraphBenchmarkTable(const std::span<const SceneGraphBenchmarkResult> results) {
+	if (!ImGui::BeginTable("Scene Graph Benchmark Results", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) return;
+
+	ImGui::TableSetupColumn("Nodes");
+	ImGui::TableSetupColumn("Full ms");
+	ImGui::TableSetupColumn("Changed");
+	ImGui::TableSetupColumn("Updated");
+	ImGui::TableSetupColumn("Partial ms");
+	ImGui::TableHeadersRow();
+
+	for (const SceneGraphBenchmarkResult& result : results) {
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::Text("%u", result.nodeCount);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", result.fullUpdateTime);
+		ImGui::TableNextColumn();
+		ImGui::Text("%u", result.changedCount);
+		ImGui::TableNextColumn();
+		ImGui::Text("%u", result.partialUpdatedCount);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", result.partialUpdateTime);
+	}
+
+	ImGui::EndTable();
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "mass_includer.hpp"
+
+// Engine
+#include "vk_job_pool.hpp"
+
+namespace vk_util {
+	[[nodiscard]] math::float4x4 IdentityMatrix();
+	/// a * b in the order the shaders multiply, so b is applied first. Four columns at a time with SSE where available.
+	[[nodiscard]] math::float4x4 MultiplyMatrices(const math::float4x4& a, const math::float4x4& b);
+	/// Scales, then rotates by the quaternion (xyz vector part, w scalar part), then translates.
+	[[nodiscard]] math::float4x4 TrsMatrix(const math::float3& translation, const math::float4& rotation, const math::float3& scale);
+	[[nodiscard]] math::float3 TransformPoint(const math::float4x4& matrix, const math::float3& point);
+	/// Largest scale along any axis, to keep bounding spheres conservative under non-uniform scaling.
+	[[nodiscard]] float MaxScale(const math::float4x4& matrix);
+}
+
+/// Transform hierarchy stored as flat arrays with one entry per node, in depth-first order.
+/// Parents come before their children and every subtree is one contiguous range, so an update only scans forward
+/// through the subtrees below nodes whose local transform changed, and separate subtrees update in parallel.
+class SceneGraph {
+	std::vector<uint32_t> parents;
+	// one past the last node of the subtree
+	std::vector<uint32_t> subtreeEnds;
+	std::vector<math::float3> translations;
+	std::vector<math::float4> rotations;
+	std::vector<math::float3> scales;
+	std::vector<math::float4x4> worldMatrices;
+	std::vector<std::string> names;
+	// the meshes of node i are meshIndices[meshOffsets[i]] up to meshIndices[meshOffsets[i + 1]]
+	std::vector<uint32_t> meshOffsets{0};
+	std::vector<uint32_t> meshIndices;
+
+	// nodes whose local transform changed since the last update, each listed once
+	std::vector<uint32_t> dirtyNodes;
+	std::vector<uint8_t> dirty;
+	// first and one past the last node of every subtree the last update recomputed
+	std::vector<std::pair<uint32_t, uint32_t>> updateRanges;
+	uint32_t lastUpdatedCount = 0;
+
+	void MarkDirty(uint32_t node);
+	void UpdateRange(uint32_t first, uint32_t end);
+
+public:
+	static constexpr uint32_t noParent = std::numeric_limits<uint32_t>::max();
+	/// Subtrees smaller than this aren't split into separate jobs.
+	static constexpr uint32_t minJobNodes = 256;
+
+	void Clear();
+	/// Appends the Assimp hierarchy below root, depth first, with root as a child of parent.
+	void Import(const aiNode* root, uint32_t parent = noParent);
+	/// Appends a node. The parent has to be the most recently added node or one of its ancestors, so subtrees stay contiguous.
+	uint32_t AddNode(uint32_t parent, std::string name, const math::float3& translation, const math::float4& rotation, const math::float3& scale, std::span<const uint32_t> meshes = {});
+
+	void SetLocalTransform(uint32_t node, const math::float3& translation, const math::float4& rotation, const math::float3& scale);
+	void SetRotation(uint32_t node, const math::float4& rotation);
+	/// Marks every node for an update, e.g. to measure a full update.
+	void MarkAllDirty();
+	/// Recomputes the world matrices of the changed nodes and everything below them.
+	void UpdateWorldMatrices(JobPool& jobPool);
+
+	[[nodiscard]] uint32_t GetNodeCount() const { return static_cast<uint32_t>(parents.size()); }
+	[[nodiscard]] uint32_t GetParent(const uint32_t node) const { return parents[node]; }
+	[[nodiscard]] const std::string& GetName(const uint32_t node) const { return names[node]; }
+	[[nodiscard]] const math::float4x4& GetWorldMatrix(const uint32_t node) const { return worldMatrices[node]; }
+	[[nodiscard]] std::span<const uint32_t> GetMeshes(uint32_t node) const;
+	/// @return The first node in depth-first order that draws the given mesh.
+	[[nodiscard]] std::optional<uint32_t> FindMeshNode(uint32_t meshIndex) const;
+	/// Nodes whose world matrix the last update recomputed.
+	[[nodiscard]] uint32_t GetLastUpdatedCount() const { return lastUpdatedCount; }
+};
+
+struct SceneGraphBenchmarkResult {
+	uint32_t nodeCount = 0;
+	double fullUpdateTime = 0.0;
+	uint32_t changedCount = 0;
+	uint32_t partialUpdatedCount = 0;
+	double partialUpdateTime = 0.0;
+};
+
+namespace vk_util {
+	/// Node counts the scene graph benchmark runs with.
+	inline constexpr std::array sceneGraphBenchmarkNodeCounts = {10'000u, 100'000u, 1'000'000u};
+
+	/// Builds a random hierarchy for every benchmark node count, then times a full update and an update after rotating a small fraction of the nodes.
+	/// Times are in milliseconds.
+	[[nodiscard]] std::vector<SceneGraphBenchmarkResult> RunSceneGraphBenchmark(JobPool& jobPool);
+	void DrawSceneGraphBenchmarkTable(std::span<const SceneGraphBenchmarkResult> results);
+}
@@ -0,0 +1,140 @@
+// Impl
+#include "vk_trace.hpp"
+
+Tracer::ThreadBuffer& Tracer::GetThreadBuffer() {
+	//the owner is checked as well, so a thread that outlives a tracer doesn't write into the next one's buffers
+	thread_local const Tracer* bufferOwner = nullptr;
+	thread_local ThreadBuffer* buffer = nullptr;
+	if (bufferOwner == this) return *buffer;
+
+	std::scoped_lock lock(threadBuffersMutex);
+	ThreadBuffer& newBuffer = *threadBuffers.emplace_back(std::make_unique<ThreadBuffer>());
+	newBuffer.threadId = static_cast<uint32_t>(threadBuffers.size());
+	newBuffer.threadName = "Thread " + std::to_string(newBuffer.threadId);
+
+	bufferOwner = this;
+	buffer = &newBuffer;
+	return newBuffer;
+}
+
+void Tracer::Append(const Event& event) {
+	ThreadBuffer& buffer = GetThreadBuffer();
+
+	//the buffer of the previous capture is only read before the next one starts, so it can be emptied without a lock
+	const uint32_t capture = currentCapture.load(std::memory_order_acquire);
+	if (buffer.capture.load(std::memory_order_relaxed) != capture) {
+		buffer.eventCount.store(0, std::memory_order_relaxed);
+		buffer.droppedEventCount.store(0, std::memory_order_relaxed);
+		buffer.capture.store(capture, std::memory_order_release);
+	}
+
+	const uint32_t eventCount = buffer.eventCount.load(std::memory_order_relaxed);
+	if (eventCount == eventsPerThread) {
+		buffer.droppedEventCount.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	if (buffer.events == nullptr) {
+		buffer.events = std::make_unique<Event[]>(eventsPerThread);
+	}
+	buffer.events[eventCount] = event;
+	buffer.eventCount.store(eventCount + 1, std::memory_order_release);
+}
+
+void Tracer::SetThreadName(const char* name) {
+	ThreadBuffer& buffer = GetThreadBuffer();
+	std::scoped_lock lock(threadBuffersMutex);
+	buffer.threadName = name;
+}
+
+void Tracer::BeginCapture(const uint32_t frameCount, const std::filesystem::path& path) {
+	if (IsCapturing() || frameCount == 0) return;
+
+	outputPath = path;
+	framesLeft = frameCount;
+	captureStartTime = SDL_GetTicksNS();
+	currentCapture.fetch_add(1, std::memory_order_release);
+	capturing.store(true, std::memory_order_release);
+}
+
+void Tracer::EndFrame() {
+	if (!IsCapturing()) return;
+
+	if (--framesLeft == 0) {
+		capturing.store(false, std::memory_order_release);
+		WriteTrace();
+	}
+}
+
+void Tracer::RecordCpu(const char* name, const uint64_t startTime, const uint64_t endTime) {
+	if (!IsCapturing()) return;
+
+	Append(Event{.name = name, .startTime = startTime, .endTime = endTime, .gpu = false});
+}
+
+void Tracer::RecordGpu(const char* name, const uint64_t startTime, const uint64_t endTime) {
+	if (!IsCapturing()) return;
+
+	Append(Event{.name = name, .startTime = startTime, .endTime = endTime, .gpu = true});
+}
+
+void Tracer::WriteTrace() {
+	std::ofstream file(outputPath, std::ios::trunc);
+	if (!file.is_open()) {
+		SDL_Log("Couldn't write trace: %s", outputPath.string().c_str());
+		return;
+	}
+
+	//microseconds with nanosecond precision, the default precision would round away most of a long capture's timestamps
+	file << std::fixed;
+	file.precision(3);
+	const auto toMicroseconds = [](const uint64_t nanoseconds) { return static_cast<double>(nanoseconds) / 1'000.0; };
+
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	file << R"({"name":"thread_name","ph":"M","pid":0,"tid":0,"args":{"name":"GPU"}})";
+
+	const uint32_t capture = currentCapture.load(std::memory_order_relaxed);
+	size_t writtenEventCount = 0;
+	size_t droppedEventCount = 0;
+
+	std::scoped_lock lock(threadBuffersMutex);
+	for (const std::unique_ptr<ThreadBuffer>& buffer : threadBuffers) {
+		if (buffer->capture.load(std::memory_order_acquire) != capture) continue;
+
+		file << ",\n" << R"({"name":"thread_name","ph":"M","pid":0,"tid":)" << buffer->threadId
+		     << R"(,"args":{"name":")" << buffer->threadName << "\"}}";
+
+		const uint32_t eventCount = buffer->eventCount.load(std::memory_order_acquire);
+		droppedEventCount += buffer->droppedEventCount.load(std::memory_order_relaxed);
+		for (uint32_t i = 0; i < eventCount; i++) {
+			const Event& event = buffer->events[i];
+			//GPU scopes read during the capture can belong to frames submitted before it
+			if (event.startTime < captureStartTime || event.endTime < event.startTime) continue;
+
+			file << ",\n" << R"({"name":")" << event.name << R"(","cat":")" << (event.gpu ? "gpu" : "cpu")
+			     << R"(","ph":"X","pid":0,"tid":)" << (event.gpu ? 0 : buffer->threadId)
+			     << R"(,"ts":)" << toMicroseconds(event.startTime - captureStartTime)
+			     << R"(,"dur":)" << toMicroseconds(event.endTime - event.startTime) << "}";
+			writtenEventCount++;
+		}
+	}
+
+	file << "\n]}\n";
+
+	if (droppedEventCount > 0) {
+		SDL_Log("Trace buffers were full, dropped %zu events", droppedEventCount);
+	}
+	SDL_Log("Wrote %zu trace events to %s", writtenEventCount, outputPath.string().c_str());
+}
+
+TraceScope::TraceScope(Tracer& tracer, const char* name) : tracer(tracer), name(name) {
+	if (tracer.IsCapturing()) {
+		startTime = SDL_GetTicksNS();
+	}
+}
+
+TraceScope::~TraceScope() {
+	if (startTime != 0) {
+		tracer.RecordCpu(name, startTime, SDL_GetTicksNS());
+	}
+}
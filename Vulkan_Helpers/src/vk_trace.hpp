@@ -0,0 +1,79 @@
+#pragma once
+
+#include "mass_includer.hpp"
+
+/// Records CPU scopes of every thread, plus GPU scopes on a track of their own, for a number of frames and writes them
+/// as a Chrome trace, which chrome://tracing and ui.perfetto.dev open. Every thread appends to a buffer only it writes,
+/// so recording takes no locks, and outside of a capture a scope costs a single atomic load.
+class Tracer {
+	struct Event {
+		// a string literal, so it stays valid until the trace is written
+		const char* name;
+		// SDL_GetTicksNS clock
+		uint64_t startTime;
+		uint64_t endTime;
+		bool gpu;
+	};
+
+	struct ThreadBuffer {
+		std::string threadName;
+		// 0 is the GPU track
+		uint32_t threadId = 0;
+		// allocated by the owning thread on its first event
+		std::unique_ptr<Event[]> events;
+		// capture the events belong to, the owning thread empties its buffer on the first event of a new capture
+		std::atomic<uint32_t> capture = 0;
+		// published with release by the owning thread, so the events before it can be read by the thread writing the trace
+		std::atomic<uint32_t> eventCount = 0;
+		std::atomic<uint32_t> droppedEventCount = 0;
+	};
+
+	// only grows, the buffers stay alive as long as the tracer since their threads keep pointers to them
+	std::mutex threadBuffersMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> threadBuffers;
+
+	std::atomic<bool> capturing = false;
+	std::atomic<uint32_t> currentCapture = 0;
+	// owned by the thread that calls BeginCapture and EndFrame
+	uint64_t captureStartTime = 0;
+	uint32_t framesLeft = 0;
+	std::filesystem::path outputPath;
+
+	/// Registers the calling thread the first time it is called on it.
+	[[nodiscard]] ThreadBuffer& GetThreadBuffer();
+	void Append(const Event& event);
+	void WriteTrace();
+
+public:
+	static constexpr uint32_t eventsPerThread = 1 << 16;
+
+	/// Names the calling thread in traces, threads without a name show up by their id.
+	void SetThreadName(const char* name);
+
+	[[nodiscard]] bool IsCapturing() const { return capturing.load(std::memory_order_relaxed); }
+	[[nodiscard]] uint32_t GetFramesLeft() const { return framesLeft; }
+	/// Starts recording, the trace is written to path once frameCount frames have ended. Ignored during a capture.
+	void BeginCapture(uint32_t frameCount, const std::filesystem::path& path);
+	/// Ends a frame of the capture. Must be called by the thread that started it.
+	void EndFrame();
+
+	/// @param startTime,endTime SDL_GetTicksNS clock.
+	void RecordCpu(const char* name, uint64_t startTime, uint64_t endTime);
+	/// @param startTime,endTime Already converted from GPU ticks to the SDL_GetTicksNS clock.
+	void RecordGpu(const char* name, uint64_t startTime, uint64_t endTime);
+};
+
+/// Records the time from its construction to its destruction as a scope of the calling thread.
+class TraceScope {
+	Tracer& tracer;
+	const char* name;
+	// 0 when the tracer wasn't capturing at construction
+	uint64_t startTime = 0;
+
+public:
+	TraceScope(Tracer& tracer, const char* name);
+	~TraceScope();
+
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+};
@@ -0,0 +1,85 @@
+// Impl
+#include "vk_workgroups.hpp"
+
+std::vector<WorkgroupSize> vk_util::WorkgroupSizeCandidates(const VkPhysicalDeviceLimits& limits) {
+	constexpr std::array candidates = {
+		WorkgroupSize{8, 4},
+		WorkgroupSize{8, 8},
+		WorkgroupSize{16, 4},
+		WorkgroupSize{16, 8},
+		WorkgroupSize{8, 16},
+		WorkgroupSize{16, 16},
+		WorkgroupSize{32, 4},
+		WorkgroupSize{32, 8},
+		WorkgroupSize{32, 16},
+		WorkgroupSize{64, 1},
+		WorkgroupSize{64, 4},
+		WorkgroupSize{32, 32},
+	};
+
+	std::vector<WorkgroupSize> result;
+	for (const WorkgroupSize& candidate : candidates) {
+		if (candidate.x > limits.maxComputeWorkGroupSize[0] || candidate.y > limits.maxComputeWorkGroupSize[1]) continue;
+		if (candidate.x * candidate.y > limits.maxComputeWorkGroupInvocations) continue;
+		result.push_back(candidate);
+	}
+
+	return result;
+}
+
+void vk_util::DispatchForExtent(const VkCommandBuffer& commandBuffer, const VkExtent2D extent, const WorkgroupSize workgroupSize) {
+	const uint32_t groupCountX = (extent.width + workgroupSize.x - 1) / workgroupSize.x;
+	const uint32_t groupCountY = (extent.height + workgroupSize.y - 1) / workgroupSize.y;
+	vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+}
+
+std::string WorkgroupSizeCache::EntryKey(const std::string& shaderName, const uint64_t codeHash) const {
+	char hash[17];
+	SDL_snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(codeHash));
+	return deviceKey + " " + shaderName + "@" + hash;
+}
+
+void WorkgroupSizeCache::Load(std::filesystem::path path, const VkPhysicalDeviceProperties& properties) {
+	cachePath = std::move(path);
+	entries.clear();
+
+	//a driver update can change which size is fastest, so the driver version is part of the key
+	char key[64];
+	SDL_snprintf(key, sizeof(key), "%04x:%04x:%08x", properties.vendorID, properties.deviceID, properties.driverVersion);
+	deviceKey = key;
+
+	std::ifstream file(cachePath);
+	if (!file.is_open()) {
+		return;
+	}
+
+	std::string entryDevice, entryShader;
+	WorkgroupSize size;
+	while (file >> entryDevice >> entryShader >> size.x >> size.y) {
+		if (size.x == 0 || size.y == 0) continue;
+		entries[entryDevice + " " + entryShader] = size;
+	}
+}
+
+void WorkgroupSizeCache::Save() const {
+	std::ofstream file(cachePath, std::ios::trunc);
+	if (!file.is_open()) {
+		SDL_Log("Couldn't write workgroup size cache: %s", cachePath.string().c_str());
+		return;
+	}
+
+	for (const auto& [key, size] : entries) {
+		file << key << " " << size.x << " " << size.y << "\n";
+	}
+}
+
+std::optional<WorkgroupSize> WorkgroupSizeCache::Find(const std::string& shaderName, const uint64_t codeHash) const {
+	if (const auto it = entries.find(EntryKey(shaderName, codeHash)); it != entries.end()) {
+		return it->second;
+	}
+	return std::nullopt;
+}
+
+void WorkgroupSizeCache::Store(const std::string& shaderName, const uint64_t codeHash, const WorkgroupSize workgroupSize) {
+	entries[EntryKey(shaderName, codeHash)] = workgroupSize;
+}
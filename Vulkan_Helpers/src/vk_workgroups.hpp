@@ -0,0 +1,31 @@
+#pragma once
+
+#include "mass_includer.hpp"
+
+// Engine
+#include "vk_custom_types.hpp"
+
+namespace vk_util {
+	/// Workgroup sizes worth benchmarking on this device, filtered by the device's compute limits.
+	[[nodiscard]] std::vector<WorkgroupSize> WorkgroupSizeCandidates(const VkPhysicalDeviceLimits& limits);
+	/// Dispatches enough workgroups of the given size to cover the whole extent.
+	void DispatchForExtent(const VkCommandBuffer& commandBuffer, VkExtent2D extent, WorkgroupSize workgroupSize);
+}
+
+/// Remembers the fastest workgroup size per shader and device, so the benchmark only runs once.
+class WorkgroupSizeCache {
+	std::filesystem::path cachePath;
+	std::string deviceKey;
+	// key is "deviceKey shaderName@codeHash", so entries for other devices survive a save, and a recompiled shader is
+	// benchmarked again instead of reusing a size measured with different code
+	std::unordered_map<std::string, WorkgroupSize> entries;
+
+	[[nodiscard]] std::string EntryKey(const std::string& shaderName, uint64_t codeHash) const;
+
+public:
+	void Load(std::filesystem::path path, const VkPhysicalDeviceProperties& properties);
+	void Save() const;
+
+	[[nodiscard]] std::optional<WorkgroupSize> Find(const std::string& shaderName, uint64_t codeHash) const;
+	void Store(const std::string& shaderName, uint64_t codeHash, WorkgroupSize workgroupSize);
+};
@@ -0,0 +1,107 @@
+// Engine
+#include "vk_dynamic_resolution.hpp"
+
+// Tests
+#include "test_check.hpp"
+
+// The controller drives a simulated GPU whose frame time grows with the pixel count, so with the square of the scale.
+namespace {
+	constexpr float targetFrameTime = 1000.0f / 60.0f;
+
+	struct Simulation {
+		DynamicResolutionController controller;
+		float scale;
+		// frames since the scale last changed
+		uint32_t stableFrames = 0;
+
+		explicit Simulation(const float startScale) : scale(startScale) {
+			controller.enabled = true;
+			controller.targetFrameTime = targetFrameTime;
+		}
+
+		void Run(const double fullResolutionTime, const uint32_t frameCount) {
+			for (uint32_t frame = 0; frame < frameCount; frame++) {
+				const float newScale = controller.Update(fullResolutionTime * scale * scale, scale);
+				stableFrames = newScale == scale ? stableFrames + 1 : 0;
+				scale = newScale;
+			}
+		}
+
+		[[nodiscard]] bool GpuTimeInsideBand() const {
+			return controller.GetSmoothedGpuTime() <= targetFrameTime * (1.0 + controller.overBudgetMargin)
+				&& controller.GetSmoothedGpuTime() >= targetFrameTime * (1.0 - controller.underBudgetMargin);
+		}
+	};
+
+	void OverBudgetConvergesInsideTheBand() {
+		Simulation simulation(1.0f);
+		simulation.Run(25.0, 1000);
+
+		CHECK(simulation.scale < 1.0f);
+		CHECK(simulation.GpuTimeInsideBand());
+		//settled, rather than still stepping back and forth around the target
+		CHECK(simulation.stableFrames >= 500);
+	}
+
+	void UnderBudgetGrowsToTheMaximum() {
+		Simulation simulation(0.5f);
+		simulation.Run(8.0, 1000);
+
+		CHECK(simulation.scale == simulation.controller.maxScale);
+		CHECK(simulation.stableFrames >= 500);
+	}
+
+	void UnreachableTargetStopsAtTheMinimum() {
+		Simulation simulation(1.0f);
+		simulation.Run(500.0, 1000);
+
+		CHECK(simulation.scale == simulation.controller.minScale);
+	}
+
+	void ConvergesFromBelowAndAboveToTheSameBand() {
+		Simulation fromAbove(1.0f);
+		Simulation fromBelow(0.4f);
+		fromAbove.Run(30.0, 1000);
+		fromBelow.Run(30.0, 1000);
+
+		CHECK(fromAbove.GpuTimeInsideBand());
+		CHECK(fromBelow.GpuTimeInsideBand());
+	}
+
+	void StepsAreLimitedAndWaitForTheCooldown() {
+		DynamicResolutionController controller;
+		controller.enabled = true;
+		controller.targetFrameTime = targetFrameTime;
+
+		const float firstScale = controller.Update(1000.0, 1.0f);
+		CHECK(firstScale >= 1.0f - controller.maxStep - 0.0001f);
+		CHECK(firstScale < 1.0f);
+
+		//the measurements still come from frames at the old scale
+		for (uint32_t frame = 0; frame < controller.cooldownFrames; frame++) {
+			CHECK(controller.Update(1000.0, firstScale) == firstScale);
+		}
+		CHECK(controller.Update(1000.0, firstScale) < firstScale);
+	}
+
+	void DisabledKeepsTheScale() {
+		DynamicResolutionController controller;
+		CHECK(controller.Update(1000.0, 0.7f) == 0.7f);
+
+		controller.enabled = true;
+		//frames without a measurement don't count
+		CHECK(controller.Update(0.0, 0.7f) == 0.7f);
+		CHECK(controller.GetSmoothedGpuTime() == 0.0);
+	}
+}
+
+int main() {
+	OverBudgetConvergesInsideTheBand();
+	UnderBudgetGrowsToTheMaximum();
+	UnreachableTargetStopsAtTheMinimum();
+	ConvergesFromBelowAndAboveToTheSameBand();
+	StepsAreLimitedAndWaitForTheCooldown();
+	DisabledKeepsTheScale();
+
+	return failedChecks == 0 ? 0 : 1;
+}
@@ -0,0 +1,188 @@
+// Engine
+#include "vk_render_graph.hpp"
+
+// Vulkan Helper Libraries
+#define VMA_IMPLEMENTATION
+#include <vk_mem_alloc.h>
+
+// Tests
+#include "test_check.hpp"
+
+// Culling and placement run on the CPU alone. A graph without transient images compiles without a device,
+// so these graphs only import images and buffers with null handles.
+namespace {
+	SDL_AppResult NoWork(const VkCommandBuffer&) {
+		return SDL_APP_CONTINUE;
+	}
+
+	struct ImportedImage {
+		ImageState state;
+		RenderGraphImage image;
+
+		ImportedImage(RenderGraph& graph, const char* name) {
+			image = graph.ImportImage(name, nullptr, nullptr, state, VK_FORMAT_R8G8B8A8_UNORM, VkExtent3D{1, 1, 1});
+		}
+	};
+
+	size_t CompileAndCountCulled(RenderGraph& graph) {
+		CHECK(graph.Compile() == SDL_APP_CONTINUE);
+		const size_t culledCount = graph.GetCulledPassCount();
+		graph.Destroy();
+		return culledCount;
+	}
+
+	void PassWithUnreadWritesIsCulled() {
+		RenderGraph graph;
+		ImportedImage scene(graph, "Scene");
+		ImportedImage unused(graph, "Unused");
+		graph.AddPass("Draw", NoWork).Write(scene.image, ImageUsage::ColourAttachment);
+		graph.AddPass("Unused", NoWork).Write(unused.image, ImageUsage::ComputeWrite);
+		graph.MarkOutput(scene.image, ImageUsage::Present);
+
+		CHECK(CompileAndCountCulled(graph) == 1);
+	}
+
+	void PassesFeedingAnOutputAreKept() {
+		RenderGraph graph;
+		ImportedImage intermediate(graph, "Intermediate");
+		ImportedImage output(graph, "Output");
+		graph.AddPass("Producer", NoWork).Write(intermediate.image, ImageUsage::ComputeWrite);
+		graph.AddPass("Consumer", NoWork).Read(intermediate.image, ImageUsage::ShaderRead).Write(output.image, ImageUsage::ColourAttachment);
+		graph.MarkOutput(output.image, ImageUsage::Present);
+
+		CHECK(CompileAndCountCulled(graph) == 0);
+	}
+
+	void WholeChainIsCulledWithoutAnOutput() {
+		RenderGraph graph;
+		ImportedImage intermediate(graph, "Intermediate");
+		ImportedImage output(graph, "Output");
+		graph.AddPass("Producer", NoWork).Write(intermediate.image, ImageUsage::ComputeWrite);
+		graph.AddPass("Consumer", NoWork).Read(intermediate.image, ImageUsage::ShaderRead).Write(output.image, ImageUsage::ColourAttachment);
+
+		CHECK(CompileAndCountCulled(graph) == 2);
+	}
+
+	void WriteDiscardedByALaterPassIsCulled() {
+		RenderGraph graph;
+		ImportedImage output(graph, "Output");
+		graph.AddPass("First", NoWork).Write(output.image, ImageUsage::ComputeWrite);
+		graph.AddPass("Second", NoWork).Write(output.image, ImageUsage::ComputeWrite, true);
+		graph.MarkOutput(output.image, ImageUsage::Present);
+
+		CHECK(CompileAndCountCulled(graph) == 1);
+	}
+
+	void WriteKeptByALaterPassIsNotCulled() {
+		RenderGraph graph;
+		ImportedImage output(graph, "Output");
+		graph.AddPass("First", NoWork).Write(output.image, ImageUsage::ComputeWrite);
+		graph.AddPass("Second", NoWork).Write(output.image, ImageUsage::ComputeWrite);
+		graph.MarkOutput(output.image, ImageUsage::Present);
+
+		CHECK(CompileAndCountCulled(graph) == 0);
+	}
+
+	void SideEffectsKeepThePassAndWhatItReads() {
+		RenderGraph graph;
+		ImportedImage scene(graph, "Scene");
+		AllocatedBuffer readbackBuffer{};
+		const RenderGraphBuffer readback = graph.ImportBuffer("Readback", readbackBuffer);
+		graph.AddPass("Draw", NoWork).Write(scene.image, ImageUsage::ColourAttachment);
+		graph.AddPass("Readback", NoWork).Read(scene.image, ImageUsage::TransferSrc).Write(readback, BufferUsage::TransferDst).SideEffects();
+
+		CHECK(CompileAndCountCulled(graph) == 0);
+	}
+
+	TransientLifetime Transient(const uint32_t firstPass, const uint32_t lastPass, const VkDeviceSize size, const VkDeviceSize alignment = 256, const uint32_t memoryTypeBits = ~0u) {
+		return TransientLifetime{
+			.firstPass = firstPass,
+			.lastPass = lastPass,
+			.requirements = {.size = size, .alignment = alignment, .memoryTypeBits = memoryTypeBits},
+		};
+	}
+
+	std::optional<uint32_t> BlockOf(const std::span<const TransientMemoryBlock> blocks, const uint32_t transient) {
+		for (uint32_t b = 0; b < blocks.size(); b++) {
+			if (std::ranges::find(blocks[b].occupants, transient) != blocks[b].occupants.end()) return b;
+		}
+		return std::nullopt;
+	}
+
+	void DisjointLifetimesShareABlock() {
+		//the biggest is placed first, the second biggest overlaps it, the smallest only overlaps the second
+		const std::array transients = {Transient(0, 1, 100), Transient(2, 3, 50), Transient(1, 2, 80)};
+		const std::vector<TransientMemoryBlock> blocks = PlaceTransients(transients);
+
+		CHECK(blocks.size() == 2);
+		CHECK(BlockOf(blocks, 0).has_value() && BlockOf(blocks, 0) == BlockOf(blocks, 1));
+		CHECK(BlockOf(blocks, 2).has_value() && BlockOf(blocks, 2) != BlockOf(blocks, 0));
+		if (const std::optional<uint32_t> shared = BlockOf(blocks, 0); shared.has_value()) {
+			CHECK(blocks[shared.value()].requirements.size == 100);
+		}
+	}
+
+	void OverlappingLifetimesGetTheirOwnBlocks() {
+		const std::array transients = {Transient(0, 2, 100), Transient(1, 3, 100), Transient(2, 2, 100)};
+		const std::vector<TransientMemoryBlock> blocks = PlaceTransients(transients);
+
+		CHECK(blocks.size() == 3);
+		for (const TransientMemoryBlock& block : blocks) {
+			CHECK(block.occupants.size() == 1);
+		}
+	}
+
+	void LifetimesTouchingAtOnePassOverlap() {
+		const std::array transients = {Transient(0, 1, 100), Transient(1, 2, 100)};
+		CHECK(PlaceTransients(transients).size() == 2);
+	}
+
+	void IncompatibleMemoryTypesDontShare() {
+		const std::array transients = {Transient(0, 0, 100, 256, 0b01), Transient(1, 1, 100, 256, 0b10)};
+		CHECK(PlaceTransients(transients).size() == 2);
+	}
+
+	void SharedBlockCoversEveryOccupant() {
+		const std::array transients = {Transient(0, 0, 100, 256, 0b11), Transient(1, 1, 60, 1024, 0b10)};
+		const std::vector<TransientMemoryBlock> blocks = PlaceTransients(transients);
+
+		CHECK(blocks.size() == 1);
+		if (blocks.size() == 1) {
+			CHECK(blocks[0].requirements.size == 100);
+			CHECK(blocks[0].requirements.alignment == 1024);
+			CHECK(blocks[0].requirements.memoryTypeBits == 0b10);
+		}
+	}
+
+	void EveryTransientIsPlacedOnce() {
+		const std::array transients = {Transient(0, 4, 10), Transient(1, 1, 20), Transient(2, 3, 30), Transient(3, 5, 40), Transient(5, 6, 50)};
+		const std::vector<TransientMemoryBlock> blocks = PlaceTransients(transients);
+
+		size_t placedCount = 0;
+		for (const TransientMemoryBlock& block : blocks) {
+			placedCount += block.occupants.size();
+		}
+		CHECK(placedCount == transients.size());
+		for (uint32_t t = 0; t < transients.size(); t++) {
+			CHECK(BlockOf(blocks, t).has_value());
+		}
+	}
+}
+
+int main() {
+	PassWithUnreadWritesIsCulled();
+	PassesFeedingAnOutputAreKept();
+	WholeChainIsCulledWithoutAnOutput();
+	WriteDiscardedByALaterPassIsCulled();
+	WriteKeptByALaterPassIsNotCulled();
+	SideEffectsKeepThePassAndWhatItReads();
+
+	DisjointLifetimesShareABlock();
+	OverlappingLifetimesGetTheirOwnBlocks();
+	LifetimesTouchingAtOnePassOverlap();
+	IncompatibleMemoryTypesDontShare();
+	SharedBlockCoversEveryOccupant();
+	EveryTransientIsPlacedOnce();
+
+	return failedChecks == 0 ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+// Engine
+#include "vk_resource_pool.hpp"
+
+// Tests
+#include "test_check.hpp"
+
+namespace {
+	void ReleasedOutOfOrderAreCollectedInTimelineOrder() {
+		ResourcePool<int> pool;
+		const Handle<int> first = pool.Add(1);
+		const Handle<int> second = pool.Add(2);
+		const Handle<int> third = pool.Add(3);
+
+		//the second is released later but further ahead on the timeline than the first
+		pool.Release(first, 5);
+		pool.Release(second, 3);
+		pool.Release(third, 7);
+
+		std::vector<int> destroyed;
+		pool.Collect(2, [&](const int resource) { destroyed.push_back(resource); });
+		CHECK(destroyed.empty());
+
+		pool.Collect(3, [&](const int resource) { destroyed.push_back(resource); });
+		CHECK(destroyed == std::vector{2});
+
+		pool.Collect(6, [&](const int resource) { destroyed.push_back(resource); });
+		CHECK((destroyed == std::vector{2, 1}));
+
+		pool.Collect(7, [&](const int resource) { destroyed.push_back(resource); });
+		CHECK((destroyed == std::vector{2, 1, 3}));
+	}
+
+	void ReleasedAtTheSameValueKeepTheirReleaseOrder() {
+		ResourcePool<int> pool;
+		const Handle<int> first = pool.Add(1);
+		const Handle<int> second = pool.Add(2);
+		pool.Release(first, 4);
+		pool.Release(second, 4);
+
+		std::vector<int> destroyed;
+		pool.Collect(4, [&](const int resource) { destroyed.push_back(resource); });
+		CHECK((destroyed == std::vector{1, 2}));
+	}
+
+	void ReleasedHandleStopsResolving() {
+		ResourcePool<int> pool;
+		const Handle<int> released = pool.Add(1);
+		pool.Release(released, 1);
+		CHECK(pool.Get(released) == nullptr);
+
+		//the slot is reused, under a new generation
+		const Handle<int> reused = pool.Add(2);
+		CHECK(reused.Index() == released.Index());
+		CHECK(reused.Generation() != released.Generation());
+		CHECK(pool.Get(released) == nullptr);
+		CHECK(pool.Get(reused) != nullptr && *pool.Get(reused) == 2);
+
+		//releasing a stale handle leaves the resource in the slot alone
+		pool.Release(released, 2);
+		CHECK(pool.Get(reused) != nullptr && *pool.Get(reused) == 2);
+		CHECK(pool.GetSize() == 1);
+	}
+
+	void ReleaseKeepsTheOthersDense() {
+		ResourcePool<int> pool;
+		const Handle<int> first = pool.Add(1);
+		const Handle<int> second = pool.Add(2);
+		const Handle<int> third = pool.Add(3);
+		pool.Release(first, 1);
+
+		CHECK(pool.GetSize() == 2);
+		CHECK(pool.Get(second) != nullptr && *pool.Get(second) == 2);
+		CHECK(pool.Get(third) != nullptr && *pool.Get(third) == 3);
+		CHECK(std::ranges::count(pool.GetAll(), 1) == 0);
+	}
+
+	void DefaultHandleNeverResolves() {
+		ResourcePool<int> pool;
+		const Handle<int> handle = pool.Add(1);
+		CHECK(Handle<int>{}.IsNull());
+		CHECK(!handle.IsNull());
+		CHECK(pool.Get(Handle<int>{}) == nullptr);
+	}
+
+	void ClearDestroysEverythingAndInvalidatesHandles() {
+		ResourcePool<int> pool;
+		const Handle<int> live = pool.Add(1);
+		const Handle<int> released = pool.Add(2);
+		pool.Release(released, 10);
+
+		std::vector<int> destroyed;
+		pool.Clear([&](const int resource) { destroyed.push_back(resource); });
+		std::ranges::sort(destroyed);
+		CHECK((destroyed == std::vector{1, 2}));
+		CHECK(pool.Get(live) == nullptr);
+		CHECK(pool.GetSize() == 0);
+
+		destroyed.clear();
+		pool.Collect(10, [&](const int resource) { destroyed.push_back(resource); });
+		CHECK(destroyed.empty());
+	}
+}
+
+int main() {
+	ReleasedOutOfOrderAreCollectedInTimelineOrder();
+	ReleasedAtTheSameValueKeepTheirReleaseOrder();
+	ReleasedHandleStopsResolving();
+	ReleaseKeepsTheOthersDense();
+	DefaultHandleNeverResolves();
+	ClearDestroysEverythingAndInvalidatesHandles();
+
+	return failedChecks == 0 ? 0 : 1;
+}
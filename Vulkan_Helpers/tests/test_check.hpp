@@ -0,0 +1,15 @@
+#pragma once
+
+#include "mass_includer.hpp"
+
+// checks that failed in this test executable, its exit code is whether there were any
+inline int failedChecks = 0;
+
+/// Logs the condition if it doesn't hold, the checks after it still run.
+#define CHECK(x) \
+	do { \
+		if (!(x)) { \
+			SDL_Log("Check failed at %s:%d: %s", __FILE__, __LINE__, #x); \
+			failedChecks++; \
+		} \
+	} while (0)